@@ -0,0 +1,265 @@
+#define _CRT_SECURE_NO_WARNINGS   // place before any #include <cstdio>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Bench.h"
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourNavMeshBuilder.h"
+
+namespace eqoa
+{
+    namespace bench
+    {
+        // Generated grid: GRID_TILES x GRID_TILES tiles of GRID_QUADS x GRID_QUADS
+        // square polygons, about a fifth of them left out as holes.
+        static const int GRID_TILES = 16;
+        static const int GRID_QUADS = 16;
+        static const int GRID_QUAD_CELLS = 4;
+        static const float GRID_CELL_SIZE = 0.5f;
+
+        static bool addGridTile(dtNavMesh* mesh, int tx, int ty, const std::vector<char>& holes,
+            const std::vector<unsigned char>& areas)
+        {
+            const int Q = GRID_QUADS;
+            const int rowQuads = GRID_TILES * Q;
+            const int nvp = 6;
+            const float tileSize = Q * GRID_QUAD_CELLS * GRID_CELL_SIZE;
+
+            std::vector<unsigned short> verts;
+            for (int z = 0; z <= Q; ++z)
+            {
+                for (int x = 0; x <= Q; ++x)
+                {
+                    verts.push_back((unsigned short)(x * GRID_QUAD_CELLS));
+                    verts.push_back(0);
+                    verts.push_back((unsigned short)(z * GRID_QUAD_CELLS));
+                }
+            }
+
+            std::vector<int> polyIndex(Q * Q, -1);
+            int polyCount = 0;
+            for (int i = 0; i < Q * Q; ++i)
+            {
+                if (!holes[(ty * Q + i / Q) * rowQuads + tx * Q + i % Q])
+                    polyIndex[i] = polyCount++;
+            }
+
+            std::vector<unsigned short> polys;
+            std::vector<unsigned short> polyFlags;
+            std::vector<unsigned char> polyAreas;
+            for (int z = 0; z < Q; ++z)
+            {
+                for (int x = 0; x < Q; ++x)
+                {
+                    if (polyIndex[z * Q + x] < 0)
+                        continue;
+
+                    // Edges x-, z+, x+, z-; neighbours outside the tile are
+                    // portals to the tile on that side.
+                    const unsigned short v[4] = {
+                        (unsigned short)(z * (Q + 1) + x), (unsigned short)((z + 1) * (Q + 1) + x),
+                        (unsigned short)((z + 1) * (Q + 1) + x + 1), (unsigned short)(z * (Q + 1) + x + 1) };
+                    const int neighbour[4][2] = { { x - 1, z }, { x, z + 1 }, { x + 1, z }, { x, z - 1 } };
+                    unsigned short nei[4];
+                    for (int e = 0; e < 4; ++e)
+                    {
+                        const int nx = neighbour[e][0];
+                        const int nz = neighbour[e][1];
+                        if (nx < 0 || nz < 0 || nx >= Q || nz >= Q)
+                        {
+                            const int ntx = tx + (nx < 0 ? -1 : nx >= Q ? 1 : 0);
+                            const int nty = ty + (nz < 0 ? -1 : nz >= Q ? 1 : 0);
+                            const bool outside = ntx < 0 || nty < 0 || ntx >= GRID_TILES || nty >= GRID_TILES;
+                            nei[e] = outside ? (unsigned short)0xffff : (unsigned short)(DT_EXT_LINK | e);
+                        }
+                        else
+                        {
+                            const int n = polyIndex[nz * Q + nx];
+                            nei[e] = n < 0 ? (unsigned short)0xffff : (unsigned short)n;
+                        }
+                    }
+                    for (int k = 0; k < nvp; ++k)
+                        polys.push_back(k < 4 ? v[k] : (unsigned short)0xffff);
+                    for (int k = 0; k < nvp; ++k)
+                        polys.push_back(k < 4 ? nei[k] : (unsigned short)0xffff);
+
+                    const unsigned char area = areas[(ty * Q + z) * rowQuads + tx * Q + x];
+                    polyAreas.push_back(area);
+                    polyFlags.push_back(area == 0 ? 0x01 : area == 1 ? (0x02 | 0x04) : (0x02 | 0x08));
+                }
+            }
+            if (polyCount == 0)
+                return true;
+
+            dtNavMeshCreateParams params;
+            memset(&params, 0, sizeof(params));
+            params.verts = verts.data();
+            params.vertCount = (int)verts.size() / 3;
+            params.polys = polys.data();
+            params.polyFlags = polyFlags.data();
+            params.polyAreas = polyAreas.data();
+            params.polyCount = polyCount;
+            params.nvp = nvp;
+            params.tileX = tx;
+            params.tileY = ty;
+            params.bmin[0] = tx * tileSize;
+            params.bmin[1] = -1.0f;
+            params.bmin[2] = ty * tileSize;
+            params.bmax[0] = (tx + 1) * tileSize;
+            params.bmax[1] = 1.0f;
+            params.bmax[2] = (ty + 1) * tileSize;
+            params.walkableHeight = 2.0f;
+            params.walkableRadius = 0.5f;
+            params.walkableClimb = 0.5f;
+            params.cs = GRID_CELL_SIZE;
+            params.ch = 0.2f;
+            params.buildBvTree = true;
+
+            unsigned char* data = 0;
+            int dataSize = 0;
+            if (!dtCreateNavMeshData(&params, &data, &dataSize))
+                return false;
+            if (dtStatusFailed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)))
+            {
+                dtFree(data);
+                return false;
+            }
+            return true;
+        }
+
+        static NavMeshPtr generateGrid()
+        {
+            const int rowQuads = GRID_TILES * GRID_QUADS;
+            std::vector<char> holes(rowQuads * rowQuads, 0);
+            std::vector<unsigned char> areas(rowQuads * rowQuads, 0);
+            Random random(12345);
+            for (int i = 0; i < rowQuads * rowQuads; ++i)
+            {
+                const float r = random.next();
+                if (r < 0.22f)
+                    holes[i] = 1;
+                else if (r < 0.30f)
+                    areas[i] = 1;
+                else if (r < 0.33f)
+                    areas[i] = 2;
+            }
+            // Keep a few corridors open so most of the grid is connected.
+            for (int i = 0; i < rowQuads; ++i)
+            {
+                holes[(rowQuads / 2) * rowQuads + i] = 0;
+                holes[i * rowQuads + rowQuads / 2] = 0;
+                holes[i * rowQuads + 3] = 0;
+            }
+
+            NavMeshPtr mesh(dtAllocNavMesh());
+            if (!mesh)
+                return nullptr;
+
+            dtNavMeshParams params;
+            memset(&params, 0, sizeof(params));
+            params.tileWidth = GRID_QUADS * GRID_QUAD_CELLS * GRID_CELL_SIZE;
+            params.tileHeight = params.tileWidth;
+            params.maxTiles = GRID_TILES * GRID_TILES;
+            params.maxPolys = GRID_QUADS * GRID_QUADS;
+            if (dtStatusFailed(mesh->init(&params)))
+                return nullptr;
+
+            for (int ty = 0; ty < GRID_TILES; ++ty)
+            {
+                for (int tx = 0; tx < GRID_TILES; ++tx)
+                {
+                    if (!addGridTile(mesh.get(), tx, ty, holes, areas))
+                        return nullptr;
+                }
+            }
+            return mesh;
+        }
+
+        NavMeshPtr loadMesh(const Options& options)
+        {
+            if (!options.meshPath)
+                return generateGrid();
+            return LoadMeshFile(options.meshPath, 0, nullptr, nullptr);
+        }
+
+        std::vector<QueryPair> makePairs(const dtNavMesh* mesh, const dtNavMeshQuery& query, const dtQueryFilter& filter,
+            int count, Random& random)
+        {
+            float bmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+            float bmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+            for (int i = 0; i < mesh->getMaxTiles(); ++i)
+            {
+                const dtMeshTile* tile = mesh->getTile(i);
+                if (!tile || !tile->header)
+                    continue;
+                dtVmin(bmin, tile->header->bmin);
+                dtVmax(bmax, tile->header->bmax);
+            }
+
+            std::vector<QueryPair> pairs;
+            if (bmin[0] > bmax[0])
+                return pairs;
+
+            const float halfExtents[3] = { 2.0f, (bmax[1] - bmin[1]) * 0.5f + 1.0f, 2.0f };
+            const float midY = (bmin[1] + bmax[1]) * 0.5f;
+            for (int attempt = 0; (int)pairs.size() < count && attempt < count * 100; ++attempt)
+            {
+                const float start[3] = { random.next(bmin[0], bmax[0]), midY, random.next(bmin[2], bmax[2]) };
+                const float end[3] = { random.next(bmin[0], bmax[0]), midY, random.next(bmin[2], bmax[2]) };
+
+                QueryPair pair;
+                query.findNearestPoly(start, halfExtents, &filter, &pair.startRef, pair.startPos);
+                query.findNearestPoly(end, halfExtents, &filter, &pair.endRef, pair.endPos);
+                if (pair.startRef && pair.endRef)
+                    pairs.push_back(pair);
+            }
+            return pairs;
+        }
+
+        struct Benchmark
+        {
+            const char* name;
+            int (*run)(const Options& options);
+            const char* description;
+        };
+
+        static const Benchmark BENCHMARKS[] = {
+            { "filter", benchQueryFilter, "findPath, findNearestPoly and raycast with dtQueryFilter and the templated filters" },
+            { "openlist", benchOpenList, "binary and 4-ary heap open lists, alone and in findPath" },
+            { "kernels", benchKernels, "batched DetourCommon closest point kernels against the scalar ones" },
+        };
+    }
+}
+
+using namespace eqoa;
+using namespace eqoa::bench;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: %s <benchmark> [mesh file|-] [count] [runs]\n", argv[0]);
+        for (const Benchmark& benchmark : BENCHMARKS)
+            printf("  %-10s %s\n", benchmark.name, benchmark.description);
+        return 1;
+    }
+
+    Options options;
+    options.meshPath = argc > 2 && strcmp(argv[2], "-") != 0 ? argv[2] : nullptr;
+    options.count = argc > 3 ? atoi(argv[3]) : 0;
+    options.runs = argc > 4 ? atoi(argv[4]) : 5;
+    if (options.runs < 1)
+        options.runs = 1;
+
+    for (const Benchmark& benchmark : BENCHMARKS)
+    {
+        if (strcmp(argv[1], benchmark.name) == 0)
+            return benchmark.run(options);
+    }
+
+    printf("unknown benchmark %s\n", argv[1]);
+    return 1;
+}
@@ -0,0 +1,76 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1921)
+#pragma once
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "NavMeshLoader.h"
+
+namespace eqoa
+{
+    namespace bench
+    {
+        // Arguments every benchmark gets after its name on the command line.
+        struct Options
+        {
+            const char* meshPath;   // MSET or snapshot file, null for the generated grid.
+            int count;              // Queries per run, 0 for the benchmark's default.
+            int runs;               // Timed runs; the fastest one is reported.
+        };
+
+        // Fixed-seed generator, so every run and every variant sees the same
+        // queries.
+        class Random
+        {
+        public:
+            explicit Random(uint32_t seed) : m_state(seed) {}
+
+            // Uniform in [0, 1].
+            float next()
+            {
+                m_state = m_state * 1103515245u + 12345u;
+                return ((m_state >> 8) & 0xffff) / 65535.0f;
+            }
+
+            float next(float lo, float hi) { return lo + next() * (hi - lo); }
+
+        private:
+            uint32_t m_state;
+        };
+
+        // A start and end point snapped to the mesh.
+        struct QueryPair
+        {
+            dtPolyRef startRef;
+            dtPolyRef endRef;
+            float startPos[3];
+            float endPos[3];
+        };
+
+        // Loads options.meshPath, or generates a grid of tiles with holes and
+        // three areas when it is null. Null if the file cannot be loaded.
+        NavMeshPtr loadMesh(const Options& options);
+
+        // Picks count random pairs within the bounds of the mesh whose ends
+        // both snap to a polygon that passes filter.
+        std::vector<QueryPair> makePairs(const dtNavMesh* mesh, const dtNavMeshQuery& query, const dtQueryFilter& filter,
+            int count, Random& random);
+
+        inline double elapsedMs(std::chrono::steady_clock::time_point since)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+        }
+
+        // Benchmarks, selected by name in Bench.cpp.
+        int benchQueryFilter(const Options& options);
+        int benchOpenList(const Options& options);
+        int benchKernels(const Options& options);
+    }
+}
+
+#endif // BENCH_H_INCLUDED
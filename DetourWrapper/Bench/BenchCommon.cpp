@@ -0,0 +1,196 @@
+#include <cstdio>
+
+#include "Bench.h"
+#include "DetourCommon.h"
+
+namespace eqoa
+{
+    namespace bench
+    {
+        // Random vertices with blocks of DT_BATCH_WIDTH segments or triangles
+        // picked from them, so the batched kernels gather their inputs the way
+        // findNearestPoly and getPolyHeight do.
+        struct KernelData
+        {
+            std::vector<float> verts;
+            std::vector<float> points;
+            std::vector<const float*> blocks;   // (A, B, C) * DT_BATCH_WIDTH per block.
+            int blockCount;
+        };
+
+        static const int KERNEL_BLOCK_VERTS = DT_BATCH_WIDTH * 3;
+
+        // Keeps the sums of the timed loops, so they are not optimized away.
+        volatile float kernelSink;
+
+        static KernelData makeKernelData(int pointCount, int blockCount)
+        {
+            static const int VERT_COUNT = 4096;
+            Random random(7);
+
+            KernelData data;
+            data.verts.resize(VERT_COUNT * 3);
+            for (float& v : data.verts)
+                v = random.next(0.0f, 10.0f);
+            data.points.resize(pointCount * 3);
+            for (float& v : data.points)
+                v = random.next(0.0f, 10.0f);
+            data.blockCount = blockCount;
+            data.blocks.resize(blockCount * KERNEL_BLOCK_VERTS);
+            for (const float*& v : data.blocks)
+                v = &data.verts[(int)random.next(0.0f, VERT_COUNT - 1.0f) * 3];
+            return data;
+        }
+
+        // Segments of a block are A to B.
+        static double runSegmentsScalar(const KernelData& data, float& sink)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            float sum = 0.0f;
+            for (size_t p = 0; p < data.points.size(); p += 3)
+            {
+                for (int b = 0; b < data.blockCount; ++b)
+                {
+                    const float* const* block = &data.blocks[b * KERNEL_BLOCK_VERTS];
+                    for (int i = 0; i < DT_BATCH_WIDTH; ++i)
+                    {
+                        float t;
+                        sum += dtDistancePtSegSqr2D(&data.points[p], block[i], block[DT_BATCH_WIDTH + i], t) + t;
+                    }
+                }
+            }
+            sink += sum;
+            return elapsedMs(start);
+        }
+
+        static double runSegmentsBatched(const KernelData& data, float& sink)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            float sum = 0.0f;
+            for (size_t p = 0; p < data.points.size(); p += 3)
+            {
+                for (int b = 0; b < data.blockCount; ++b)
+                {
+                    const float* const* block = &data.blocks[b * KERNEL_BLOCK_VERTS];
+                    float dist[DT_BATCH_WIDTH], t[DT_BATCH_WIDTH];
+                    dtDistancePtSegsSqr2D(&data.points[p], block, block + DT_BATCH_WIDTH, dist, t);
+                    for (int i = 0; i < DT_BATCH_WIDTH; ++i)
+                        sum += dist[i] + t[i];
+                }
+            }
+            sink += sum;
+            return elapsedMs(start);
+        }
+
+        static double runTrianglesScalar(const KernelData& data, float& sink)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            float sum = 0.0f;
+            for (size_t p = 0; p < data.points.size(); p += 3)
+            {
+                for (int b = 0; b < data.blockCount; ++b)
+                {
+                    const float* const* block = &data.blocks[b * KERNEL_BLOCK_VERTS];
+                    for (int i = 0; i < DT_BATCH_WIDTH; ++i)
+                    {
+                        float h;
+                        if (dtClosestHeightPointTriangle(&data.points[p], block[i], block[DT_BATCH_WIDTH + i], block[DT_BATCH_WIDTH*2 + i], h))
+                        {
+                            sum += h;
+                            break;
+                        }
+                    }
+                }
+            }
+            sink += sum;
+            return elapsedMs(start);
+        }
+
+        static double runTrianglesBatched(const KernelData& data, float& sink)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            float sum = 0.0f;
+            for (size_t p = 0; p < data.points.size(); p += 3)
+            {
+                for (int b = 0; b < data.blockCount; ++b)
+                {
+                    float h;
+                    if (dtClosestHeightPointTriangles(&data.points[p], &data.blocks[b * KERNEL_BLOCK_VERTS], DT_BATCH_WIDTH, h) >= 0)
+                        sum += h;
+                }
+            }
+            sink += sum;
+            return elapsedMs(start);
+        }
+
+        // Counts the results of the batched kernels that differ from the
+        // scalar functions; they are meant to match bit for bit.
+        static int countMismatches(const KernelData& data)
+        {
+            int mismatches = 0;
+            for (size_t p = 0; p < data.points.size(); p += 3)
+            {
+                const float* pt = &data.points[p];
+                for (int b = 0; b < data.blockCount; ++b)
+                {
+                    const float* const* block = &data.blocks[b * KERNEL_BLOCK_VERTS];
+
+                    float dist[DT_BATCH_WIDTH], t[DT_BATCH_WIDTH];
+                    dtDistancePtSegsSqr2D(pt, block, block + DT_BATCH_WIDTH, dist, t);
+                    for (int i = 0; i < DT_BATCH_WIDTH; ++i)
+                    {
+                        float scalarT;
+                        const float scalarDist = dtDistancePtSegSqr2D(pt, block[i], block[DT_BATCH_WIDTH + i], scalarT);
+                        mismatches += scalarDist != dist[i] || scalarT != t[i];
+                    }
+
+                    float scalarH = 0.0f;
+                    int scalarIndex = -1;
+                    for (int i = 0; i < DT_BATCH_WIDTH && scalarIndex < 0; ++i)
+                    {
+                        if (dtClosestHeightPointTriangle(pt, block[i], block[DT_BATCH_WIDTH + i], block[DT_BATCH_WIDTH*2 + i], scalarH))
+                            scalarIndex = i;
+                    }
+                    float h = 0.0f;
+                    const int index = dtClosestHeightPointTriangles(pt, block, DT_BATCH_WIDTH, h);
+                    mismatches += index != scalarIndex || (index >= 0 && h != scalarH);
+                }
+            }
+            return mismatches;
+        }
+
+        // The batched DetourCommon kernels against the scalar functions they
+        // replace in findNearestPoly and getPolyHeight. Does not use a mesh.
+        int benchKernels(const Options& options)
+        {
+            static const int BLOCK_COUNT = 64;
+            const KernelData data = makeKernelData(options.count > 0 ? options.count : 4096, BLOCK_COUNT);
+            const int queries = (int)data.points.size() / 3;
+
+            double best[4] = { -1.0, -1.0, -1.0, -1.0 };
+            float sink = 0.0f;
+            for (int i = 0; i < options.runs; ++i)
+            {
+                const double times[4] = {
+                    runSegmentsScalar(data, sink), runSegmentsBatched(data, sink),
+                    runTrianglesScalar(data, sink), runTrianglesBatched(data, sink) };
+                for (int k = 0; k < 4; ++k)
+                {
+                    if (best[k] < 0.0 || times[k] < best[k])
+                        best[k] = times[k];
+                }
+            }
+
+            const double segments = (double)queries * BLOCK_COUNT * DT_BATCH_WIDTH;
+            const double blocks = (double)queries * BLOCK_COUNT;
+            kernelSink = sink;
+            printf("%d points x %d blocks of %d, fastest of %d runs\n", queries, BLOCK_COUNT, DT_BATCH_WIDTH, options.runs);
+            printf("  segments   scalar %6.2fns  batched %6.2fns per segment (%.2fx)\n",
+                best[0] * 1e6 / segments, best[1] * 1e6 / segments, best[0] / best[1]);
+            printf("  triangles  scalar %6.2fns  batched %6.2fns per block (%.2fx)\n",
+                best[2] * 1e6 / blocks, best[3] * 1e6 / blocks, best[2] / best[3]);
+            printf("  %d mismatches\n", countMismatches(data));
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,214 @@
+#include <cstdio>
+
+#include "Bench.h"
+#include "DetourNode.h"
+
+namespace eqoa
+{
+    namespace bench
+    {
+        struct OpenListRun
+        {
+            double ms;
+            uint64_t checksum;
+        };
+
+        // One open list operation of a recorded search.
+        struct OpenListOp
+        {
+            enum Kind { CLEAR, PUSH, MODIFY, POP };
+
+            Kind kind;
+            int node;
+            float total;
+        };
+
+        // Records A*-like searches on a binary heap: pop the best node,
+        // close it and expand it into new nodes or cheaper totals for open
+        // ones. Replaying the operations gives every queue the same work.
+        static std::vector<OpenListOp> recordSearches(std::vector<dtNode>& nodes, int searches)
+        {
+            const int nodeCount = (int)nodes.size();
+            dtNodeQueue queue(nodeCount);
+            std::vector<OpenListOp> ops;
+            Random random(7);
+
+            for (int search = 0; search < searches; ++search)
+            {
+                for (dtNode& node : nodes)
+                {
+                    node.total = 0.0f;
+                    node.flags = 0;
+                }
+                queue.clear();
+                ops.push_back({ OpenListOp::CLEAR, 0, 0.0f });
+
+                int used = 1;
+                nodes[0].flags = DT_NODE_OPEN;
+                queue.push(&nodes[0]);
+                ops.push_back({ OpenListOp::PUSH, 0, 0.0f });
+                while (!queue.empty())
+                {
+                    dtNode* best = queue.pop();
+                    best->flags = DT_NODE_CLOSED;
+                    ops.push_back({ OpenListOp::POP, 0, 0.0f });
+
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        const float total = best->total + random.next(0.5f, 2.0f);
+                        if (used < nodeCount && random.next() < 0.6f)
+                        {
+                            dtNode* node = &nodes[used];
+                            node->total = total;
+                            node->flags = DT_NODE_OPEN;
+                            queue.push(node);
+                            ops.push_back({ OpenListOp::PUSH, used++, total });
+                        }
+                        else if (used > 1)
+                        {
+                            const int index = (int)(random.next() * (used - 1));
+                            dtNode* node = &nodes[index];
+                            if ((node->flags & DT_NODE_OPEN) && total < node->total)
+                            {
+                                node->total = total;
+                                queue.modify(node);
+                                ops.push_back({ OpenListOp::MODIFY, index, total });
+                            }
+                        }
+                    }
+                }
+            }
+            return ops;
+        }
+
+        // The checksum is over the popped totals; nodes with equal totals may
+        // come out in either order.
+        template <class TQueue>
+        static OpenListRun replay(TQueue& queue, std::vector<dtNode>& nodes, const std::vector<OpenListOp>& ops)
+        {
+            OpenListRun run = { 0.0, 0 };
+
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (const OpenListOp& op : ops)
+            {
+                dtNode* node = &nodes[op.node];
+                switch (op.kind)
+                {
+                case OpenListOp::CLEAR:
+                    queue.clear();
+                    break;
+                case OpenListOp::PUSH:
+                    node->total = op.total;
+                    node->flags = DT_NODE_OPEN;
+                    queue.push(node);
+                    break;
+                case OpenListOp::MODIFY:
+                    node->total = op.total;
+                    queue.modify(node);
+                    break;
+                case OpenListOp::POP:
+                    if (!queue.empty())
+                    {
+                        dtNode* best = queue.pop();
+                        best->flags = DT_NODE_CLOSED;
+                        run.checksum = run.checksum * 31 + (uint64_t)(best->total * 1024.0f);
+                    }
+                    break;
+                }
+            }
+            run.ms = elapsedMs(start);
+            return run;
+        }
+
+        static OpenListRun runFindPath(dtNavMeshQuery& query, dtOpenListType openList, const dtQueryFilter& filter,
+            const std::vector<QueryPair>& pairs, uint64_t* nodes)
+        {
+            static const int MAX_POLYS = 4096;
+            std::vector<dtPolyRef> path(MAX_POLYS);
+            OpenListRun run = { 0.0, 0 };
+            query.setOpenListType(openList);
+
+            *nodes = 0;
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (const QueryPair& pair : pairs)
+            {
+                int pathCount = 0;
+                query.findPath(pair.startRef, pair.endRef, pair.startPos, pair.endPos, &filter, path.data(), &pathCount, MAX_POLYS);
+                *nodes += (uint64_t)query.getNodePool()->getNodeCount();
+                for (int i = 0; i < pathCount; ++i)
+                    run.checksum = run.checksum * 31 + path[i];
+            }
+            run.ms = elapsedMs(start);
+            return run;
+        }
+
+        // dtNodeQueue (binary heap of node pointers) against
+        // dtQuaternaryNodeQueue (4-ary heap of totals and nodes), first on
+        // their own, then inside findPath on the mesh.
+        int benchOpenList(const Options& options)
+        {
+            static const int MAX_NODES = 65535;
+
+            std::vector<dtNode> nodes(MAX_NODES);
+            dtNodeQueue binary(MAX_NODES);
+            dtQuaternaryNodeQueue quaternary(MAX_NODES);
+            const int searches = options.count > 0 ? options.count : 20;
+            const std::vector<OpenListOp> ops = recordSearches(nodes, searches);
+            OpenListRun best[2] = { { -1.0, 0 }, { -1.0, 0 } };
+            for (int i = 0; i < options.runs; ++i)
+            {
+                const OpenListRun runs[2] = { replay(binary, nodes, ops), replay(quaternary, nodes, ops) };
+                for (int k = 0; k < 2; ++k)
+                {
+                    if (best[k].ms < 0.0 || runs[k].ms < best[k].ms)
+                        best[k] = runs[k];
+                }
+            }
+            printf("open list, %d searches of %d nodes, fastest of %d runs\n", searches, MAX_NODES, options.runs);
+            printf("  binary %8.2fms  4-ary %8.2fms (%.2fx)  %s\n", best[0].ms, best[1].ms, best[0].ms / best[1].ms,
+                best[0].checksum == best[1].checksum ? "same totals" : "TOTALS DIFFER");
+
+            NavMeshPtr mesh = loadMesh(options);
+            if (!mesh)
+            {
+                printf("could not load the mesh\n");
+                return 1;
+            }
+
+            dtNavMeshQuery query;
+            if (dtStatusFailed(query.init(mesh.get(), MAX_NODES)))
+                return 1;
+
+            // Area costs like our zones use, so searches spread out.
+            dtQueryFilter filter;
+            filter.setAreaCost(1, 1.5f);
+            filter.setAreaCost(2, 3.0f);
+
+            Random random(99);
+            const std::vector<QueryPair> pairs = makePairs(mesh.get(), query, filter, options.count > 0 ? options.count * 10 : 300, random);
+            if (pairs.empty())
+            {
+                printf("no query pairs on the mesh\n");
+                return 1;
+            }
+
+            uint64_t nodeCounts[2] = { 0, 0 };
+            OpenListRun paths[2] = { { -1.0, 0 }, { -1.0, 0 } };
+            const dtOpenListType types[2] = { DT_OPEN_LIST_BINARY_HEAP, DT_OPEN_LIST_QUATERNARY_HEAP };
+            for (int i = 0; i < options.runs; ++i)
+            {
+                for (int k = 0; k < 2; ++k)
+                {
+                    const OpenListRun run = runFindPath(query, types[k], filter, pairs, &nodeCounts[k]);
+                    if (paths[k].ms < 0.0 || run.ms < paths[k].ms)
+                        paths[k] = run;
+                }
+            }
+            printf("findPath, %d queries, fastest of %d runs\n", (int)pairs.size(), options.runs);
+            printf("  binary %8.2fms  4-ary %8.2fms (%.2fx)  nodes %llu/%llu  %s\n", paths[0].ms, paths[1].ms, paths[0].ms / paths[1].ms,
+                (unsigned long long)nodeCounts[0], (unsigned long long)nodeCounts[1],
+                paths[0].checksum == paths[1].checksum ? "same corridors" : "corridors differ");
+            return 0;
+        }
+    }
+}
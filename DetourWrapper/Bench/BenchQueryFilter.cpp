@@ -0,0 +1,143 @@
+#include <cstdio>
+
+#include "Bench.h"
+
+namespace eqoa
+{
+    namespace bench
+    {
+        // Sums over the results of one run, compared between the filters to
+        // check that they find the same answers.
+        struct FilterRun
+        {
+            double ms;
+            uint64_t checksum;
+        };
+
+        template <class TFilter>
+        static FilterRun runFindPath(const dtNavMeshQuery& query, const TFilter* filter, const std::vector<QueryPair>& pairs)
+        {
+            static const int MAX_POLYS = 256;
+            dtPolyRef path[MAX_POLYS];
+            FilterRun run = { 0.0, 0 };
+
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (const QueryPair& pair : pairs)
+            {
+                int pathCount = 0;
+                query.findPath(pair.startRef, pair.endRef, pair.startPos, pair.endPos, filter, path, &pathCount, MAX_POLYS);
+                run.checksum += pathCount > 0 ? (uint64_t)pathCount * 31 + path[pathCount - 1] : 0;
+            }
+            run.ms = elapsedMs(start);
+            return run;
+        }
+
+        template <class TFilter>
+        static FilterRun runFindNearestPoly(const dtNavMeshQuery& query, const TFilter* filter, const std::vector<QueryPair>& pairs)
+        {
+            const float halfExtents[3] = { 2.0f, 50.0f, 2.0f };
+            FilterRun run = { 0.0, 0 };
+
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (const QueryPair& pair : pairs)
+            {
+                dtPolyRef ref = 0;
+                float nearest[3];
+                query.findNearestPoly(pair.endPos, halfExtents, filter, &ref, nearest);
+                run.checksum += ref;
+            }
+            run.ms = elapsedMs(start);
+            return run;
+        }
+
+        template <class TFilter>
+        static FilterRun runRaycast(const dtNavMeshQuery& query, const TFilter* filter, const std::vector<QueryPair>& pairs)
+        {
+            static const int MAX_POLYS = 256;
+            dtPolyRef path[MAX_POLYS];
+            FilterRun run = { 0.0, 0 };
+
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (const QueryPair& pair : pairs)
+            {
+                dtRaycastHit hit;
+                hit.path = path;
+                hit.maxPath = MAX_POLYS;
+                query.raycast(pair.startRef, pair.startPos, pair.endPos, filter, DT_RAYCAST_USE_COSTS, &hit);
+                run.checksum += hit.pathCount > 0 ? (uint64_t)hit.pathCount * 31 + path[hit.pathCount - 1] : 0;
+            }
+            run.ms = elapsedMs(start);
+            return run;
+        }
+
+        // Keeps the fastest of several runs.
+        static void keepBest(FilterRun& best, const FilterRun& run)
+        {
+            if (best.ms < 0.0 || run.ms < best.ms)
+                best.ms = run.ms;
+            best.checksum = run.checksum;
+        }
+
+        static void report(const char* name, const FilterRun* runs, int queries)
+        {
+            const bool same = runs[0].checksum == runs[1].checksum && runs[1].checksum == runs[2].checksum;
+            printf("%-16s dtQueryFilter %8.2fus  flags %8.2fus (%.2fx)  distance %8.2fus (%.2fx)  %s\n", name,
+                runs[0].ms * 1000.0 / queries,
+                runs[1].ms * 1000.0 / queries, runs[0].ms / runs[1].ms,
+                runs[2].ms * 1000.0 / queries, runs[0].ms / runs[2].ms,
+                same ? "same results" : "RESULTS DIFFER");
+        }
+
+        // All polygons of the generated grid and of our meshes have some flag
+        // set, so with unit area costs the three filters accept the same
+        // polygons at the same costs and must find the same results.
+        int benchQueryFilter(const Options& options)
+        {
+            NavMeshPtr mesh = loadMesh(options);
+            if (!mesh)
+            {
+                printf("could not load the mesh\n");
+                return 1;
+            }
+
+            dtNavMeshQuery query;
+            if (dtStatusFailed(query.init(mesh.get(), 65535)))
+                return 1;
+
+            dtQueryFilter queryFilter;
+            dtFlagsQueryFilter flagsFilter;
+            dtDistanceQueryFilter distanceFilter;
+
+            Random random(99);
+            const std::vector<QueryPair> pairs = makePairs(mesh.get(), query, queryFilter, options.count > 0 ? options.count : 500, random);
+            if (pairs.empty())
+            {
+                printf("no query pairs on the mesh\n");
+                return 1;
+            }
+            const int queries = (int)pairs.size();
+            printf("%d queries, fastest of %d runs\n", queries, options.runs);
+
+            FilterRun path[3] = { { -1.0, 0 }, { -1.0, 0 }, { -1.0, 0 } };
+            FilterRun nearest[3] = { { -1.0, 0 }, { -1.0, 0 }, { -1.0, 0 } };
+            FilterRun ray[3] = { { -1.0, 0 }, { -1.0, 0 }, { -1.0, 0 } };
+            for (int i = 0; i < options.runs; ++i)
+            {
+                keepBest(path[0], runFindPath(query, &queryFilter, pairs));
+                keepBest(path[1], runFindPath(query, &flagsFilter, pairs));
+                keepBest(path[2], runFindPath(query, &distanceFilter, pairs));
+                keepBest(nearest[0], runFindNearestPoly(query, &queryFilter, pairs));
+                keepBest(nearest[1], runFindNearestPoly(query, &flagsFilter, pairs));
+                keepBest(nearest[2], runFindNearestPoly(query, &distanceFilter, pairs));
+                keepBest(ray[0], runRaycast(query, &queryFilter, pairs));
+                keepBest(ray[1], runRaycast(query, &flagsFilter, pairs));
+                keepBest(ray[2], runRaycast(query, &distanceFilter, pairs));
+            }
+
+            report("findPath", path, queries);
+            report("findNearestPoly", nearest, queries);
+            report("raycast", ray, queries);
+            return 0;
+        }
+    }
+}
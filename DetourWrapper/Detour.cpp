@@ -1,11 +1,14 @@
 ﻿#define _CRT_SECURE_NO_WARNINGS   // place before any #include <cstdio>
 #include <cstdio>
+#include <cstring>   // memset, memmove
 
 #include "Detour.h"
 #include "DetourNavMesh.h"
 #include "DetourAlloc.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourStatus.h"
+#include "DetourLandmarks.h"
+#include "DetourTileGraph.h"
 #include "DetourCommon.h"
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
@@ -13,27 +16,13 @@
 #include <random>
 #include <cfloat>  // FLT_MAX
 #include <cmath>   // fabsf
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
 
 
 namespace eqoa
 {
-    static const int NAVMESHSET_MAGIC = 'M' << 24 | 'S' << 16 | 'E' << 8 | 'T';
-    static const int NAVMESHSET_VERSION = 1;
-
-    struct NavMeshSetHeader
-    {
-        int magic;
-        int version;
-        int numTiles;
-        dtNavMeshParams params;
-    };
-
-    struct NavMeshTileHeader
-    {
-        dtTileRef tileRef;
-        int dataSize;
-    };
-
     // Returns a random number [0..1]
     static float frand()
     {
@@ -50,112 +39,92 @@ namespace eqoa
         return dist(rng);
     }
 
-    dtNavMesh* LoadMeshFile(const std::string& filePath)
+    // Flags plus the per-area traversal costs shared by the path queries.
+    static void initPathFilter(dtQueryFilter& filter, uint16_t includeFlags, uint16_t excludeFlags)
     {
-        FILE* file = fopen(filePath.c_str(), "rb");
-        if (!file)
-        {
-            std::cout << "File Not Found!" << std::endl;
-            return nullptr;
-        }
+        filter.setIncludeFlags(includeFlags);
+        filter.setExcludeFlags(excludeFlags);
 
-        NavMeshSetHeader header;
-        size_t readLen = fread(&header, sizeof(NavMeshSetHeader), 1, file);
-        if (readLen != 1)
-        {
-            fclose(file);
-            return nullptr;
-        }
+        filter.setAreaCost(SAMPLE_POLYAREA_GROUND, 1.0f);
+        filter.setAreaCost(SAMPLE_POLYAREA_WATER, 1.5f);
+        filter.setAreaCost(SAMPLE_POLYAREA_MUD, 3.0f);
+        filter.setAreaCost(SAMPLE_POLYAREA_LAVA, 100.0f);  // Basically avoid
+        filter.setAreaCost(SAMPLE_POLYAREA_SLIME, 3.0f);   // Swim: slime (mud-like cost)
+    }
 
-        if (header.magic != NAVMESHSET_MAGIC)
+    detour::detour() :
+        m_searchMode(PATH_SEARCH_FORWARD),
+        m_overlayGeneration(0),
+        m_presetRevision(0)
+    {
+        initPathFilter(m_defaultFilter, 0, 0);
+        for (FilterPreset& preset : m_filterPresets)
         {
-            fclose(file);
-            return nullptr;
+            preset.revision = 0;
+            preset.uniformCost = false;
         }
+    }
 
-        if (header.version != NAVMESHSET_VERSION)
-        {
-            fclose(file);
-            return nullptr;
-        }
+    detour::~detour()
+    {
+        // The mesh snapshot and the pooled queries will be automatically
+        // cleaned up when the detour object is destructed. Do we need this?
+    }
 
-        // std::cout << "NumTiles: " << header.numTiles << std::endl;
+    NavMeshHandle detour::currentMesh() const
+    {
+        return std::atomic_load(&m_mesh);
+    }
 
-        dtNavMesh* mesh = dtAllocNavMesh();
-        if (!mesh)
+    uint32_t detour::load(const std::string& filePath, uint32_t flags, NavMeshLoadStats* stats)
+    {
+        if ((flags & NAVMESH_LOAD_PARALLEL) && m_workers.size() == 0)
+            set_worker_threads((int)std::max(1u, std::thread::hardware_concurrency()), nullptr);
+
+        // Graph edges and landmark costs get the default area costs and may
+        // cross any polygon. Routes a query's flags rule out are searched
+        // again without the graph; the landmarks are only used by filters
+        // that cost at least as much.
+        dtQueryFilter meshFilter;
+        initPathFilter(meshFilter, SAMPLE_POLYFLAGS_ALL, 0);
+
+        NavMeshHandle published;
+        if (flags & NAVMESH_LOAD_SHARED)
         {
-            fclose(file);
-            return nullptr;
+            published = MeshRegistry::instance().acquire(filePath, flags, &m_workers, stats, &meshFilter);
         }
-        dtStatus status = mesh->init(&header.params);
-        if (dtStatusFailed(status))
+        else
         {
-            fclose(file);
-            return nullptr;
+            NavMeshPtr loadedMesh = LoadMeshFile(filePath, flags, &m_workers, stats);
+            if (loadedMesh)
+                published = MakeMeshSnapshot(std::move(loadedMesh), flags, &meshFilter, stats);
         }
 
-        for (int i = 0; i < header.numTiles; ++i)
-        {
-            NavMeshTileHeader tileHeader;
-            readLen = fread(&tileHeader, sizeof(tileHeader), 1, file);
-            if (readLen != 1)
-            {
-                fclose(file);
-                return nullptr;
-            }
-
-            if (!tileHeader.tileRef || !tileHeader.dataSize)
-            {
-                break;
-            }
-
-            unsigned char* data = (unsigned char*)dtAlloc(tileHeader.dataSize, DT_ALLOC_PERM);
-            if (!data)
-            {
-                break;
-            }
-
-            memset(data, 0, tileHeader.dataSize);
-            readLen = fread(data, tileHeader.dataSize, 1, file);
-            if (readLen != 1)
-            {
-                dtFree(data);
-                fclose(file);
-                return nullptr;
-            }
-
-            mesh->addTile(data, tileHeader.dataSize, DT_TILE_FREE_DATA, tileHeader.tileRef, 0);
-        }
+        if (!published)
+            return 0;
 
-        fclose(file);
-        return mesh;
+        // Publish the new mesh without waiting for queries. Requests that
+        // already hold the old snapshot finish on it, the last one to let go
+        // frees it. Pooled queries are rebound on their next checkout.
+        std::lock_guard<std::mutex> swapLock(m_swapMutex);
+        std::atomic_store(&m_mesh, published);
+        m_pathQueue.bind(published);
+        m_pathCache.clear();
+        return 1;
     }
 
-    detour::detour()
+    uint32_t detour::save_snapshot(const std::string& filePath)
     {
-        m_dtNavMesh = std::make_unique<dtNavMesh>();
-        m_dtNavMeshQuery = std::make_unique<dtNavMeshQuery>();
+        NavMeshHandle mesh = currentMesh();
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        return SaveMeshSnapshot(mesh ? mesh->mesh.get() : nullptr, filePath) ? 1 : 0;
     }
 
-    detour::~detour()
+    uint32_t detour::reserve_queries(int count)
     {
-        // m_dtNavMesh and m_dtNavMeshQuery will be automatically cleaned up
-        // when the detour object is destructed. Do we need this?
+        return m_queryPool.reserve(count, currentMesh()) ? 1 : 0;
     }
 
-    uint32_t detour::load(const std::string& filePath)
-    {
-        std::unique_ptr<dtNavMesh> loadedMesh(LoadMeshFile(filePath));
-
-        if (loadedMesh)
-        {
-            m_dtNavMesh = std::move(loadedMesh);
-            return 1;
-        }
-
-        return 0;
-     }
-
     inline bool inRange(const float* v1, const float* v2, const float r, const float h)
     {
         const float dx = v2[0] - v1[0];
@@ -350,9 +319,82 @@ namespace eqoa
         }
     }
 
+    bool detour::selectFilter(dtQueryFilter& filter, uint32_t& filterKey, const QueryPool::Lease& query,
+        uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags) const
+    {
+        if (preset == FILTER_PRESET_NONE)
+        {
+            filter = m_defaultFilter;
+            filter.setIncludeFlags(includeFlags);
+            filter.setExcludeFlags(excludeFlags);
+            filterKey = 0;
+        }
+        else
+        {
+            if (preset >= MAX_FILTER_PRESETS || !m_filterPresets[preset].revision)
+                return false;
+            filter = m_filterPresets[preset].filter;
+            filterKey = m_filterPresets[preset].revision;
+        }
+
+        filter.setPolyOverlay(overlayFor(query.generation()));
+        return true;
+    }
+
+    uint32_t detour::set_filter_preset(uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags, const float* areaCosts)
+    {
+        if (preset >= MAX_FILTER_PRESETS)
+            return 0;
+
+        dtQueryFilter filter = m_defaultFilter;
+        filter.setIncludeFlags(includeFlags);
+        filter.setExcludeFlags(excludeFlags);
+        if (areaCosts)
+        {
+            for (int i = 0; i < DT_MAX_AREAS; ++i)
+                filter.setAreaCost(i, areaCosts[i]);
+        }
+
+        bool uniformCost = true;
+        for (int i = 0; i < DT_MAX_AREAS; ++i)
+            uniformCost = uniformCost && filter.getAreaCost(i) == 1.0f;
+
+        // A new revision keeps cached paths of the old settings from being hit.
+        std::unique_lock<std::shared_mutex> meshLock(m_meshMutex);
+        m_filterPresets[preset].filter = filter;
+        m_filterPresets[preset].revision = ++m_presetRevision;
+        m_filterPresets[preset].uniformCost = uniformCost;
+        return 1;
+    }
+
+    uint32_t detour::remove_filter_preset(uint32_t preset)
+    {
+        if (preset >= MAX_FILTER_PRESETS)
+            return 0;
+
+        std::unique_lock<std::shared_mutex> meshLock(m_meshMutex);
+        const bool existed = m_filterPresets[preset].revision != 0;
+        m_filterPresets[preset].revision = 0;
+        return existed ? 1 : 0;
+    }
+
     uint32_t detour::random_point(const glm::vec3& centerPoint, float radius, uint16_t includeFlags, uint16_t excludeFlags, float* rndPoint)
     {
-        m_dtNavMeshQuery->init(m_dtNavMesh.get(), 65535);
+        return randomPoint(centerPoint, radius, FILTER_PRESET_NONE, includeFlags, excludeFlags, rndPoint);
+    }
+
+    uint32_t detour::random_point_preset(const glm::vec3& centerPoint, float radius, uint32_t preset, float* rndPoint)
+    {
+        return randomPoint(centerPoint, radius, preset, 0, 0, rndPoint);
+    }
+
+    uint32_t detour::randomPoint(const glm::vec3& centerPoint, float radius, uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags, float* rndPoint)
+    {
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        QueryPool::Lease query = m_queryPool.acquire(currentMesh());
+        if (!query)
+            return 0;
+
 
         const float* centerPtr = glm::value_ptr(centerPoint);
 
@@ -364,23 +406,18 @@ namespace eqoa
         float nearestPt[3];
 
         dtQueryFilter filter;
-        filter.setIncludeFlags(includeFlags);
-        filter.setExcludeFlags(excludeFlags);
-
-        filter.setAreaCost(SAMPLE_POLYAREA_GROUND, 1.0f);
-        filter.setAreaCost(SAMPLE_POLYAREA_WATER, 1.5f);
-        filter.setAreaCost(SAMPLE_POLYAREA_MUD, 3.0f);
-        filter.setAreaCost(SAMPLE_POLYAREA_LAVA, 100.0f);  // Basically avoid
-        filter.setAreaCost(SAMPLE_POLYAREA_SLIME, 3.0f);   // Swim: slime (mud-like cost)
+        uint32_t filterKey = 0;
+        if (!selectFilter(filter, filterKey, query, preset, includeFlags, excludeFlags))
+            return 0;
 
-        dtStatus status = m_dtNavMeshQuery->findNearestPoly(centerPtr, halfExtents, &filter, &centerRef, nearestPt);
+        dtStatus status = query->findNearestPoly(centerPtr, halfExtents, &filter, &centerRef, nearestPt);
         if (dtStatusFailed(status))
         {
             // std::cout << "Could not find valid center poly! " << "Status: " << status << std::endl;
             return 0;
         }        
 
-        status = m_dtNavMeshQuery->findRandomPointAroundCircle(centerRef, centerPtr, radius, &filter, BetterFrand, &randomRef, rndPoint);
+        status = query->findRandomPointAroundCircle(centerRef, centerPtr, radius, &filter, BetterFrand, &randomRef, rndPoint);
         if (dtStatusFailed(status))
         {
             // std::cout << "Could not find random point within radius! " << "Status: " << status << std::endl;
@@ -390,9 +427,328 @@ namespace eqoa
         return 1;
     }
  
+    // Corridor buffer of the calling thread, at least capacity polys. Starts
+    // at MAX_POLYS and only grows when a long path needs it, so threads that
+    // never see one keep the small buffer.
+    static dtPolyRef* threadCorridor(int capacity, int* size)
+    {
+        thread_local std::vector<dtPolyRef> corridor(MAX_POLYS);
+        if ((int)corridor.size() < capacity)
+            corridor.resize(capacity);
+        *size = (int)corridor.size();
+        return corridor.data();
+    }
+
+    // Landmark costs are lower bounds for filters that charge at least the
+    // landmark filter's cost in every area. Skipping polygons only makes
+    // paths longer, so the flags do not matter.
+    static bool landmarksApply(const dtLandmarks* landmarks, const dtQueryFilter* filter)
+    {
+        for (int i = 0; i < DT_MAX_AREAS; ++i)
+        {
+            if (filter->getAreaCost(i) < landmarks->getFilter()->getAreaCost(i))
+                return false;
+        }
+        return true;
+    }
+
+    static bool landmarksApply(const dtLandmarks* landmarks, const dtFlagsQueryFilter* /*filter*/)
+    {
+        for (int i = 0; i < DT_MAX_AREAS; ++i)
+        {
+            if (landmarks->getFilter()->getAreaCost(i) > 1.0f)
+                return false;
+        }
+        return true;
+    }
+
+    // The tile graph is built over every polygon, so it only serves filters
+    // whose flags pass every flag the mesh has; with stricter flags its
+    // routes lead through polygons the filter skips. Its edge costs were
+    // computed with the graph filter's area costs, so those have to match.
+    static bool graphFlagsApply(const dtTileGraph* graph, unsigned short includeFlags, unsigned short excludeFlags)
+    {
+        return !(graph->getPolyFlags() & ~includeFlags) && !(graph->getPolyFlags() & excludeFlags);
+    }
+
+    static bool graphApplies(const dtTileGraph* graph, const dtQueryFilter* filter)
+    {
+        if (!graphFlagsApply(graph, filter->getIncludeFlags(), filter->getExcludeFlags()))
+            return false;
+        for (int i = 0; i < DT_MAX_AREAS; ++i)
+        {
+            if (filter->getAreaCost(i) != graph->getFilter()->getAreaCost(i))
+                return false;
+        }
+        return true;
+    }
+
+    static bool graphApplies(const dtTileGraph* graph, const dtFlagsQueryFilter* filter)
+    {
+        if (!graphFlagsApply(graph, filter->getIncludeFlags(), filter->getExcludeFlags()))
+            return false;
+        for (int i = 0; i < DT_MAX_AREAS; ++i)
+        {
+            if (graph->getFilter()->getAreaCost(i) != 1.0f)
+                return false;
+        }
+        return true;
+    }
+
+    // Query of the calling thread for searches a pooled query ran out of
+    // nodes for, initialized against mesh. Created on the first such search.
+    static dtNavMeshQuery* threadLargeQuery(const dtNavMesh* mesh)
+    {
+        struct QueryDeleter
+        {
+            void operator()(dtNavMeshQuery* query) const { dtFreeNavMeshQuery(query); }
+        };
+
+        thread_local std::unique_ptr<dtNavMeshQuery, QueryDeleter> query(dtAllocNavMeshQuery());
+        if (!query || dtStatusFailed(query->init(mesh, QUERY_LARGE_MAX_NODES)))
+            return nullptr;
+        return query.get();
+    }
+
+    // Full corridor search of findCorridor on navQuery, which has maxNodes
+    // search nodes. query provides the mesh's landmarks and poly adjacency.
+    template <class TFilter>
+    static dtStatus searchCorridor(dtNavMeshQuery* navQuery, int maxNodes, const QueryPool::Lease& query, const TFilter* filter, SearchStats* stats, uint32_t searchMode,
+        dtPolyRef startRef, const float* startPt, dtPolyRef endRef, const float* endPt,
+        dtPolyRef* path, int* pathCount, int maxPath)
+    {
+        const dtLandmarks* landmarks = query.landmarks();
+        const bool guided = landmarks && landmarksApply(landmarks, filter);
+        const bool bidirectional = (searchMode & ~PATH_SEARCH_QUATERNARY_HEAP) == PATH_SEARCH_BIDIRECTIONAL &&
+            (navQuery->getReverseNodePool() || dtStatusSucceed(navQuery->initBidirectional(maxNodes)));
+        if (!bidirectional)
+        {
+            // Pooled queries serve instances with different modes. Without
+            // memory for the 4-ary heap the binary one does.
+            const dtOpenListType openList = (searchMode & PATH_SEARCH_QUATERNARY_HEAP) ? DT_OPEN_LIST_QUATERNARY_HEAP : DT_OPEN_LIST_BINARY_HEAP;
+            if (dtStatusFailed(navQuery->setOpenListType(openList)))
+                navQuery->setOpenListType(DT_OPEN_LIST_BINARY_HEAP);
+            navQuery->setPolyAdjacency(query.adjacency());
+        }
+        dtStatus status;
+        if (bidirectional && guided)
+            status = navQuery->findPathBidirectional(startRef, endRef, startPt, endPt, filter,
+                dtLandmarkHeuristic(landmarks, endRef, endPt), dtLandmarkHeuristic(landmarks, startRef, startPt), path, pathCount, maxPath);
+        else if (bidirectional)
+            status = navQuery->findPathBidirectional(startRef, endRef, startPt, endPt, filter, path, pathCount, maxPath);
+        else if (guided)
+            status = navQuery->findPath(startRef, endRef, startPt, endPt, filter, dtLandmarkHeuristic(landmarks, endRef, endPt), path, pathCount, maxPath);
+        else
+            status = navQuery->findPath(startRef, endRef, startPt, endPt, filter, path, pathCount, maxPath);
+
+        if (stats)
+        {
+            uint64_t nodes = (uint64_t)navQuery->getNodePool()->getNodeCount();
+            if (bidirectional)
+                nodes += (uint64_t)navQuery->getReverseNodePool()->getNodeCount();
+            stats->searches.fetch_add(1, std::memory_order_relaxed);
+            stats->nodes.fetch_add(nodes, std::memory_order_relaxed);
+            if (guided)
+            {
+                stats->landmarkSearches.fetch_add(1, std::memory_order_relaxed);
+                stats->landmarkNodes.fetch_add(nodes, std::memory_order_relaxed);
+            }
+        }
+        return status;
+    }
+
+    // Corridor between two polys. When the mesh has a tile graph and the
+    // ends are at least HIERARCHY_MIN_TILES tiles apart the search goes over
+    // the graph, if the graph suits the filter (see graphApplies). Only a
+    // corridor that reaches the end is taken from it, the full search
+    // decides the others, guided by the mesh's landmarks if it has them and
+    // they suit the filter. With PATH_SEARCH_BIDIRECTIONAL it searches from
+    // both ends; pooled queries get their backward node pool on the first
+    // such search. A full search that runs out of nodes is repeated on the
+    // thread's query with QUERY_LARGE_MAX_NODES nodes. stats is optional.
+    template <class TFilter>
+    static dtStatus findCorridor(const QueryPool::Lease& query, const TFilter* filter, SearchStats* stats, uint32_t searchMode,
+        dtPolyRef startRef, const float* startPt, dtPolyRef endRef, const float* endPt,
+        dtPolyRef* path, int* pathCount, int maxPath)
+    {
+        const dtTileGraph* graph = query.graph();
+        if (graph && graphApplies(graph, filter))
+        {
+            const dtMeshTile* startTile = nullptr;
+            const dtMeshTile* endTile = nullptr;
+            const dtPoly* poly = nullptr;
+            query.mesh()->getTileAndPolyByRefUnsafe(startRef, &startTile, &poly);
+            query.mesh()->getTileAndPolyByRefUnsafe(endRef, &endTile, &poly);
+            const int tiles = dtMax(dtAbs(startTile->header->x - endTile->header->x),
+                dtAbs(startTile->header->y - endTile->header->y));
+            if (tiles >= HIERARCHY_MIN_TILES)
+            {
+                dtStatus status = query->findPathHierarchical(graph, startRef, endRef, startPt, endPt, filter, path, pathCount, maxPath);
+                if (dtStatusSucceed(status) && !dtStatusDetail(status, DT_PARTIAL_RESULT))
+                    return status;
+            }
+        }
+
+        dtStatus status = searchCorridor(query.get(), QUERY_MAX_NODES, query, filter, stats, searchMode,
+            startRef, startPt, endRef, endPt, path, pathCount, maxPath);
+
+        // Only searches that need more nodes pay for the large pool.
+        if (dtStatusDetail(status, DT_OUT_OF_NODES))
+        {
+            if (dtNavMeshQuery* largeQuery = threadLargeQuery(query.mesh()))
+                status = searchCorridor(largeQuery, QUERY_LARGE_MAX_NODES, query, filter, stats, searchMode,
+                    startRef, startPt, endRef, endPt, path, pathCount, maxPath);
+        }
+        return status;
+    }
+
+    // Corridor search between two snapped points, string-pulled straight into
+    // the caller's buffer which has room for maxPoints points. outFlags and
+    // outRefs are optional and get the dtStraightPathFlags and entered poly of
+    // each point. Results are served from and added to the path cache when it
+    // is enabled; the cache only stores points, so with flags or refs only the
+    // corridor is reused. Returns a PathRequestStatus.
+    //
+    // The corridor is cut at MAX_POLYS polys and reported as partial unless
+    // longPath is set. Then it is limited by the node pool only, and the
+    // straight path by maxPoints. The two kinds are cached apart, so a cut
+    // corridor is never served to a long path request.
+    template <class TFilter>
+    static uint32_t straightPathBetween(const QueryPool::Lease& query, const TFilter* filter, uint32_t filterKey, PathCache* cache, SearchStats* searchStats, uint32_t searchMode,
+        dtPolyRef startRef, const float* startPt, dtPolyRef endRef, const float* endPt,
+        float* outPoints, int maxPoints, int* outCount,
+        unsigned char* outFlags = nullptr, dtPolyRef* outRefs = nullptr, bool longPath = false)
+    {
+        *outCount = 0;
+
+        int maxPath = MAX_POLYS;
+        dtPolyRef* path = threadCorridor(MAX_POLYS, &maxPath);
+        if (!longPath)
+            maxPath = MAX_POLYS;
+
+        int pathCount = 0;
+        bool partial = false;
+        bool cached = false;
+        PathCache::Key key;
+
+        if (cache && cache->enabled())
+        {
+            key = cache->makeKey(query.generation(), filterKey, searchMode, longPath ? 0 : MAX_POLYS,
+                startRef, endRef, filter->getIncludeFlags(), filter->getExcludeFlags(), startPt, endPt);
+            int cachedCount = -1;
+            cached = cache->find(key, startPt, endPt, path, &pathCount, maxPath,
+                outPoints, &cachedCount, (outFlags || outRefs) ? 0 : maxPoints, &partial);
+            if (cached && cachedCount >= 0)
+            {
+                *outCount = cachedCount;
+                return partial ? PATH_REQUEST_PARTIAL : PATH_REQUEST_OK;
+            }
+        }
+
+        if (!cached)
+        {
+            dtStatus status = findCorridor(query, filter, searchStats, searchMode, startRef, startPt, endRef, endPt, path, &pathCount, maxPath);
+
+            // A corridor can not be longer than the node pool that found it.
+            // Grow to the pooled query's size and search again; a corridor
+            // that still does not fit came from the large query, so grow to
+            // its size. This thread keeps the grown buffer.
+            while (longPath && dtStatusDetail(status, DT_BUFFER_TOO_SMALL) && maxPath < QUERY_LARGE_MAX_NODES)
+            {
+                path = threadCorridor(maxPath < QUERY_MAX_NODES ? QUERY_MAX_NODES : QUERY_LARGE_MAX_NODES, &maxPath);
+                status = findCorridor(query, filter, searchStats, searchMode, startRef, startPt, endRef, endPt, path, &pathCount, maxPath);
+            }
+
+            if (dtStatusFailed(status) || pathCount == 0)
+                return PATH_REQUEST_FAILED;
+
+            partial = dtStatusDetail(status, DT_PARTIAL_RESULT) || dtStatusDetail(status, DT_BUFFER_TOO_SMALL);
+        }
+
+        if (maxPoints <= 0)
+            return PATH_REQUEST_OUT_OF_SPACE;
+
+        dtStatus status = query->findStraightPath(startPt, endPt, path, pathCount,
+            outPoints, outFlags, outRefs, outCount, longPath ? maxPoints : dtMin(maxPoints, MAX_POLYS));
+        if (dtStatusFailed(status))
+            return PATH_REQUEST_FAILED;
+
+        if ((longPath || maxPoints < MAX_POLYS) && dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+            return PATH_REQUEST_OUT_OF_SPACE;
+
+        if (cache && cache->enabled())
+            cache->insert(key, startPt, endPt, path, pathCount, outPoints, *outCount, partial);
+
+        return partial ? PATH_REQUEST_PARTIAL : PATH_REQUEST_OK;
+    }
+
     uint32_t detour::find_path(const glm::vec3& startPoint, const glm::vec3& endPoint, uint16_t includeFlags, uint16_t excludeFlags, float* strPath)
     {
-         m_dtNavMeshQuery->init(m_dtNavMesh.get(), 65535);
+        int strPathCount = 0;
+        const uint32_t result = findPath(startPoint, endPoint, FILTER_PRESET_NONE, includeFlags, excludeFlags,
+            strPath, MAX_POLYS, nullptr, nullptr, &strPathCount, false);
+        return result == PATH_REQUEST_OK || result == PATH_REQUEST_PARTIAL ? strPathCount : 0;
+    }
+
+    uint32_t detour::find_path_preset(const glm::vec3& startPoint, const glm::vec3& endPoint, uint32_t preset, float* strPath)
+    {
+        int strPathCount = 0;
+        const uint32_t result = findPath(startPoint, endPoint, preset, 0, 0,
+            strPath, MAX_POLYS, nullptr, nullptr, &strPathCount, false);
+        return result == PATH_REQUEST_OK || result == PATH_REQUEST_PARTIAL ? strPathCount : 0;
+    }
+
+    uint32_t detour::find_path_into(const glm::vec3& startPoint, const glm::vec3& endPoint, uint16_t includeFlags, uint16_t excludeFlags,
+        float* outPoints, int maxPoints, unsigned char* outFlags, dtPolyRef* outRefs, int* outCount)
+    {
+        *outCount = 0;
+        if (!outPoints || maxPoints <= 0)
+            return PATH_REQUEST_OUT_OF_SPACE;
+
+        return findPath(startPoint, endPoint, FILTER_PRESET_NONE, includeFlags, excludeFlags,
+            outPoints, maxPoints, outFlags, outRefs, outCount, true);
+    }
+
+    // Snaps both points and writes the straight path between them into the
+    // caller's buffers. Returns a PathRequestStatus.
+    template <class TFilter>
+    static uint32_t snappedStraightPath(const QueryPool::Lease& query, const TFilter* filter, uint32_t filterKey, PathCache* cache, SearchStats* searchStats, uint32_t searchMode,
+        const float* startptr, const float* endptr, const float* halfExtents,
+        float* outPoints, int maxPoints, unsigned char* outFlags, dtPolyRef* outRefs, int* outCount, bool longPath)
+    {
+        dtPolyRef startRef = 0, endRef = 0;
+        
+        float startPt[3];
+        float endPt[3];
+
+        dtStatus status = query->findNearestPoly(startptr, halfExtents, filter, &startRef, startPt);
+        if (dtStatusFailed(status) || !startRef)
+        {
+            // std::cout << "Could not find valid start poly! " << "Status: " << status << std::endl;
+            return PATH_REQUEST_NO_START_POLY;
+        }
+
+        status = query->findNearestPoly(endptr, halfExtents, filter, &endRef, endPt);
+        if (dtStatusFailed(status) || !endRef)
+        {
+            // std::cout << "Could not find valid end poly! " << "Status: " << status << std::endl;
+            return PATH_REQUEST_NO_END_POLY;
+        }
+
+        return straightPathBetween(query, filter, filterKey, cache, searchStats, searchMode,
+            startRef, startPt, endRef, endPt, outPoints, maxPoints, outCount, outFlags, outRefs, longPath);
+    }
+
+    uint32_t detour::findPath(const glm::vec3& startPoint, const glm::vec3& endPoint, uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags,
+        float* outPoints, int maxPoints, unsigned char* outFlags, dtPolyRef* outRefs, int* outCount, bool longPath)
+    {
+        *outCount = 0;
+
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        QueryPool::Lease query = m_queryPool.acquire(currentMesh());
+        if (!query)
+            return PATH_REQUEST_FAILED;
+
 
         const float* startptr = glm::value_ptr(startPoint);
         const float* endptr = glm::value_ptr(endPoint);
@@ -400,72 +756,168 @@ namespace eqoa
         const glm::vec3 extents(2.0f, 50.0f, 2.0f);
         const float* halfExtents = glm::value_ptr(extents);
 
-        dtPolyRef startRef, endRef;
-        
-        float startPt[3];
-        float endPt[3];
-        
         dtQueryFilter filter;
-        filter.setIncludeFlags(includeFlags);
-        filter.setExcludeFlags(excludeFlags);
+        uint32_t filterKey = 0;
+        if (!selectFilter(filter, filterKey, query, preset, includeFlags, excludeFlags))
+            return PATH_REQUEST_FAILED;
 
-        filter.setAreaCost(SAMPLE_POLYAREA_GROUND, 1.0f);
-        filter.setAreaCost(SAMPLE_POLYAREA_WATER, 1.5f);
-        filter.setAreaCost(SAMPLE_POLYAREA_MUD, 3.0f);
-        filter.setAreaCost(SAMPLE_POLYAREA_LAVA, 100.0f);  // Basically avoid
-        filter.setAreaCost(SAMPLE_POLYAREA_SLIME, 3.0f);   // Swim: slime (mud-like cost)
-
-        dtPolyRef path[MAX_POLYS];
-        dtStatus status = 0;
-        int pathCount = 0;
+        // Presets without area costs skip the per-edge cost lookup, the
+        // paths are the same.
+        if (preset < MAX_FILTER_PRESETS && m_filterPresets[preset].uniformCost)
+        {
+            dtFlagsQueryFilter flagsFilter(filter.getIncludeFlags(), filter.getExcludeFlags());
+            flagsFilter.setPolyOverlay(filter.getPolyOverlay());
+            return snappedStraightPath(query, &flagsFilter, filterKey, &m_pathCache, &m_searchStats, m_searchMode.load(std::memory_order_relaxed), startptr, endptr, halfExtents,
+                outPoints, maxPoints, outFlags, outRefs, outCount, longPath);
+        }
 
-        float straightPath[MAX_POLYS * 3]{};
-        unsigned char strPathFlags[MAX_POLYS];
-        dtPolyRef strPathPolys[MAX_POLYS];
+        return snappedStraightPath(query, &filter, filterKey, &m_pathCache, &m_searchStats, m_searchMode.load(std::memory_order_relaxed), startptr, endptr, halfExtents,
+            outPoints, maxPoints, outFlags, outRefs, outCount, longPath);
+    }
 
-        int strPathCount = 0;
+    // Batch items that start or end on the same spot with the same flags are
+    // snapped to the mesh only once.
+    struct SnapKey
+    {
+        float pos[3];
+        uint16_t includeFlags;
+        uint16_t excludeFlags;
 
-        status = m_dtNavMeshQuery->findNearestPoly(startptr, halfExtents, &filter, &startRef, startPt);
-        if (dtStatusFailed(status))
+        bool operator==(const SnapKey& other) const
         {
-            // std::cout << "Could not find valid start poly! " << "Status: " << status << std::endl;
-            return 0;
+            return memcmp(this, &other, sizeof(SnapKey)) == 0;
         }
+    };
 
-        status = m_dtNavMeshQuery->findNearestPoly(endptr, halfExtents, &filter, &endRef, endPt);
-        if (dtStatusFailed(status))
+    struct SnapKeyHash
+    {
+        size_t operator()(const SnapKey& key) const
         {
-            // std::cout << "Could not find valid end poly! " << "Status: " << status << std::endl;
-            return 0;
+            // FNV-1a over the raw key bytes.
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(SnapKey); ++i)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return static_cast<size_t>(hash);
         }
+    };
 
-        status = m_dtNavMeshQuery->findPath(startRef, endRef, startPt, endPt, &filter, path, &pathCount, MAX_POLYS);
-        if (dtStatusFailed(status))
-        {
-            // std::cout << "Could not find valid path! " << "Status: " << status << std::endl;
+    struct SnapResult
+    {
+        dtPolyRef ref;
+        float pt[3];
+    };
+
+    uint32_t detour::find_path_batch(int count, const glm::vec3* startPoints, const glm::vec3* endPoints,
+        const uint16_t* includeFlags, const uint16_t* excludeFlags,
+        float* outPoints, int outCapacity, int* outOffsets, int* outCounts, uint32_t* outStatus)
+    {
+        if (count <= 0 || !startPoints || !endPoints || !includeFlags || !excludeFlags ||
+            !outPoints || !outOffsets || !outCounts || !outStatus)
             return 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            outOffsets[i] = 0;
+            outCounts[i] = 0;
+            outStatus[i] = PATH_REQUEST_FAILED;
         }
 
-        if (pathCount > 0)
+        // One query checkout, one filter and one snap cache for the whole batch.
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        QueryPool::Lease query = m_queryPool.acquire(currentMesh());
+        if (!query)
+            return 0;
+
+        const glm::vec3 extents(2.0f, 50.0f, 2.0f);
+        const float* halfExtents = glm::value_ptr(extents);
+
+        dtQueryFilter filter;
+        initPathFilter(filter, includeFlags[0], excludeFlags[0]);
+        filter.setPolyOverlay(overlayFor(query.generation()));
+
+        std::unordered_map<SnapKey, SnapResult, SnapKeyHash> snapped;
+        snapped.reserve(count * 2);
+
+        auto snap = [&](const glm::vec3& pos) -> const SnapResult&
         {
-            status = m_dtNavMeshQuery->findStraightPath(startPt, endPt, path, pathCount, straightPath, strPathFlags, strPathPolys, &strPathCount, MAX_POLYS);
+            SnapKey key;
+            memset(&key, 0, sizeof(key));
+            key.pos[0] = pos.x;
+            key.pos[1] = pos.y;
+            key.pos[2] = pos.z;
+            key.includeFlags = filter.getIncludeFlags();
+            key.excludeFlags = filter.getExcludeFlags();
+
+            auto it = snapped.find(key);
+            if (it != snapped.end())
+                return it->second;
+
+            SnapResult result{ 0, { 0.0f, 0.0f, 0.0f } };
+            dtStatus status = query->findNearestPoly(key.pos, halfExtents, &filter, &result.ref, result.pt);
             if (dtStatusFailed(status))
+                result.ref = 0;
+            return snapped.emplace(key, result).first->second;
+        };
+
+        int written = 0;
+        uint32_t succeeded = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            outOffsets[i] = written;
+
+            if (filter.getIncludeFlags() != includeFlags[i] || filter.getExcludeFlags() != excludeFlags[i])
             {
-                // std::cout << "Could not find valid straight path! " << "Status: " << status << std::endl;
-                return 0;
+                filter.setIncludeFlags(includeFlags[i]);
+                filter.setExcludeFlags(excludeFlags[i]);
             }
-        }
 
-        for (int i = 0; i < MAX_POLYS * 3; ++i)
-        {
-            strPath[i] = straightPath[i];
+            const SnapResult& start = snap(startPoints[i]);
+            if (!start.ref)
+            {
+                outStatus[i] = PATH_REQUEST_NO_START_POLY;
+                continue;
+            }
+
+            const SnapResult& end = snap(endPoints[i]);
+            if (!end.ref)
+            {
+                outStatus[i] = PATH_REQUEST_NO_END_POLY;
+                continue;
+            }
+
+            int strPathCount = 0;
+            outStatus[i] = straightPathBetween(query, &filter, 0, &m_pathCache, &m_searchStats, m_searchMode.load(std::memory_order_relaxed), start.ref, start.pt, end.ref, end.pt,
+                &outPoints[written * 3], outCapacity - written, &strPathCount);
+
+            outCounts[i] = strPathCount;
+            written += strPathCount;
+
+            if (outStatus[i] == PATH_REQUEST_OK || outStatus[i] == PATH_REQUEST_PARTIAL)
+                succeeded++;
         }
-        return strPathCount;
+
+        return succeeded;
     }
 
     uint32_t detour::find_smoothPath(const glm::vec3& startPoint, const glm::vec3& endPoint, uint16_t includeFlags, uint16_t excludeFlags, float* smoothPath)
     {
-        m_dtNavMeshQuery->init(m_dtNavMesh.get(), 65535);
+        return findSmoothPath(startPoint, endPoint, FILTER_PRESET_NONE, includeFlags, excludeFlags, smoothPath);
+    }
+
+    uint32_t detour::find_smoothPath_preset(const glm::vec3& startPoint, const glm::vec3& endPoint, uint32_t preset, float* smoothPath)
+    {
+        return findSmoothPath(startPoint, endPoint, preset, 0, 0, smoothPath);
+    }
+
+    uint32_t detour::findSmoothPath(const glm::vec3& startPoint, const glm::vec3& endPoint, uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags, float* smoothPath)
+    {
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        QueryPool::Lease query = m_queryPool.acquire(currentMesh());
+        if (!query)
+            return 0;
+
 
         const float* startPtr = glm::value_ptr(startPoint);
         const float* endPtr = glm::value_ptr(endPoint);
@@ -479,28 +931,23 @@ namespace eqoa
         float nearestEndPos[3];
 
         dtQueryFilter filter;
-        filter.setIncludeFlags(includeFlags);
-        filter.setExcludeFlags(excludeFlags);
-
-        filter.setAreaCost(SAMPLE_POLYAREA_GROUND, 1.0f);
-        filter.setAreaCost(SAMPLE_POLYAREA_WATER, 1.5f);
-        filter.setAreaCost(SAMPLE_POLYAREA_MUD, 3.0f);
-        filter.setAreaCost(SAMPLE_POLYAREA_LAVA, 100.0f);  // Basically avoid
-        filter.setAreaCost(SAMPLE_POLYAREA_SLIME, 3.0f);   // Swim: slime (mud-like cost)
+        uint32_t filterKey = 0;
+        if (!selectFilter(filter, filterKey, query, preset, includeFlags, excludeFlags))
+            return 0;
 
         dtPolyRef path[MAX_POLYS];
         dtStatus status = 0;
         int pathCount = 0;
 
         // Find the nearest polygons to the start and end points
-        status = m_dtNavMeshQuery->findNearestPoly(startPtr, halfExtents, &filter, &startRef, nearestStartPos);
+        status = query->findNearestPoly(startPtr, halfExtents, &filter, &startRef, nearestStartPos);
         if (dtStatusFailed(status))
         {
             // std::cout << "Could not find valid start poly! Status: " << status << std::endl;
             return 0;
         }
 
-        status = m_dtNavMeshQuery->findNearestPoly(endPtr, halfExtents, &filter, &endRef, nearestEndPos);
+        status = query->findNearestPoly(endPtr, halfExtents, &filter, &endRef, nearestEndPos);
         if (dtStatusFailed(status))
         {
             // std::cout << "Could not find valid end poly! Status: " << status << std::endl;
@@ -508,7 +955,7 @@ namespace eqoa
         }
 
         // Find a path between the start and end polygons
-        status = m_dtNavMeshQuery->findPath(startRef, endRef, nearestStartPos, nearestEndPos, &filter, path, &pathCount, MAX_POLYS);
+        status = query->findPath(startRef, endRef, nearestStartPos, nearestEndPos, &filter, path, &pathCount, MAX_POLYS);
         if (dtStatusFailed(status) || pathCount == 0)
         {
             // std::cout << "Could not find valid path! Status: " << status << std::endl;
@@ -517,8 +964,8 @@ namespace eqoa
 
         // Refining the path using moveAlongSurface for a smoother path
         float iterPos[3], targetPos[3];
-        m_dtNavMeshQuery->closestPointOnPoly(startRef, nearestStartPos, iterPos, nullptr);
-        m_dtNavMeshQuery->closestPointOnPoly(path[pathCount - 1], nearestEndPos, targetPos, nullptr);
+        query->closestPointOnPoly(startRef, nearestStartPos, iterPos, nullptr);
+        query->closestPointOnPoly(path[pathCount - 1], nearestEndPos, targetPos, nullptr);
 
         const float STEP_SIZE = 2.0f;
         const float SLOP = 0.01f;
@@ -534,7 +981,7 @@ namespace eqoa
             dtPolyRef steerPosRef;
 
             // Custom function to get the steer target, not provided in the original code snippet
-            if (!getSteerTarget(m_dtNavMeshQuery.get(), iterPos, targetPos, SLOP, path, pathCount, steerPos, steerPosFlag, steerPosRef))
+            if (!getSteerTarget(query.get(), iterPos, targetPos, SLOP, path, pathCount, steerPos, steerPosFlag, steerPosRef))
                 break;
 
             bool atEnd = steerPosFlag & DT_STRAIGHTPATH_END;
@@ -555,13 +1002,13 @@ namespace eqoa
             float result[3];
             dtPolyRef visited[16];
             int nvisited = 0;
-            m_dtNavMeshQuery->moveAlongSurface(path[0], iterPos, moveTgt, &filter, result, visited, &nvisited, 16);
+            query->moveAlongSurface(path[0], iterPos, moveTgt, &filter, result, visited, &nvisited, 16);
 
             pathCount = fixupCorridor(path, pathCount, MAX_POLYS, visited, nvisited);
-            pathCount = fixupShortcuts(path, pathCount, m_dtNavMeshQuery.get());
+            pathCount = fixupShortcuts(path, pathCount, query.get());
 
             float h = 0;
-            m_dtNavMeshQuery->getPolyHeight(path[0], result, &h);
+            query->getPolyHeight(path[0], result, &h);
             result[1] = h;
             dtVcopy(iterPos, result);
 
@@ -576,9 +1023,11 @@ namespace eqoa
     }
 
 
-    uint32_t detour::check_los(const glm::vec3& start, const glm::vec3& target, float* range, uint16_t includeFlags, uint16_t excludeFlags)
+    // Line-of-sight test shared by check_los and the batch executor.
+    // Returns 0 when a point cannot be snapped, 1 when out of range, 2 when
+    // blocked and 5 when the target is visible.
+    static uint32_t lineOfSight(dtNavMeshQuery* query, const dtPolyOverlay* overlay, const glm::vec3& start, const glm::vec3& target, float range, uint16_t includeFlags, uint16_t excludeFlags)
     {
-        m_dtNavMeshQuery->init(m_dtNavMesh.get(), 65535);
         float distance = glm::distance(start, target);
 
         // Determine if this is a liquid search (player at surface, polys on river bed)
@@ -607,9 +1056,9 @@ namespace eqoa
         float startOnMesh[3] = { 0,0,0 };
         float endOnMesh[3] = { 0,0,0 };
 
-        dtQueryFilter filter;
-        filter.setIncludeFlags(includeFlags);
-        filter.setExcludeFlags(excludeFlags);
+        // The ray is cast without costs, so only the flags matter.
+        dtFlagsQueryFilter filter(includeFlags, excludeFlags);
+        filter.setPolyOverlay(overlay);
 
         dtRaycastHit hit;
         dtPolyRef prevRef = 0;
@@ -619,21 +1068,21 @@ namespace eqoa
         int pathCount;
         const int maxPath = 256;
 
-        if (distance > *range)
+        if (distance > range)
         {
             //std::cout << "target is out of range. Distance: " << distance << " range: " << *range << std::endl;
             return 1;
         }
 
         // Snap Start
-        status = m_dtNavMeshQuery->findNearestPoly(startPt, halfExtents, &filter, &startRef, startOnMesh);
+        status = query->findNearestPoly(startPt, halfExtents, &filter, &startRef, startOnMesh);
         if (dtStatusFailed(status) || !startRef)
         {            
             return 0;
         }
 
         // Snap END
-        status = m_dtNavMeshQuery->findNearestPoly(targetPt, halfExtents, &filter, &endRef, endOnMesh);
+        status = query->findNearestPoly(targetPt, halfExtents, &filter, &endRef, endOnMesh);
         if (dtStatusFailed(status) || !endRef)
             return 0;
 
@@ -649,17 +1098,20 @@ namespace eqoa
 
         // Raycast (2D end-Y ignored per Detour docs)
         float t = 0.0f;
-        float hitNormal[3] = { 0,0,0 };
 
         constexpr int kMaxRayPath = 256;
         dtPolyRef rayPath[kMaxRayPath];
         int rayPathCount = 0;
 
-        status = m_dtNavMeshQuery->raycast(startRef, startOnMesh, endOnMesh, &filter, &t, hitNormal, rayPath, &rayPathCount, kMaxRayPath);
+        hit.path = rayPath;
+        hit.maxPath = kMaxRayPath;
+        status = query->raycast(startRef, startOnMesh, endOnMesh, &filter, 0, &hit);
         if (dtStatusFailed(status))
         {
             return 0;
         }
+        t = hit.t;
+        rayPathCount = hit.pathCount;
 
         if (t >= 3e+38)
         {
@@ -677,38 +1129,355 @@ namespace eqoa
 
         //std::cout << "LoS Failed!" << std::endl;
         return 2;
-    }    
+    }
 
-    uint32_t eqoa::detour::getPolyFlags(const glm::vec3& pos, uint16_t includeFlags, uint16_t excludeFlags)
-    {        
-        m_dtNavMeshQuery->init(m_dtNavMesh.get(), 65535);
-        
-        const glm::vec3 extents(3.0f,30.0f, 3.f);
+    uint32_t detour::check_los(const glm::vec3& start, const glm::vec3& target, float* range, uint16_t includeFlags, uint16_t excludeFlags)
+    {
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        QueryPool::Lease query = m_queryPool.acquire(currentMesh());
+        if (!query)
+            return 0;
+
+        return lineOfSight(query.get(), overlayFor(query.generation()), start, target, *range, includeFlags, excludeFlags);
+    }
+
+    uint32_t detour::set_worker_threads(int threadCount, const uint64_t* affinityMasks)
+    {
+        if (!m_workers.start(threadCount, affinityMasks))
+            return 0;
+
+        m_queryPool.reserve(threadCount, currentMesh());
+        return 1;
+    }
+
+    uint32_t detour::run_batch(int count, const NavRequest* requests, NavResult* results, float* outPoints, int maxPointsPerRequest)
+    {
+        if (count <= 0 || !requests || !results)
+            return 0;
+
+        if (m_workers.size() == 0)
+            set_worker_threads((int)std::max(1u, std::thread::hardware_concurrency()), nullptr);
+
+        // The whole batch runs on the mesh that is current now, even if a
+        // new one is loaded meanwhile.
+        const NavMeshHandle mesh = currentMesh();
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+
+        // Each worker checks out its own query on first use and keeps it for
+        // the rest of the batch; the mesh itself is shared read-only. The
+        // leases are sized by the pool under its run lock, so a concurrent
+        // set_worker_threads can not change the worker count in between.
+        std::vector<QueryPool::Lease> queries;
+        std::atomic<uint32_t> succeeded(0);
+
+        const glm::vec3 extents(2.0f, 50.0f, 2.0f);
         const float* halfExtents = glm::value_ptr(extents);
-        
+
+        m_workers.parallelFor(count, [&](int workerCount)
+        {
+            queries.resize(workerCount);
+        },
+        [&](int worker, int begin, int end)
+        {
+            QueryPool::Lease& query = queries[worker];
+            if (!query)
+                query = m_queryPool.acquire(mesh);
+
+            dtQueryFilter filter;
+            initPathFilter(filter, 0, 0);
+            const dtPolyOverlay* overlay = overlayFor(mesh ? mesh->generation : 0);
+            filter.setPolyOverlay(overlay);
+
+            uint32_t ok = 0;
+            for (int i = begin; i < end; ++i)
+            {
+                const NavRequest& request = requests[i];
+                NavResult& result = results[i];
+                result.offset = i * maxPointsPerRequest;
+                result.count = 0;
+
+                if (!query)
+                {
+                    result.status = request.type == NAV_REQUEST_LOS ? 0 : PATH_REQUEST_FAILED;
+                    continue;
+                }
+
+                if (request.type == NAV_REQUEST_LOS)
+                {
+                    const glm::vec3 start(request.start[0], request.start[1], request.start[2]);
+                    const glm::vec3 target(request.end[0], request.end[1], request.end[2]);
+                    result.status = lineOfSight(query.get(), overlay, start, target, request.range, request.includeFlags, request.excludeFlags);
+                    if (result.status == 5)
+                        ok++;
+                    continue;
+                }
+
+                filter.setIncludeFlags(request.includeFlags);
+                filter.setExcludeFlags(request.excludeFlags);
+
+                dtPolyRef startRef = 0, endRef = 0;
+                float startPt[3], endPt[3];
+                if (dtStatusFailed(query->findNearestPoly(request.start, halfExtents, &filter, &startRef, startPt)) || !startRef)
+                {
+                    result.status = PATH_REQUEST_NO_START_POLY;
+                    continue;
+                }
+                if (dtStatusFailed(query->findNearestPoly(request.end, halfExtents, &filter, &endRef, endPt)) || !endRef)
+                {
+                    result.status = PATH_REQUEST_NO_END_POLY;
+                    continue;
+                }
+
+                result.status = straightPathBetween(query, &filter, 0, &m_pathCache, &m_searchStats, m_searchMode.load(std::memory_order_relaxed), startRef, startPt, endRef, endPt,
+                    outPoints ? &outPoints[(size_t)result.offset * 3] : nullptr, outPoints ? maxPointsPerRequest : 0, &result.count);
+                if (result.status == PATH_REQUEST_OK || result.status == PATH_REQUEST_PARTIAL)
+                    ok++;
+            }
+            succeeded += ok;
+        });
+
+        return succeeded.load();
+    }    
+
+    // Nearest poly to pos that passes the flag filter, as used by the poly
+    // flag calls. 0 if there is none.
+    static dtPolyRef nearestFlagPoly(dtNavMeshQuery* query, const dtPolyOverlay* overlay, const glm::vec3& pos,
+        uint16_t includeFlags, uint16_t excludeFlags)
+    {
+        const glm::vec3 extents(3.0f, 30.0f, 3.f);
+
         dtQueryFilter filter;
         filter.setIncludeFlags(includeFlags);
         filter.setExcludeFlags(excludeFlags);
-        
+        filter.setPolyOverlay(overlay);
+
         dtPolyRef ref = 0;
         float nearestPt[3];
-        dtStatus status = m_dtNavMeshQuery->findNearestPoly(glm::value_ptr(pos), halfExtents, &filter, &ref, nearestPt);
+        dtStatus status = query->findNearestPoly(glm::value_ptr(pos), glm::value_ptr(extents), &filter, &ref, nearestPt);
+        if (dtStatusFailed(status))
+            return 0;
+        return ref;
+    }
 
-        if (dtStatusFailed(status) || !ref)
+    const dtPolyOverlay* detour::overlayFor(uint32_t generation) const
+    {
+        if (m_overlayGeneration != generation || m_flagOverlay.getOverrideCount() == 0)
+            return nullptr;
+        return &m_flagOverlay;
+    }
+
+    bool detour::prepareOverlay(const QueryPool::Lease& query)
+    {
+        if (m_overlayGeneration == query.generation())
+            return true;
+
+        // First change since the mesh was swapped, the old overrides belong
+        // to the previous mesh and are dropped.
+        if (dtStatusFailed(m_flagOverlay.init(query.mesh())))
+            return false;
+        m_overlayGeneration = query.generation();
+        return true;
+    }
+
+    uint32_t eqoa::detour::getPolyFlags(const glm::vec3& pos, uint16_t includeFlags, uint16_t excludeFlags)
+    {        
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        QueryPool::Lease query = m_queryPool.acquire(currentMesh());
+        if (!query)
+            return UINT32_MAX;
+
+        const dtPolyOverlay* overlay = overlayFor(query.generation());
+        dtPolyRef ref = nearestFlagPoly(query.get(), overlay, pos, includeFlags, excludeFlags);
+        if (!ref)
             return UINT32_MAX;        
 
         unsigned short flags = 0;
-        m_dtNavMesh->getPolyFlags(ref, &flags);
+        if (overlay)
+            overlay->getPolyFlags(ref, &flags);
+        else
+            query.mesh()->getPolyFlags(ref, &flags);
 
         // ► Return the full flag bits now:
         return flags;
     }
 
+    uint32_t detour::set_poly_flags(const glm::vec3& pos, uint16_t includeFlags, uint16_t excludeFlags, uint16_t flags)
+    {
+        // Writers take the overlay exclusively so no query sees a half-updated poly.
+        std::unique_lock<std::shared_mutex> meshLock(m_meshMutex);
+        QueryPool::Lease query = m_queryPool.acquire(currentMesh());
+        if (!query || !prepareOverlay(query))
+            return UINT32_MAX;
+
+        dtPolyRef ref = nearestFlagPoly(query.get(), overlayFor(query.generation()), pos, includeFlags, excludeFlags);
+        if (!ref)
+            return UINT32_MAX;
+
+        unsigned short oldFlags = 0;
+        m_flagOverlay.getPolyFlags(ref, &oldFlags);
+        if (dtStatusFailed(m_flagOverlay.setPolyFlags(ref, flags)))
+            return UINT32_MAX;
+
+        // Cached corridors may cross the poly that just changed.
+        if (oldFlags != flags)
+            m_pathCache.clear();
+
+        return oldFlags;
+    }
+
+    uint32_t detour::reset_poly_flags(const glm::vec3& pos, uint16_t includeFlags, uint16_t excludeFlags)
+    {
+        std::unique_lock<std::shared_mutex> meshLock(m_meshMutex);
+        QueryPool::Lease query = m_queryPool.acquire(currentMesh());
+        if (!query || !prepareOverlay(query))
+            return UINT32_MAX;
+
+        // Matched against the mesh flags, a poly blocked with flags 0 would
+        // not pass any filter otherwise.
+        dtPolyRef ref = nearestFlagPoly(query.get(), nullptr, pos, includeFlags, excludeFlags);
+        if (!ref)
+            return UINT32_MAX;
+
+        unsigned short oldFlags = 0, meshFlags = 0;
+        m_flagOverlay.getPolyFlags(ref, &oldFlags);
+        query.mesh()->getPolyFlags(ref, &meshFlags);
+        m_flagOverlay.resetPoly(ref);
+
+        if (oldFlags != meshFlags)
+            m_pathCache.clear();
+
+        return meshFlags;
+    }
+
+    uint32_t detour::copy_poly_flags(detour& source)
+    {
+        if (&source == this)
+            return 1;
+
+        std::unique_lock<std::shared_mutex> lock(m_meshMutex, std::defer_lock);
+        std::unique_lock<std::shared_mutex> sourceLock(source.m_meshMutex, std::defer_lock);
+        std::lock(lock, sourceLock);
+
+        // Overrides only carry over between instances on the same mesh.
+        const NavMeshHandle mesh = currentMesh();
+        const NavMeshHandle sourceMesh = source.currentMesh();
+        if (!mesh || !sourceMesh || sourceMesh->generation != mesh->generation)
+            return 0;
+
+        const dtStatus status = source.m_overlayGeneration == mesh->generation
+            ? m_flagOverlay.copyFrom(source.m_flagOverlay)
+            : m_flagOverlay.init(mesh->mesh.get());
+        if (dtStatusFailed(status))
+            return 0;
+
+        m_overlayGeneration = mesh->generation;
+        m_pathCache.clear();
+        return 1;
+    }
+
+    uint32_t detour::diff_poly_flags(detour& other)
+    {
+        if (&other == this)
+            return 0;
+
+        std::shared_lock<std::shared_mutex> lock(m_meshMutex, std::defer_lock);
+        std::shared_lock<std::shared_mutex> otherLock(other.m_meshMutex, std::defer_lock);
+        std::lock(lock, otherLock);
+
+        const NavMeshHandle mesh = currentMesh();
+        const NavMeshHandle otherMesh = other.currentMesh();
+        if (!mesh || !otherMesh || mesh->generation != otherMesh->generation)
+            return UINT32_MAX;
+
+        // An instance without changes on this mesh compares as the plain mesh.
+        dtPolyOverlay empty;
+        empty.init(mesh->mesh.get());
+        const dtPolyOverlay* mine = m_overlayGeneration == mesh->generation ? &m_flagOverlay : &empty;
+        const dtPolyOverlay* theirs = other.m_overlayGeneration == mesh->generation ? &other.m_flagOverlay : &empty;
+
+        int count = 0;
+        if (dtStatusFailed(mine->diff(*theirs, nullptr, &count, 0)))
+            return UINT32_MAX;
+        return (uint32_t)count;
+    }
+
      void detour::unload()
     {
         //Both mesh and query will be freed when detour instance is destroyed
         //do we need anything here?
     }
-}
 
+    uint32_t detour::request_path(const glm::vec3& startPoint, const glm::vec3& endPoint, uint16_t includeFlags, uint16_t excludeFlags)
+    {
+        const glm::vec3 extents(2.0f, 50.0f, 2.0f);
+
+        dtQueryFilter filter;
+        initPathFilter(filter, includeFlags, excludeFlags);
+
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        const NavMeshHandle mesh = currentMesh();
+        filter.setPolyOverlay(overlayFor(mesh ? mesh->generation : 0));
 
+        return m_pathQueue.request(glm::value_ptr(startPoint), glm::value_ptr(endPoint), glm::value_ptr(extents), filter);
+    }
+
+    uint32_t detour::update_paths(int maxIterations)
+    {
+        std::shared_lock<std::shared_mutex> meshLock(m_meshMutex);
+        return (uint32_t)m_pathQueue.update(maxIterations);
+    }
+
+    uint32_t detour::get_path_status(uint32_t handle)
+    {
+        return m_pathQueue.status(handle);
+    }
+
+    uint32_t detour::get_path_result(uint32_t handle, float* strPath, int maxPoints)
+    {
+        return (uint32_t)m_pathQueue.result(handle, strPath, maxPoints);
+    }
+
+    uint32_t detour::cancel_path(uint32_t handle)
+    {
+        return m_pathQueue.cancel(handle) ? 1 : 0;
+    }
+
+    uint32_t detour::configure_path_cache(uint64_t maxBytes, float quantum)
+    {
+        m_pathCache.configure((size_t)maxBytes, quantum);
+        return 1;
+    }
+
+    uint32_t detour::get_path_cache_stats(uint64_t* hits, uint64_t* misses, uint64_t* entries, uint64_t* bytes)
+    {
+        m_pathCache.stats(hits, misses, entries, bytes);
+        return 1;
+    }
+
+    uint32_t detour::get_search_stats(uint64_t* searches, uint64_t* nodes, uint64_t* landmarkSearches, uint64_t* landmarkNodes)
+    {
+        if (searches)
+            *searches = m_searchStats.searches.load(std::memory_order_relaxed);
+        if (nodes)
+            *nodes = m_searchStats.nodes.load(std::memory_order_relaxed);
+        if (landmarkSearches)
+            *landmarkSearches = m_searchStats.landmarkSearches.load(std::memory_order_relaxed);
+        if (landmarkNodes)
+            *landmarkNodes = m_searchStats.landmarkNodes.load(std::memory_order_relaxed);
+        return 1;
+    }
+
+    uint32_t detour::set_search_mode(uint32_t mode)
+    {
+        const uint32_t direction = mode & ~PATH_SEARCH_QUATERNARY_HEAP;
+        if (direction != PATH_SEARCH_FORWARD && direction != PATH_SEARCH_BIDIRECTIONAL)
+            return 0;
+
+        // Corridors found the other way can differ, so cached paths go. The
+        // mode is part of the cache key, so searches still running with the
+        // old mode can not add entries this mode would hit.
+        m_searchMode.store(mode, std::memory_order_relaxed);
+        m_pathCache.clear();
+        return 1;
+    }
+}
@@ -5,18 +5,37 @@
 #pragma once
 #endif
 
+#include <atomic>
 #include <cstdint>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
+#include "DetourPolyOverlay.h"
+#include "MeshRegistry.h"
+#include "NavMeshLoader.h"
+#include "PathCache.h"
+#include "PathQueue.h"
+#include "QueryPool.h"
+#include "ThreadPool.h"
 
 #define MAX_POLYS 256
 #define MAX_SMOOTH 2048
 
+// Tiles apart, along either axis, the ends of a path have to be before the
+// search goes over the tile graph of meshes loaded with NAVMESH_LOAD_HIERARCHY.
+#define HIERARCHY_MIN_TILES 4
+
+// Number of filter preset slots per instance, and the id that selects the
+// default area costs with per-call flags instead of a preset.
+#define MAX_FILTER_PRESETS 64
+#define FILTER_PRESET_NONE 0xffffffffu
+
 enum SamplePolyAreas
 {
     SAMPLE_POLYAREA_GROUND = 0,
@@ -37,24 +56,153 @@ enum SamplePolyFlags
     SAMPLE_POLYFLAGS_ALL = 0xffff
 };
 
+// Per-request result codes of the batched and queued path APIs.
+enum PathRequestStatus
+{
+    PATH_REQUEST_OK = 0,            // Path reaches the end point.
+    PATH_REQUEST_PARTIAL = 1,       // End not reachable, path leads to the closest reachable polygon.
+    PATH_REQUEST_NO_START_POLY = 2, // No polygon near the start point passes the filter.
+    PATH_REQUEST_NO_END_POLY = 3,   // No polygon near the end point passes the filter.
+    PATH_REQUEST_FAILED = 4,        // Path search failed.
+    PATH_REQUEST_OUT_OF_SPACE = 5,  // Output buffer full, path truncated.
+    PATH_REQUEST_PENDING = 6,       // Queued request still being searched.
+    PATH_REQUEST_INVALID_HANDLE = 7 // Unknown, collected or expired path queue handle.
+};
+
+// How set_search_mode has full path searches run.
+enum PathSearchMode
+{
+    PATH_SEARCH_FORWARD = 0,        // A* from the start, dtNavMeshQuery::findPath.
+    PATH_SEARCH_BIDIRECTIONAL = 1,  // From both ends at once, dtNavMeshQuery::findPathBidirectional.
+    PATH_SEARCH_QUATERNARY_HEAP = 0x100 // Flag: forward searches keep their open list in a 4-ary heap,
+                                        // DT_OPEN_LIST_QUATERNARY_HEAP.
+};
+
+enum NavRequestType
+{
+    NAV_REQUEST_PATH = 0,           // Straight path from start to end.
+    NAV_REQUEST_LOS = 1             // Line of sight from start to end within range.
+};
+
+// One entry of a run_batch call. Laid out for direct marshalling from C#.
+struct NavRequest
+{
+    uint32_t type;                  // NavRequestType
+    float start[3];
+    float end[3];
+    uint16_t includeFlags;
+    uint16_t excludeFlags;
+    float range;                    // NAV_REQUEST_LOS only.
+};
+
+struct NavResult
+{
+    uint32_t status;                // PathRequestStatus, or the check_los return code for NAV_REQUEST_LOS.
+    int offset;                     // First point of the path in the output buffer.
+    int count;                      // Number of path points.
+};
+
 namespace eqoa
 {
+    // Polygon by polygon path searches of an instance and the nodes they
+    // touched, in total and for the ones guided by landmarks.
+    struct SearchStats
+    {
+        std::atomic<uint64_t> searches{0};
+        std::atomic<uint64_t> nodes{0};
+        std::atomic<uint64_t> landmarkSearches{0};
+        std::atomic<uint64_t> landmarkNodes{0};
+    };
+
     class  detour
     {
     public:
         detour();
         ~detour();
-        uint32_t load(const std::string& filePath);
+        uint32_t load(const std::string& filePath, uint32_t flags = NAVMESH_LOAD_COPY, NavMeshLoadStats* stats = nullptr);
+        uint32_t save_snapshot(const std::string& filePath);
         uint32_t find_path(const glm::vec3& startPoint, const glm::vec3& endPoint, uint16_t includeFlags, uint16_t excludeFlags, float* strPath);
+        uint32_t find_path_preset(const glm::vec3& startPoint, const glm::vec3& endPoint, uint32_t preset, float* strPath);
+        uint32_t find_path_into(const glm::vec3& startPoint, const glm::vec3& endPoint, uint16_t includeFlags, uint16_t excludeFlags,
+            float* outPoints, int maxPoints, unsigned char* outFlags, dtPolyRef* outRefs, int* outCount);
+        uint32_t find_path_batch(int count, const glm::vec3* startPoints, const glm::vec3* endPoints,
+            const uint16_t* includeFlags, const uint16_t* excludeFlags,
+            float* outPoints, int outCapacity, int* outOffsets, int* outCounts, uint32_t* outStatus);
         uint32_t find_smoothPath(const glm::vec3& startPoint, const glm::vec3& endPoint, uint16_t includeFlags, uint16_t excludeFlags, float* smoothPath);
+        uint32_t find_smoothPath_preset(const glm::vec3& startPoint, const glm::vec3& endPoint, uint32_t preset, float* smoothPath);
         uint32_t random_point(const glm::vec3& centerPoint, float radius, uint16_t includeFlags, uint16_t excludeFlags, float* rndPoint);
+        uint32_t random_point_preset(const glm::vec3& centerPoint, float radius, uint32_t preset, float* rndPoint);
+        uint32_t set_filter_preset(uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags, const float* areaCosts);
+        uint32_t remove_filter_preset(uint32_t preset);
         uint32_t check_los(const glm::vec3& start, const glm::vec3& target, float* range, uint16_t includeFlags, uint16_t excludeFlags);
         uint32_t getPolyFlags(const glm::vec3& pos, uint16_t includeFlags, uint16_t excludeFlags);
+        uint32_t set_poly_flags(const glm::vec3& pos, uint16_t includeFlags, uint16_t excludeFlags, uint16_t flags);
+        uint32_t reset_poly_flags(const glm::vec3& pos, uint16_t includeFlags, uint16_t excludeFlags);
+        uint32_t copy_poly_flags(detour& source);
+        uint32_t diff_poly_flags(detour& other);
+        uint32_t reserve_queries(int count);
+        uint32_t set_worker_threads(int threadCount, const uint64_t* affinityMasks);
+        uint32_t run_batch(int count, const NavRequest* requests, NavResult* results, float* outPoints, int maxPointsPerRequest);
+        uint32_t request_path(const glm::vec3& startPoint, const glm::vec3& endPoint, uint16_t includeFlags, uint16_t excludeFlags);
+        uint32_t update_paths(int maxIterations);
+        uint32_t get_path_status(uint32_t handle);
+        uint32_t get_path_result(uint32_t handle, float* strPath, int maxPoints);
+        uint32_t cancel_path(uint32_t handle);
+        uint32_t configure_path_cache(uint64_t maxBytes, float quantum);
+        uint32_t get_path_cache_stats(uint64_t* hits, uint64_t* misses, uint64_t* entries, uint64_t* bytes);
+        uint32_t get_search_stats(uint64_t* searches, uint64_t* nodes, uint64_t* landmarkSearches, uint64_t* landmarkNodes);
+        uint32_t set_search_mode(uint32_t mode);
 
     private:
         void unload();
-        std::unique_ptr<dtNavMesh> m_dtNavMesh;
-        std::unique_ptr<dtNavMeshQuery> m_dtNavMeshQuery;
+
+        // Snapshot of the mesh new requests run on. Callers keep the handle
+        // until they are done with the mesh.
+        NavMeshHandle currentMesh() const;
+
+        // The flag overlay if it holds changes for the given mesh generation.
+        // Callers hold m_meshMutex.
+        const dtPolyOverlay* overlayFor(uint32_t generation) const;
+
+        // Rebinds the overlay to the lease's mesh if it was made for another
+        // one. Callers hold m_meshMutex exclusively.
+        bool prepareOverlay(const QueryPool::Lease& query);
+
+        // Fills filter for a call: the default area costs with the given
+        // flags for FILTER_PRESET_NONE, otherwise a registered preset. filterKey
+        // tells cached paths of different filters apart. False for an unknown
+        // preset. Callers hold m_meshMutex.
+        bool selectFilter(dtQueryFilter& filter, uint32_t& filterKey, const QueryPool::Lease& query,
+            uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags) const;
+
+        // Straight path into the caller's buffers, returns a PathRequestStatus.
+        // Without longPath the corridor is cut at MAX_POLYS polys.
+        uint32_t findPath(const glm::vec3& startPoint, const glm::vec3& endPoint, uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags,
+            float* outPoints, int maxPoints, unsigned char* outFlags, dtPolyRef* outRefs, int* outCount, bool longPath);
+        uint32_t findSmoothPath(const glm::vec3& startPoint, const glm::vec3& endPoint, uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags, float* smoothPath);
+        uint32_t randomPoint(const glm::vec3& centerPoint, float radius, uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags, float* rndPoint);
+
+        struct FilterPreset
+        {
+            dtQueryFilter filter;
+            uint32_t revision;          // 0 while the slot is empty.
+            bool uniformCost;           // Every area costs 1.0, path searches can use dtFlagsQueryFilter.
+        };
+
+        NavMeshHandle m_mesh;           // Only accessed through std::atomic_load/atomic_store.
+        std::mutex m_swapMutex;         // Orders concurrent load() calls when they publish.
+        QueryPool m_queryPool;
+        ThreadPool m_workers;
+        PathQueue m_pathQueue;
+        PathCache m_pathCache;
+        SearchStats m_searchStats;
+        std::atomic<uint32_t> m_searchMode; // PathSearchMode of the full path searches.
+        dtPolyOverlay m_flagOverlay;    // This instance's poly flag changes on top of the (possibly shared) mesh.
+        uint32_t m_overlayGeneration;   // Mesh generation m_flagOverlay was bound to.
+        dtQueryFilter m_defaultFilter;  // Area costs of the calls that pass flags instead of a preset.
+        FilterPreset m_filterPresets[MAX_FILTER_PRESETS];
+        uint32_t m_presetRevision;
+        std::shared_mutex m_meshMutex;  // Shared by queries, exclusive while the flag overlay or the presets are written.
     };
 }
 
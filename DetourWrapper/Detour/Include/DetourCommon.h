@@ -416,6 +416,106 @@ bool dtDistancePtPolyEdgesSqr(const float* pt, const float* verts, const int nve
 
 float dtDistancePtSegSqr2D(const float* pt, const float* p, const float* q, float& t);
 
+/// The number of segments or triangles in a block of the batched closest
+/// point functions.
+static const int DT_BATCH_WIDTH = 4;
+
+/// Derives the squared distances on the xz-plane from a point to a block of
+/// segments, with the same results as #dtDistancePtSegSqr2D for each.
+///  @param[in]		pt		The point. [(x, y, z)]
+///  @param[in]		p		The start points of the segments. [(x, y, z) * #DT_BATCH_WIDTH]
+///  @param[in]		q		The end points of the segments. [(x, y, z) * #DT_BATCH_WIDTH]
+///  @param[out]	dist	The squared distances. [Size: #DT_BATCH_WIDTH]
+///  @param[out]	t		The parameters of the closest points along the segments. [Size: #DT_BATCH_WIDTH]
+inline void dtDistancePtSegsSqr2D(const float* pt, const float* const* p, const float* const* q, float* dist, float* t)
+{
+#ifdef DT_SSE2
+	// The operations of dtDistancePtSegSqr2D in the same order, so the
+	// results are the same bit for bit.
+	const __m128 ptx = _mm_set1_ps(pt[0]);
+	const __m128 ptz = _mm_set1_ps(pt[2]);
+	const __m128 px = _mm_setr_ps(p[0][0], p[1][0], p[2][0], p[3][0]);
+	const __m128 pz = _mm_setr_ps(p[0][2], p[1][2], p[2][2], p[3][2]);
+	const __m128 pqx = _mm_sub_ps(_mm_setr_ps(q[0][0], q[1][0], q[2][0], q[3][0]), px);
+	const __m128 pqz = _mm_sub_ps(_mm_setr_ps(q[0][2], q[1][2], q[2][2], q[3][2]), pz);
+	__m128 dx = _mm_sub_ps(ptx, px);
+	__m128 dz = _mm_sub_ps(ptz, pz);
+	const __m128 d = _mm_add_ps(_mm_mul_ps(pqx, pqx), _mm_mul_ps(pqz, pqz));
+	__m128 s = _mm_add_ps(_mm_mul_ps(pqx, dx), _mm_mul_ps(pqz, dz));
+	const __m128 positive = _mm_cmpgt_ps(d, _mm_setzero_ps());
+	s = _mm_or_ps(_mm_and_ps(positive, _mm_div_ps(s, d)), _mm_andnot_ps(positive, s));
+	s = _mm_andnot_ps(_mm_cmplt_ps(s, _mm_setzero_ps()), s);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 above = _mm_cmpgt_ps(s, one);
+	s = _mm_or_ps(_mm_and_ps(above, one), _mm_andnot_ps(above, s));
+	dx = _mm_sub_ps(_mm_add_ps(px, _mm_mul_ps(s, pqx)), ptx);
+	dz = _mm_sub_ps(_mm_add_ps(pz, _mm_mul_ps(s, pqz)), ptz);
+	_mm_storeu_ps(dist, _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)));
+	_mm_storeu_ps(t, s);
+#else
+	for (int i = 0; i < DT_BATCH_WIDTH; ++i)
+		dist[i] = dtDistancePtSegSqr2D(pt, p[i], q[i], t[i]);
+#endif
+}
+
+/// Finds the first triangle of a block that contains the point on the
+/// xz-plane, with the same result as #dtClosestHeightPointTriangle for each
+/// triangle in turn.
+///  @param[in]		p		The point. [(x, y, z)]
+///  @param[in]		tris	The vertices of the triangles, all A vertices, then all B and all C. [(x, y, z) * 3 * #DT_BATCH_WIDTH]
+///  @param[in]		ntris	The number of triangles to test. [Limit: 0 < value <= #DT_BATCH_WIDTH]
+///  @param[out]	h		The height of the triangle at the point.
+/// @return The index of the triangle in the block, or -1 if none contains the point.
+inline int dtClosestHeightPointTriangles(const float* p, const float* const* tris, int ntris, float& h)
+{
+#ifdef DT_SSE2
+	// Finds the triangles dtClosestHeightPointTriangle accepts with the same
+	// operations, then lets it compute the height of the first one.
+	const float* const* a = tris;
+	const float* const* b = tris + DT_BATCH_WIDTH;
+	const float* const* c = tris + DT_BATCH_WIDTH*2;
+	const __m128 ax = _mm_setr_ps(a[0][0], a[1][0], a[2][0], a[3][0]);
+	const __m128 az = _mm_setr_ps(a[0][2], a[1][2], a[2][2], a[3][2]);
+	const __m128 v0x = _mm_sub_ps(_mm_setr_ps(c[0][0], c[1][0], c[2][0], c[3][0]), ax);
+	const __m128 v0z = _mm_sub_ps(_mm_setr_ps(c[0][2], c[1][2], c[2][2], c[3][2]), az);
+	const __m128 v1x = _mm_sub_ps(_mm_setr_ps(b[0][0], b[1][0], b[2][0], b[3][0]), ax);
+	const __m128 v1z = _mm_sub_ps(_mm_setr_ps(b[0][2], b[1][2], b[2][2], b[3][2]), az);
+	const __m128 v2x = _mm_sub_ps(_mm_set1_ps(p[0]), ax);
+	const __m128 v2z = _mm_sub_ps(_mm_set1_ps(p[2]), az);
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 denom = _mm_sub_ps(_mm_mul_ps(v0x, v1z), _mm_mul_ps(v0z, v1x));
+	__m128 u = _mm_sub_ps(_mm_mul_ps(v1z, v2x), _mm_mul_ps(v1x, v2z));
+	__m128 v = _mm_sub_ps(_mm_mul_ps(v0x, v2z), _mm_mul_ps(v0z, v2x));
+	const __m128 valid = _mm_cmpge_ps(_mm_andnot_ps(signMask, denom), _mm_set1_ps(1e-6f));
+
+	const __m128 flip = _mm_and_ps(_mm_cmplt_ps(denom, _mm_setzero_ps()), signMask);
+	denom = _mm_xor_ps(denom, flip);
+	u = _mm_xor_ps(u, flip);
+	v = _mm_xor_ps(v, flip);
+
+	__m128 inside = _mm_and_ps(valid, _mm_cmpge_ps(u, _mm_setzero_ps()));
+	inside = _mm_and_ps(inside, _mm_cmpge_ps(v, _mm_setzero_ps()));
+	inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_add_ps(u, v), denom));
+
+	const unsigned int mask = (unsigned int)_mm_movemask_ps(inside) & ((1u << ntris) - 1);
+	if (!mask)
+		return -1;
+
+	int i = 0;
+	while (!(mask & (1u << i)))
+		++i;
+	return dtClosestHeightPointTriangle(p, a[i], b[i], c[i], h) ? i : -1;
+#else
+	for (int i = 0; i < ntris; ++i)
+	{
+		if (dtClosestHeightPointTriangle(p, tris[i], tris[DT_BATCH_WIDTH + i], tris[DT_BATCH_WIDTH*2 + i], h))
+			return i;
+	}
+	return -1;
+#endif
+}
+
 /// Derives the centroid of a convex polygon.
 ///  @param[out]	tc		The centroid of the polgyon. [(x, y, z)]
 ///  @param[in]		idx		The polygon indices. [(vertIndex) * @p nidx]
@@ -460,6 +560,16 @@ inline unsigned int dtIlog2(unsigned int v)
 	return r;
 }
 
+/// Returns the index of the lowest set bit of @p v, which must not be zero.
+inline unsigned int dtLowestBit(unsigned int v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned int)__builtin_ctz(v);
+#else
+	return dtIlog2(v & (0u - v));
+#endif
+}
+
 inline int dtAlign4(int x) { return (x+3) & ~3; }
 
 inline int dtOppositeTile(int side) { return (side+4) & 0x7; }
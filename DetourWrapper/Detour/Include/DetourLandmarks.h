@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURLANDMARKS_H
+#define DETOURLANDMARKS_H
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourStatus.h"
+
+/// Stored cost of a polygon a landmark can not reach.
+static const unsigned short DT_LANDMARK_UNREACHABLE = 0xffff;
+
+/// The maximum number of landmarks.
+static const int DT_MAX_LANDMARKS = 16;
+
+/// Path costs from a few landmarks to every polygon of a mesh, for the ALT
+/// heuristic of #dtLandmarkHeuristic. By the triangle inequality the cost
+/// between two polygons is at least the difference of their costs from any
+/// landmark, which unlike the straight-line distance accounts for walls and
+/// dead ends.
+///
+/// Each polygon keeps the lowest and highest cost of the portals to its
+/// neighbours, quantized to 16 bits with one scale for the whole mesh and
+/// stored polygon by polygon, so a lookup reads two shorts per landmark.
+/// @ingroup detour
+class dtLandmarks
+{
+public:
+	dtLandmarks();
+	~dtLandmarks();
+
+	/// Picks landmarks spread over the largest connected part of the mesh
+	/// and computes the path cost from each of them to every polygon.
+	///  @param[in]	nav		The mesh. Must outlive the landmarks.
+	///  @param[in]	filter	The polygons the paths may cross and their costs.
+	///  					It is copied.
+	///  @param[in]	count	The number of landmarks. [Limit: 0 < value <= #DT_MAX_LANDMARKS]
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter, int count);
+
+	/// Returns the quantized lowest costs of polygon @p ref from each
+	/// landmark followed by the highest ones, or null if its tile was not
+	/// there when the costs were computed. Landmarks that can not reach the
+	/// polygon have a lowest cost of #DT_LANDMARK_UNREACHABLE.
+	inline const unsigned short* getCosts(dtPolyRef ref) const
+	{
+		unsigned int salt, it, ip;
+		m_nav->decodePolyId(ref, salt, it, ip);
+		if (it >= (unsigned int)m_maxTiles || m_tileSalts[it] != salt || m_tileOffsets[it] < 0 ||
+			ip >= (unsigned int)m_tilePolyCounts[it])
+			return 0;
+		return &m_costs[(m_tileOffsets[it] + (int)ip) * m_count * 2];
+	}
+
+	/// The cost one step of a stored value stands for.
+	float getCostScale() const { return m_scale; }
+
+	/// The number of landmarks.
+	int getLandmarkCount() const { return m_count; }
+
+	/// A polygon next to landmark @p i.
+	dtPolyRef getLandmark(int i) const { return m_landmarks[i]; }
+
+	/// The mesh the costs were computed for.
+	const dtNavMesh* getNavMesh() const { return m_nav; }
+
+	/// The filter the costs were computed with. The heuristic is a lower
+	/// bound for filters that skip at least the same polygons and charge at
+	/// least the same area costs.
+	const dtQueryFilter* getFilter() const { return &m_filter; }
+
+private:
+	void clear();
+
+	const dtNavMesh* m_nav;
+	dtQueryFilter m_filter;
+	int m_count;
+	dtPolyRef m_landmarks[DT_MAX_LANDMARKS];
+	float m_scale;
+	int m_maxTiles;
+	int m_polyCount;
+	int* m_tileOffsets;				///< First polygon of each tile in m_costs, -1 for empty tiles.
+	int* m_tilePolyCounts;
+	unsigned int* m_tileSalts;
+	unsigned short* m_costs;		///< [(lowest cost from each landmark, highest cost from each landmark) * polygons]
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtLandmarks(const dtLandmarks&);
+	dtLandmarks& operator=(const dtLandmarks&);
+};
+
+/// ALT heuristic for #dtNavMeshQuery::findPath: the larger of the
+/// straight-line distance to the end and the lower bounds the landmark
+/// costs give. Falls back to the distance for polygons without costs.
+/// @ingroup detour
+class dtLandmarkHeuristic
+{
+public:
+	///  @param[in]	landmarks	Landmark costs of the query's mesh.
+	///  @param[in]	endRef		The end polygon of the search.
+	///  @param[in]	endPos		The end position. Must outlive the heuristic. [(x, y, z)]
+	dtLandmarkHeuristic(const dtLandmarks* landmarks, dtPolyRef endRef, const float* endPos) :
+		m_landmarks(landmarks),
+		m_endPos(endPos),
+		m_endCosts(landmarks->getCosts(endRef))
+	{
+	}
+
+	inline float operator()(dtPolyRef ref, const float* pos) const
+	{
+		const float distance = dtVdist(pos, m_endPos);
+		if (!m_endCosts)
+			return distance;
+		const unsigned short* costs = m_landmarks->getCosts(ref);
+		if (!costs)
+			return distance;
+
+		// The search leaves @p ref through one of its portals and enters the
+		// end polygon through one of its portals, so the cost is at least
+		// the gap between the two cost ranges.
+		const int count = m_landmarks->getLandmarkCount();
+		int steps = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			if (costs[i] == DT_LANDMARK_UNREACHABLE || m_endCosts[i] == DT_LANDMARK_UNREACHABLE)
+				continue;
+			steps = dtMax(steps, dtMax((int)costs[i] - (int)m_endCosts[count + i], (int)m_endCosts[i] - (int)costs[count + i]));
+		}
+
+		return dtMax(distance, (float)steps * m_landmarks->getCostScale());
+	}
+
+private:
+	const dtLandmarks* m_landmarks;
+	const float* m_endPos;
+	const unsigned short* m_endCosts;
+};
+
+/// Allocates a landmarks object using the Detour allocator.
+/// @return A landmarks object that is ready for initialization, or null on failure.
+/// @ingroup detour
+dtLandmarks* dtAllocLandmarks();
+
+/// Frees the specified landmarks object using the Detour allocator.
+///  @param[in]	landmarks	A landmarks object allocated using #dtAllocLandmarks
+/// @ingroup detour
+void dtFreeLandmarks(dtLandmarks* landmarks);
+
+#endif // DETOURLANDMARKS_H
@@ -9,6 +9,14 @@ Members in this module are wrappers around the standard math library
 
 #include <math.h>
 
+// SSE2 is part of every x86-64 target. The wide bounding volume test and the
+// batched closest point functions use it there and fall back to scalar code
+// elsewhere.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DT_SSE2 1
+#include <emmintrin.h>
+#endif
+
 inline float dtMathFabsf(float x) { return fabsf(x); }
 inline float dtMathSqrtf(float x) { return sqrtf(x); }
 inline float dtMathFloorf(float x) { return floorf(x); }
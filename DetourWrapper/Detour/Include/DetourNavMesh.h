@@ -20,6 +20,7 @@
 #define DETOURNAVMESH_H
 
 #include "DetourAlloc.h"
+#include "DetourMath.h"
 #include "DetourStatus.h"
 
 // Undefine (or define in a build config) the following line to use 64bit polyref.
@@ -94,6 +95,12 @@ static const unsigned int DT_OFFMESH_CON_BIDIR = 1;
 /// @ingroup detour
 static const int DT_MAX_AREAS = 64;
 
+/// The most tile locations per tile the bounds passed to dtNavMesh::init may
+/// have for the mesh to find tiles through a grid. The grid takes one pointer
+/// per location.
+/// @ingroup detour
+static const int DT_TILE_GRID_MAX_CELLS_PER_TILE = 4;
+
 /// Tile flags used for various functions and fields.
 /// For an example, see dtNavMesh::addTile().
 enum dtTileFlags
@@ -219,6 +226,64 @@ struct dtBVNode
 	int i;							///< The node's index. (Negative for escape sequence.)
 };
 
+/// The number of children of a #dtBVWideNode.
+static const int DT_BV_WIDE_CHILDREN = 8;
+
+/// The maximum depth of a wide bounding volume tree. Tiles whose tree would
+/// be deeper do not get one.
+static const int DT_BV_WIDE_MAX_DEPTH = 32;
+
+/// The child of an unused slot of a #dtBVWideNode. Neither a node index nor
+/// the complement of a polygon index; the slot's box is empty, so no query
+/// overlaps it.
+static const int DT_BV_WIDE_EMPTY = -0x7fffffff - 1;
+
+/// Node of the wide bounding volume tree built from a tile's #dtBVNode tree
+/// when the tile is added. Each node holds up to eight nodes of the binary
+/// tree, the levels between them collapsed, with their bounds stored axis by
+/// axis so one overlap test covers all of them. Children keep the order of
+/// the binary tree.
+/// @note This structure is rarely if ever used by the end user.
+/// @see dtMeshTile, dtOverlapBVWideNode
+struct dtBVWideNode
+{
+	short bmin[3][DT_BV_WIDE_CHILDREN];	///< Minimum bounds of each child, quantized like dtBVNode and offset by -0x8000. [(x, y, z) * children]
+	short bmax[3][DT_BV_WIDE_CHILDREN];	///< Maximum bounds of each child, offset like bmin. Unused children are empty boxes.
+	int child[DT_BV_WIDE_CHILDREN];		///< Index of each child node, the bitwise complement of the polygon index of a leaf, or #DT_BV_WIDE_EMPTY.
+};
+
+/// Returns a mask of the children of @p node that overlap a quantized box,
+/// bit i for child i. The box is offset by -0x8000 like the node bounds, so
+/// signed compares order them the way unsigned ones order dtBVNode bounds.
+///  @param[in]	node	The node.
+///  @param[in]	qmin	Minimum bounds of the box. [(x, y, z)]
+///  @param[in]	qmax	Maximum bounds of the box. [(x, y, z)]
+/// @return The overlapping children.
+inline unsigned int dtOverlapBVWideNode(const dtBVWideNode* node, const short* qmin, const short* qmax)
+{
+#ifdef DT_SSE2
+	__m128i outside = _mm_setzero_si128();
+	for (int i = 0; i < 3; ++i)
+	{
+		const __m128i cmin = _mm_loadu_si128((const __m128i*)node->bmin[i]);
+		const __m128i cmax = _mm_loadu_si128((const __m128i*)node->bmax[i]);
+		outside = _mm_or_si128(outside, _mm_cmpgt_epi16(_mm_set1_epi16(qmin[i]), cmax));
+		outside = _mm_or_si128(outside, _mm_cmpgt_epi16(cmin, _mm_set1_epi16(qmax[i])));
+	}
+	return ~(unsigned int)_mm_movemask_epi8(_mm_packs_epi16(outside, outside)) & 0xff;
+#else
+	unsigned int mask = 0;
+	for (int j = 0; j < DT_BV_WIDE_CHILDREN; ++j)
+	{
+		bool overlap = true;
+		for (int i = 0; i < 3; ++i)
+			overlap = (qmin[i] > node->bmax[i][j] || qmax[i] < node->bmin[i][j]) ? false : overlap;
+		mask |= (unsigned int)overlap << j;
+	}
+	return mask;
+#endif
+}
+
 /// Defines an navigation mesh off-mesh connection within a dtMeshTile object.
 /// An off-mesh connection is a user defined traversable connection made up to two vertices.
 struct dtOffMeshConnection
@@ -300,6 +365,11 @@ struct dtMeshTile
 	/// (Will be null if bounding volumes are disabled.)
 	dtBVNode* bvTree;
 
+	/// The wide bounding volume tree built from #bvTree, root first. Not part
+	/// of the tile data, the mesh owns it. (Null without a bvTree or SSE2, or
+	/// if the bvTree is not a binary tree of nested boxes.)
+	dtBVWideNode* bvWideTree;
+
 	dtOffMeshConnection* offMeshCons;		///< The tile off-mesh connections. [Size: dtMeshHeader::offMeshConCount]
 		
 	unsigned char* data;					///< The tile data. (Not directly accessed under normal situations.)
@@ -333,6 +403,15 @@ struct dtNavMeshParams
 	int maxPolys;					///< The maximum number of polygons each tile can contain. This and maxTiles are used to calculate how many bits are needed to identify tiles and polygons uniquely.
 };
 
+/// The range of tile locations a navigation mesh will hold.
+/// @see dtNavMesh::init
+/// @ingroup detour
+struct dtNavMeshTileBounds
+{
+	int minx, miny;					///< The smallest tile location. [(x, y)]
+	int maxx, maxy;					///< The largest tile location. [(x, y)]
+};
+
 /// A navigation mesh based on tiles of convex polygons.
 /// @ingroup detour
 class dtNavMesh
@@ -349,6 +428,16 @@ public:
 	/// @return The status flags for the operation.
 	dtStatus init(const dtNavMeshParams* params);
 
+	/// Initializes the navigation mesh for tiled use with the tile locations
+	/// known in advance. When the bounds have at most #DT_TILE_GRID_MAX_CELLS_PER_TILE
+	/// locations per tile, tiles are found through a grid over the bounds
+	/// instead of the location hash, and tiles outside the bounds can not be
+	/// added.
+	///  @param[in]	params		Initialization parameters.
+	///  @param[in]	bounds		The locations of all tiles that will be added. [opt]
+	/// @return The status flags for the operation.
+	dtStatus init(const dtNavMeshParams* params, const dtNavMeshTileBounds* bounds);
+
 	/// Initializes the navigation mesh for single tile use.
 	///  @param[in]	data		Data of the new tile. (See: #dtCreateNavMeshData)
 	///  @param[in]	dataSize	The data size of the new tile.
@@ -368,6 +457,31 @@ public:
 	///  @param[out]	result		The tile reference. (If the tile was succesfully added.) [opt]
 	/// @return The status flags for the operation.
 	dtStatus addTile(unsigned char* data, int dataSize, int flags, dtTileRef lastRef, dtTileRef* result);
+
+	/// Reserves the tile slot and attaches the data without building any links.
+	/// Parameters as for addTile(). (See: #connectTileInternal, #connectTileExternal)
+	dtStatus addTileDeferred(unsigned char* data, int dataSize, int flags, dtTileRef lastRef, dtTileRef* result);
+
+	/// Builds the links inside a tile added with addTileDeferred().
+	/// Different tiles can be connected from different threads.
+	///  @param[in]		ref		The tile reference.
+	/// @return The status flags for the operation.
+	dtStatus connectTileInternal(dtTileRef ref);
+
+	/// Adds a tile added with addTileDeferred() to the position lookup and links it
+	/// with its neighbours. Not thread safe.
+	///  @param[in]		ref		The tile reference.
+	/// @return The status flags for the operation.
+	dtStatus connectTileExternal(dtTileRef ref);
+
+	/// Adds a tile whose links were already built by addTile(), without relinking it.
+	///  @param[in]		data			Tile data saved after linking.
+	///  @param[in]		dataSize		Data size of the tile.
+	///  @param[in]		flags			Tile flags. (See: #dtTileFlags)
+	///  @param[in]		tileRef			The reference the tile had when it was saved.
+	///  @param[in]		linksFreeList	The tile's link free list head when it was saved.
+	/// @return The status flags for the operation.
+	dtStatus restoreTile(unsigned char* data, int dataSize, int flags, dtTileRef tileRef, unsigned int linksFreeList);
 	
 	/// Removes the specified tile from the navigation mesh.
 	///  @param[in]		ref			The reference of the tile to remove.
@@ -424,6 +538,10 @@ public:
 	/// The maximum number of tiles supported by the navigation mesh.
 	/// @return The maximum number of tiles supported by the navigation mesh.
 	int getMaxTiles() const;
+
+	/// Whether tiles are found through a grid over known tile bounds instead
+	/// of the location hash.
+	bool hasTileGrid() const { return m_tileGridWidth > 0; }
 	
 	/// Gets the tile at the specified index.
 	///  @param[in]	i		The tile index. [Limit: 0 >= index < #getMaxTiles()]
@@ -616,6 +734,20 @@ private:
 	/// Returns pointer to tile in the tile array.
 	dtMeshTile* getTile(int i);
 
+	/// Takes a free tile slot for the header's location.
+	dtStatus allocTile(const dtMeshHeader* header, dtTileRef lastRef, dtMeshTile** result);
+	/// Returns the head of the position lookup list that holds location
+	/// (@p x, @p y), or null if it is outside the tile grid.
+	dtMeshTile** getTileLookup(int x, int y) const;
+	/// Adds the tile to the position lookup.
+	void insertTileLookup(dtMeshTile* tile);
+	/// Builds the link free list and the links inside the tile.
+	void connectTileLinks(dtMeshTile* tile);
+	/// Builds the links between the tile and the tiles around it.
+	void connectTileNeighbours(dtMeshTile* tile);
+	/// Builds the wide bounding volume tree of the tile.
+	void buildTileWideBVTree(dtMeshTile* tile);
+
 	/// Returns neighbour tile based on side.
 	int getTilesAt(const int x, const int y,
 				   dtMeshTile** tiles, const int maxTiles) const;
@@ -660,10 +792,13 @@ private:
 	float m_orig[3];					///< Origin of the tile (0,0)
 	float m_tileWidth, m_tileHeight;	///< Dimensions of each tile.
 	int m_maxTiles;						///< Max number of tiles.
-	int m_tileLutSize;					///< Tile hash lookup size (must be pot).
+	int m_tileLutSize;					///< Tile hash lookup size (must be pot), or the number of tile grid cells.
 	int m_tileLutMask;					///< Tile hash lookup mask.
+	int m_tileGridMin[2];				///< Smallest tile location of the tile grid.
+	int m_tileGridWidth;				///< Tile grid width, 0 when the hash is used.
+	int m_tileGridHeight;				///< Tile grid height.
 
-	dtMeshTile** m_posLookup;			///< Tile hash lookup.
+	dtMeshTile** m_posLookup;			///< Tile hash lookup, or the tile grid row by row.
 	dtMeshTile* m_nextFree;				///< Freelist of tiles.
 	dtMeshTile* m_tiles;				///< List of tiles.
 		
@@ -19,9 +19,13 @@
 #ifndef DETOURNAVMESHQUERY_H
 #define DETOURNAVMESHQUERY_H
 
+#include "DetourCommon.h"
 #include "DetourNavMesh.h"
+#include "DetourPolyOverlay.h"
 #include "DetourStatus.h"
 
+class dtTileGraph;
+class dtPolyAdjacency;
 
 // Define DT_VIRTUAL_QUERYFILTER if you wish to derive a custom filter from dtQueryFilter.
 // On certain platforms indirect or virtual function call is expensive. The default
@@ -37,6 +41,7 @@ class dtQueryFilter
 	float m_areaCost[DT_MAX_AREAS];		///< Cost per area type. (Used by default implementation.)
 	unsigned short m_includeFlags;		///< Flags for polygons that can be visited. (Used by default implementation.)
 	unsigned short m_excludeFlags;		///< Flags for polygons that should not be visted. (Used by default implementation.)
+	const dtPolyOverlay* m_overlay;		///< Flag and area overrides checked before the mesh values. [opt] (Used by default implementation.)
 	
 public:
 	dtQueryFilter();
@@ -115,10 +120,120 @@ public:
 	/// @param[in]		flags		The new flags.
 	inline void setExcludeFlags(const unsigned short flags) { m_excludeFlags = flags; }	
 
+	/// Returns the overlay whose flag and area overrides take precedence over
+	/// the values stored in the mesh, or null if there is none.
+	inline const dtPolyOverlay* getPolyOverlay() const { return m_overlay; }
+
+	/// Sets the overlay consulted before the mesh flags and areas. The overlay
+	/// must outlive every query that uses the filter.
+	///  @param[in]		overlay		The overlay, or null to use the mesh values only.
+	inline void setPolyOverlay(const dtPolyOverlay* overlay) { m_overlay = overlay; }
+
 	///@}
 
 };
 
+#ifndef DT_VIRTUAL_QUERYFILTER
+inline bool dtQueryFilter::passFilter(const dtPolyRef ref,
+									  const dtMeshTile* /*tile*/,
+									  const dtPoly* poly) const
+{
+	const unsigned short flags = m_overlay ? m_overlay->getFlags(ref, poly) : poly->flags;
+	return (flags & m_includeFlags) != 0 && (flags & m_excludeFlags) == 0;
+}
+
+inline float dtQueryFilter::getCost(const float* pa, const float* pb,
+									const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+									const dtPolyRef curRef, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
+									const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+{
+	const unsigned char area = m_overlay ? m_overlay->getArea(curRef, curPoly) : curPoly->getArea();
+	return dtVdist(pa, pb) * m_areaCost[area];
+}
+#endif
+
+/// A filter that tests the include and exclude flags like dtQueryFilter but
+/// has no area costs: the cost of a segment is its length. Finds the same
+/// paths as a dtQueryFilter whose area costs are all 1.0, without the area
+/// lookup and multiply per expanded edge.
+///
+/// Not derived from dtQueryFilter. Use it with the templated query functions,
+/// which inline its passFilter() and getCost().
+/// @ingroup detour
+class dtFlagsQueryFilter
+{
+	unsigned short m_includeFlags;		///< Flags for polygons that can be visited.
+	unsigned short m_excludeFlags;		///< Flags for polygons that should not be visited.
+	const dtPolyOverlay* m_overlay;		///< Flag overrides checked before the mesh values. [opt]
+
+public:
+	dtFlagsQueryFilter(const unsigned short includeFlags = 0xffff, const unsigned short excludeFlags = 0) :
+		m_includeFlags(includeFlags), m_excludeFlags(excludeFlags), m_overlay(0) {}
+
+	/// Returns true if the polygon can be visited. (See dtQueryFilter::passFilter.)
+	inline bool passFilter(const dtPolyRef ref, const dtMeshTile* /*tile*/, const dtPoly* poly) const
+	{
+		const unsigned short flags = m_overlay ? m_overlay->getFlags(ref, poly) : poly->flags;
+		return (flags & m_includeFlags) != 0 && (flags & m_excludeFlags) == 0;
+	}
+
+	/// Returns the length of the segment. (See dtQueryFilter::getCost.)
+	inline float getCost(const float* pa, const float* pb,
+						 const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+						 const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* /*curPoly*/,
+						 const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+	{
+		return dtVdist(pa, pb);
+	}
+
+	inline unsigned short getIncludeFlags() const { return m_includeFlags; }
+	inline void setIncludeFlags(const unsigned short flags) { m_includeFlags = flags; }
+	inline unsigned short getExcludeFlags() const { return m_excludeFlags; }
+	inline void setExcludeFlags(const unsigned short flags) { m_excludeFlags = flags; }
+	inline const dtPolyOverlay* getPolyOverlay() const { return m_overlay; }
+	inline void setPolyOverlay(const dtPolyOverlay* overlay) { m_overlay = overlay; }
+};
+
+/// A filter that visits every polygon with at least one flag set and uses
+/// the segment length as cost. Equivalent to a default constructed
+/// dtQueryFilter without an overlay, for use with the templated query
+/// functions.
+/// @ingroup detour
+class dtDistanceQueryFilter
+{
+public:
+	/// Returns true if the polygon has any flag set.
+	inline bool passFilter(const dtPolyRef /*ref*/, const dtMeshTile* /*tile*/, const dtPoly* poly) const
+	{
+		return poly->flags != 0;
+	}
+
+	/// Returns the length of the segment.
+	inline float getCost(const float* pa, const float* pb,
+						 const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+						 const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* /*curPoly*/,
+						 const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+	{
+		return dtVdist(pa, pb);
+	}
+};
+
+/// The search heuristic #dtNavMeshQuery::findPath uses by default: the
+/// straight-line distance to the end position.
+/// @ingroup detour
+struct dtDistanceHeuristic
+{
+	const float* endPos;
+
+	explicit dtDistanceHeuristic(const float* pos) : endPos(pos) {}
+
+	/// Returns the estimated cost from @p pos in polygon @p ref to the end.
+	inline float operator()(const dtPolyRef /*ref*/, const float* pos) const
+	{
+		return dtVdist(pos, endPos);
+	}
+};
+
 /// Provides information about raycast hit
 /// filled by dtNavMeshQuery::raycast
 /// @ingroup detour
@@ -159,6 +274,15 @@ public:
 	virtual void process(const dtMeshTile* tile, dtPoly** polys, dtPolyRef* refs, int count) = 0;
 };
 
+/// Open lists #dtNavMeshQuery::findPath can use.
+/// @see dtNavMeshQuery::setOpenListType
+/// @ingroup detour
+enum dtOpenListType
+{
+	DT_OPEN_LIST_BINARY_HEAP = 0,		///< Binary heap of nodes, dtNodeQueue.
+	DT_OPEN_LIST_QUATERNARY_HEAP = 1	///< 4-ary heap of totals and nodes, dtQuaternaryNodeQueue.
+};
+
 /// Provides the ability to perform pathfinding related queries against
 /// a navigation mesh.
 /// @ingroup detour
@@ -170,9 +294,43 @@ public:
 	
 	/// Initializes the query object.
 	///  @param[in]		nav			Pointer to the dtNavMesh object to use for all queries.
-	///  @param[in]		maxNodes	Maximum number of search nodes. [Limits: 0 < value <= 65535]
+	///  @param[in]		maxNodes	Maximum number of search nodes. [Limits: 0 < value < 2^#DT_NODE_PARENT_BITS]
 	/// @returns The status flags for the query.
+	///
+	/// Node pools of more than #DT_NODE_PAGE_SIZE nodes allocate their nodes
+	/// page by page as searches need them, the open list is allocated whole.
 	dtStatus init(const dtNavMesh* nav, const int maxNodes);
+
+	/// Allocates the node pool and open list of the backward search of
+	/// #findPathBidirectional. Call after #init; queries that never search
+	/// both ways do not need them.
+	///  @param[in]		maxNodes	Maximum number of search nodes of the backward search. [Limits: 0 < value < 2^#DT_NODE_PARENT_BITS]
+	/// @returns The status flags for the query.
+	dtStatus initBidirectional(const int maxNodes);
+
+	/// Selects the open list of #findPath. The 4-ary heap does fewer, more
+	/// cache friendly sift steps and updates a node in the open list by
+	/// adding it again instead of searching the heap for it. Its corridors
+	/// can differ from those of the binary heap where nodes tie. Call after
+	/// #init. Other searches always use the binary heap.
+	///  @param[in]		type	The open list.
+	/// @returns The status flags for the query.
+	dtStatus setOpenListType(const dtOpenListType type);
+
+	/// The open list of #findPath.
+	dtOpenListType getOpenListType() const { return m_openListType; }
+
+	/// Makes #findPath read the neighbours of the polygons it expands from
+	/// @p adjacency instead of the link lists of the mesh. Polygons of tiles
+	/// the adjacency has not been built for use the links. The paths are
+	/// the same either way.
+	///  @param[in]		adjacency	The adjacency of the query's mesh, or null to use the links only.
+	///  							Must stay alive while it is set. #init clears it.
+	/// @returns The status flags for the query.
+	dtStatus setPolyAdjacency(const dtPolyAdjacency* adjacency);
+
+	/// The adjacency #findPath reads neighbours from, or null.
+	const dtPolyAdjacency* getPolyAdjacency() const { return m_adjacency; }
 	
 	/// @name Standard Pathfinding Functions
 	/// @{
@@ -192,6 +350,108 @@ public:
 					  const dtQueryFilter* filter,
 					  dtPolyRef* path, int* pathCount, const int maxPath) const;
 
+	/// Finds a path from the start polygon to the end polygon with a filter
+	/// whose type is known at compile time, so its passFilter() and getCost()
+	/// are inlined into the search. See the dtQueryFilter overload.
+	///  @tparam		TFilter		A type with the passFilter() and getCost() members of
+	///  							dtQueryFilter, such as #dtFlagsQueryFilter.
+	template <class TFilter>
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const TFilter* filter,
+					  dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// Finds a path from the start polygon to the end polygon, estimating the
+	/// cost left from each polygon with @p heuristic instead of the distance
+	/// to @p endPos. A heuristic that never overestimates the cost, such as
+	/// #dtLandmarkHeuristic, expands fewer nodes than the distance; the
+	/// corridor found can differ, as nodes keep the position they were
+	/// first reached at.
+	///  @tparam		THeuristic	A type with a <tt>float operator()(dtPolyRef ref, const float* pos) const</tt>
+	///  							returning the estimated cost from @p pos in @p ref to the end,
+	///  							such as #dtDistanceHeuristic.
+	/// If the end can not be reached the partial path leads to the polygon
+	/// with the lowest estimate.
+	template <class TFilter, class THeuristic>
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const TFilter* filter, const THeuristic& heuristic,
+					  dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// Finds a path from the start polygon to the end polygon, searching
+	/// forward from the start and backward from the end at once, each in its
+	/// own node pool, until a path joined where they meet is as cheap as
+	/// either search can still find. The result is ordered and limited like
+	/// the one of #findPath. Needs #initBidirectional.
+	///  @param[in]		startRef	The refrence id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.) 
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query. If the searches do not meet
+	/// the path leads to the polygon nearest to the end the forward search
+	/// reached, as with #findPath. The backward search passes getCost() its
+	/// segments in the direction of travel, as #findPath does.
+	dtStatus findPathBidirectional(dtPolyRef startRef, dtPolyRef endRef,
+								   const float* startPos, const float* endPos,
+								   const dtQueryFilter* filter,
+								   dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// #findPathBidirectional with a filter whose type is known at compile
+	/// time.
+	template <class TFilter>
+	dtStatus findPathBidirectional(dtPolyRef startRef, dtPolyRef endRef,
+								   const float* startPos, const float* endPos,
+								   const TFilter* filter,
+								   dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// #findPathBidirectional with the heuristics of both searches given:
+	/// @p toEnd estimates the cost from a polygon to the end and @p toStart
+	/// from a polygon to the start. See the THeuristic overload of #findPath.
+	template <class TFilter, class THeuristic>
+	dtStatus findPathBidirectional(dtPolyRef startRef, dtPolyRef endRef,
+								   const float* startPos, const float* endPos,
+								   const TFilter* filter, const THeuristic& toEnd, const THeuristic& toStart,
+								   dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// Finds a path from the start polygon to the end polygon, searching
+	/// polygon by polygon only in the start and end tiles and crossing the
+	/// tiles in between along the edges of @p graph. Each edge taken is then
+	/// searched again with @p filter inside its tile to build the corridor.
+	/// Much cheaper than #findPath when the ends are many tiles apart; the
+	/// corridor can be slightly longer than the one #findPath returns.
+	///  @param[in]		graph		The tile graph of the query's mesh.
+	///  @param[in]		startRef	The refrence id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.) 
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query. If the end can not be reached
+	/// through the graph the corridor leads to the node nearest to it, as with
+	/// #findPath. Exits are picked with the graph's filter, so with a stricter
+	/// @p filter #findPath may still reach the end. Fails if an edge taken is
+	/// blocked for @p filter; use #findPath then.
+	dtStatus findPathHierarchical(const dtTileGraph* graph, dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const dtQueryFilter* filter,
+								  dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// #findPathHierarchical with a filter whose type is known at compile
+	/// time. Defined in DetourTileGraph.h.
+	template <class TFilter>
+	dtStatus findPathHierarchical(const dtTileGraph* graph, dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const TFilter* filter,
+								  dtPolyRef* path, int* pathCount, const int maxPath) const;
+
 	/// Finds the straight path from the start to the end position within the polygon corridor.
 	///  @param[in]		startPos			Path start position. [(x, y, z)]
 	///  @param[in]		endPos				Path end position. [(x, y, z)]
@@ -338,6 +598,14 @@ public:
 	dtStatus findNearestPoly(const float* center, const float* halfExtents,
 							 const dtQueryFilter* filter,
 							 dtPolyRef* nearestRef, float* nearestPt, bool* isOverPoly) const;
+
+	/// Finds the polygon nearest to the specified center point, with the
+	/// filter type bound at compile time. See the dtQueryFilter overload.
+	///  @tparam		TFilter		A type with the passFilter() member of dtQueryFilter.
+	template <class TFilter>
+	dtStatus findNearestPoly(const float* center, const float* halfExtents,
+							 const TFilter* filter,
+							 dtPolyRef* nearestRef, float* nearestPt, bool* isOverPoly = 0) const;
 	
 	/// Finds polygons that overlap the search box.
 	///  @param[in]		center		The center of the search box. [(x, y, z)]
@@ -359,6 +627,14 @@ public:
 	dtStatus queryPolygons(const float* center, const float* halfExtents,
 						   const dtQueryFilter* filter, dtPolyQuery* query) const;
 
+	/// Finds polygons that overlap the search box, with the filter and query
+	/// types bound at compile time so neither is called through a pointer.
+	///  @tparam		TFilter		A type with the passFilter() member of dtQueryFilter.
+	///  @tparam		TQuery		A type with the process() member of dtPolyQuery.
+	template <class TFilter, class TQuery>
+	dtStatus queryPolygons(const float* center, const float* halfExtents,
+						   const TFilter* filter, TQuery* query) const;
+
 	/// Finds the non-overlapping navigation polygons in the local neighbourhood around the center position.
 	///  @param[in]		startRef		The reference id of the polygon where the search starts.
 	///  @param[in]		centerPos		The center of the query circle. [(x, y, z)]
@@ -422,6 +698,15 @@ public:
 					 const dtQueryFilter* filter, const unsigned int options,
 					 dtRaycastHit* hit, dtPolyRef prevRef = 0) const;
 
+	/// Casts a 'walkability' ray with the filter type bound at compile time.
+	/// See the dtQueryFilter overload.
+	///  @tparam		TFilter		A type with the passFilter() and getCost() members of
+	///  							dtQueryFilter.
+	template <class TFilter>
+	dtStatus raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+					 const TFilter* filter, const unsigned int options,
+					 dtRaycastHit* hit, dtPolyRef prevRef = 0) const;
+
 
 	/// Finds the distance from the specified position to the nearest polygon wall.
 	///  @param[in]		startRef		The reference id of the polygon containing @p centerPos.
@@ -515,6 +800,10 @@ public:
 	/// Gets the node pool.
 	/// @returns The node pool.
 	class dtNodePool* getNodePool() const { return m_nodePool; }
+
+	/// Gets the node pool of the backward search of #findPathBidirectional.
+	/// @returns The node pool, or null before #initBidirectional.
+	class dtNodePool* getReverseNodePool() const { return m_reverseNodePool; }
 	
 	/// Gets the navigation mesh the query object is using.
 	/// @return The navigation mesh the query object is using.
@@ -528,8 +817,9 @@ private:
 	dtNavMeshQuery& operator=(const dtNavMeshQuery&);
 	
 	/// Queries polygons within a tile.
+	template <class TFilter, class TQuery>
 	void queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
-							 const dtQueryFilter* filter, dtPolyQuery* query) const;
+							 const TFilter* filter, TQuery* query) const;
 
 	/// Returns portal points between two polygons.
 	dtStatus getPortalPoints(dtPolyRef from, dtPolyRef to, float* left, float* right,
@@ -554,6 +844,14 @@ private:
 						   float* straightPath, unsigned char* straightPathFlags, dtPolyRef* straightPathRefs,
 						   int* straightPathCount, const int maxStraightPath, const int options) const;
 
+	/// Body of #findPath over either open list.
+	template <class TFilter, class THeuristic, class TOpenList>
+	dtStatus findPathOnOpenList(dtPolyRef startRef, dtPolyRef endRef,
+								const float* startPos, const float* endPos,
+								const TFilter* filter, const THeuristic& heuristic,
+								dtPolyRef* path, int* pathCount, const int maxPath,
+								TOpenList* openList) const;
+
 	// Gets the path leading to the specified end node.
 	dtStatus getPathToNode(struct dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const;
 	
@@ -575,6 +873,11 @@ private:
 	class dtNodePool* m_tinyNodePool;	///< Pointer to small node pool.
 	class dtNodePool* m_nodePool;		///< Pointer to node pool.
 	class dtNodeQueue* m_openList;		///< Pointer to open list queue.
+	class dtNodePool* m_reverseNodePool;	///< Node pool of the backward search of findPathBidirectional.
+	class dtNodeQueue* m_reverseOpenList;	///< Open list of the backward search of findPathBidirectional.
+	class dtQuaternaryNodeQueue* m_quaternaryOpenList;	///< Open list of findPath with DT_OPEN_LIST_QUATERNARY_HEAP.
+	dtOpenListType m_openListType;
+	const dtPolyAdjacency* m_adjacency;	///< Neighbours of the polygons findPath expands, null to follow the links.
 };
 
 /// Allocates a query object using the Detour allocator.
@@ -587,4 +890,6 @@ dtNavMeshQuery* dtAllocNavMeshQuery();
 /// @ingroup detour
 void dtFreeNavMeshQuery(dtNavMeshQuery* query);
 
+#include "DetourNavMeshQueryTemplates.h"
+
 #endif // DETOURNAVMESHQUERY_H
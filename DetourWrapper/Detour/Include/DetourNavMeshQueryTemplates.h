@@ -0,0 +1,1090 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Definitions of the dtNavMeshQuery member templates. Included at the end of
+// DetourNavMeshQuery.h, do not include directly.
+
+#ifndef DETOURNAVMESHQUERYTEMPLATES_H
+#define DETOURNAVMESHQUERYTEMPLATES_H
+
+#include <float.h>
+#include "DetourAssert.h"
+#include "DetourNode.h"
+#include "DetourPolyAdjacency.h"
+
+static const float DT_H_SCALE = 0.999f; ///< Search heuristic scale.
+
+/// Keeps the polygon nearest to a point. Not derived from dtPolyQuery so
+/// that queryPolygons() can call process() without virtual dispatch.
+class dtFindNearestPolyQuery
+{
+	const dtNavMeshQuery* m_query;
+	const float* m_center;
+	float m_nearestDistanceSqr;
+	dtPolyRef m_nearestRef;
+	float m_nearestPoint[3];
+	bool m_overPoly;
+
+public:
+	dtFindNearestPolyQuery(const dtNavMeshQuery* query, const float* center)
+		: m_query(query), m_center(center), m_nearestDistanceSqr(FLT_MAX), m_nearestRef(0), m_nearestPoint(), m_overPoly(false)
+	{
+	}
+
+	dtPolyRef nearestRef() const { return m_nearestRef; }
+	const float* nearestPoint() const { return m_nearestPoint; }
+	bool isOverPoly() const { return m_overPoly; }
+
+	void process(const dtMeshTile* tile, dtPoly** polys, dtPolyRef* refs, int count)
+	{
+		dtIgnoreUnused(polys);
+
+		for (int i = 0; i < count; ++i)
+		{
+			dtPolyRef ref = refs[i];
+			float closestPtPoly[3];
+			float diff[3];
+			bool posOverPoly = false;
+			float d;
+			m_query->closestPointOnPoly(ref, m_center, closestPtPoly, &posOverPoly);
+
+			// If a point is directly over a polygon and closer than
+			// climb height, favor that instead of straight line nearest point.
+			dtVsub(diff, m_center, closestPtPoly);
+			if (posOverPoly)
+			{
+				d = dtAbs(diff[1]) - tile->header->walkableClimb;
+				d = d > 0 ? d*d : 0;			
+			}
+			else
+			{
+				d = dtVlenSqr(diff);
+			}
+			
+			if (d < m_nearestDistanceSqr)
+			{
+				dtVcopy(m_nearestPoint, closestPtPoly);
+
+				m_nearestDistanceSqr = d;
+				m_nearestRef = ref;
+				m_overPoly = posOverPoly;
+			}
+		}
+	}
+};
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfExtents,
+										 const TFilter* filter,
+										 dtPolyRef* nearestRef, float* nearestPt, bool* isOverPoly) const
+{
+	dtAssert(m_nav);
+
+	if (!nearestRef)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// queryPolygons below will check rest of params
+	
+	dtFindNearestPolyQuery query(this, center);
+
+	dtStatus status = queryPolygons(center, halfExtents, filter, &query);
+	if (dtStatusFailed(status))
+		return status;
+
+	*nearestRef = query.nearestRef();
+	// Only override nearestPt if we actually found a poly so the nearest point
+	// is valid.
+	if (nearestPt && *nearestRef)
+	{
+		dtVcopy(nearestPt, query.nearestPoint());
+		if (isOverPoly)
+			*isOverPoly = query.isOverPoly();
+	}
+	
+	return DT_SUCCESS;
+}
+
+template <class TFilter, class TQuery>
+void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
+										 const TFilter* filter, TQuery* query) const
+{
+	dtAssert(m_nav);
+	static const int batchSize = 32;
+	dtPolyRef polyRefs[batchSize];
+	dtPoly* polys[batchSize];
+	int n = 0;
+
+	if (tile->bvTree)
+	{
+		const dtBVNode* node = &tile->bvTree[0];
+		const dtBVNode* end = &tile->bvTree[tile->header->bvNodeCount];
+		const float* tbmin = tile->header->bmin;
+		const float* tbmax = tile->header->bmax;
+		const float qfac = tile->header->bvQuantFactor;
+
+		// Calculate quantized box
+		unsigned short bmin[3], bmax[3];
+		// dtClamp query box to world box.
+		float minx = dtClamp(qmin[0], tbmin[0], tbmax[0]) - tbmin[0];
+		float miny = dtClamp(qmin[1], tbmin[1], tbmax[1]) - tbmin[1];
+		float minz = dtClamp(qmin[2], tbmin[2], tbmax[2]) - tbmin[2];
+		float maxx = dtClamp(qmax[0], tbmin[0], tbmax[0]) - tbmin[0];
+		float maxy = dtClamp(qmax[1], tbmin[1], tbmax[1]) - tbmin[1];
+		float maxz = dtClamp(qmax[2], tbmin[2], tbmax[2]) - tbmin[2];
+		// Quantize
+		bmin[0] = (unsigned short)(qfac * minx) & 0xfffe;
+		bmin[1] = (unsigned short)(qfac * miny) & 0xfffe;
+		bmin[2] = (unsigned short)(qfac * minz) & 0xfffe;
+		bmax[0] = (unsigned short)(qfac * maxx + 1) | 1;
+		bmax[1] = (unsigned short)(qfac * maxy + 1) | 1;
+		bmax[2] = (unsigned short)(qfac * maxz + 1) | 1;
+
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		if (tile->bvWideTree)
+		{
+			// Depth first with the children in order, so the polygons come
+			// out in the order of the binary tree walk below. The tree is
+			// built at most DT_BV_WIDE_MAX_DEPTH nodes deep, which bounds the
+			// stack; empty slots never overlap the query box.
+			const short wmin[3] = { (short)((int)bmin[0] - 0x8000), (short)((int)bmin[1] - 0x8000), (short)((int)bmin[2] - 0x8000) };
+			const short wmax[3] = { (short)((int)bmax[0] - 0x8000), (short)((int)bmax[1] - 0x8000), (short)((int)bmax[2] - 0x8000) };
+			const dtBVWideNode* tree = tile->bvWideTree;
+			int stackNode[DT_BV_WIDE_MAX_DEPTH];
+			unsigned int stackMask[DT_BV_WIDE_MAX_DEPTH];
+			int top = 0;
+			stackNode[0] = 0;
+			stackMask[0] = dtOverlapBVWideNode(&tree[0], wmin, wmax);
+			while (top >= 0)
+			{
+				const unsigned int mask = stackMask[top];
+				if (!mask)
+				{
+					top--;
+					continue;
+				}
+				stackMask[top] = mask & (mask - 1);
+				const int child = tree[stackNode[top]].child[dtLowestBit(mask)];
+				dtAssert(child != DT_BV_WIDE_EMPTY);
+
+				if (child >= 0)
+				{
+					dtAssert(top + 1 < DT_BV_WIDE_MAX_DEPTH);
+					if (top + 1 >= DT_BV_WIDE_MAX_DEPTH)
+						continue;
+					top++;
+					stackNode[top] = child;
+					stackMask[top] = dtOverlapBVWideNode(&tree[child], wmin, wmax);
+					continue;
+				}
+
+				const int ip = ~child;
+				dtPolyRef ref = base | (dtPolyRef)ip;
+				if (filter->passFilter(ref, tile, &tile->polys[ip]))
+				{
+					polyRefs[n] = ref;
+					polys[n] = &tile->polys[ip];
+
+					if (n == batchSize - 1)
+					{
+						query->process(tile, polys, polyRefs, batchSize);
+						n = 0;
+					}
+					else
+					{
+						n++;
+					}
+				}
+			}
+		}
+		else
+		{
+			// Traverse tree
+			while (node < end)
+			{
+				const bool overlap = dtOverlapQuantBounds(bmin, bmax, node->bmin, node->bmax);
+				const bool isLeafNode = node->i >= 0;
+
+				if (isLeafNode && overlap)
+				{
+					dtPolyRef ref = base | (dtPolyRef)node->i;
+					if (filter->passFilter(ref, tile, &tile->polys[node->i]))
+					{
+						polyRefs[n] = ref;
+						polys[n] = &tile->polys[node->i];
+
+						if (n == batchSize - 1)
+						{
+							query->process(tile, polys, polyRefs, batchSize);
+							n = 0;
+						}
+						else
+						{
+							n++;
+						}
+					}
+				}
+
+				if (overlap || isLeafNode)
+					node++;
+				else
+				{
+					const int escapeIndex = -node->i;
+					node += escapeIndex;
+				}
+			}
+		}
+	}
+	else
+	{
+		float bmin[3], bmax[3];
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		for (int i = 0; i < tile->header->polyCount; ++i)
+		{
+			dtPoly* p = &tile->polys[i];
+			// Do not return off-mesh connection polygons.
+			if (p->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			// Must pass filter
+			const dtPolyRef ref = base | (dtPolyRef)i;
+			if (!filter->passFilter(ref, tile, p))
+				continue;
+			// Calc polygon bounds.
+			const float* v = &tile->verts[p->verts[0]*3];
+			dtVcopy(bmin, v);
+			dtVcopy(bmax, v);
+			for (int j = 1; j < p->vertCount; ++j)
+			{
+				v = &tile->verts[p->verts[j]*3];
+				dtVmin(bmin, v);
+				dtVmax(bmax, v);
+			}
+			if (dtOverlapBounds(qmin, qmax, bmin, bmax))
+			{
+				polyRefs[n] = ref;
+				polys[n] = p;
+
+				if (n == batchSize - 1)
+				{
+					query->process(tile, polys, polyRefs, batchSize);
+					n = 0;
+				}
+				else
+				{
+					n++;
+				}
+			}
+		}
+	}
+
+	// Process the last polygons that didn't make a full batch.
+	if (n > 0)
+		query->process(tile, polys, polyRefs, n);
+}
+
+template <class TFilter, class TQuery>
+dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExtents,
+									   const TFilter* filter, TQuery* query) const
+{
+	dtAssert(m_nav);
+
+	if (!center || !dtVisfinite(center) ||
+		!halfExtents || !dtVisfinite(halfExtents) ||
+		!filter || !query)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	float bmin[3], bmax[3];
+	dtVsub(bmin, center, halfExtents);
+	dtVadd(bmax, center, halfExtents);
+	
+	// Find tiles the query touches.
+	int minx, miny, maxx, maxy;
+	m_nav->calcTileLoc(bmin, &minx, &miny);
+	m_nav->calcTileLoc(bmax, &maxx, &maxy);
+
+	static const int MAX_NEIS = 32;
+	const dtMeshTile* neis[MAX_NEIS];
+	
+	for (int y = miny; y <= maxy; ++y)
+	{
+		for (int x = minx; x <= maxx; ++x)
+		{
+			const int nneis = m_nav->getTilesAt(x,y,neis,MAX_NEIS);
+			for (int j = 0; j < nneis; ++j)
+			{
+				queryPolygonsInTile(neis[j], bmin, bmax, filter, query);
+			}
+		}
+	}
+	
+	return DT_SUCCESS;
+}
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const TFilter* filter,
+								  dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	return findPath(startRef, endRef, startPos, endPos, filter, dtDistanceHeuristic(endPos), path, pathCount, maxPath);
+}
+
+template <class TFilter, class THeuristic>
+dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const TFilter* filter, const THeuristic& heuristic,
+								  dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	if (m_openListType == DT_OPEN_LIST_QUATERNARY_HEAP)
+		return findPathOnOpenList(startRef, endRef, startPos, endPos, filter, heuristic, path, pathCount, maxPath, m_quaternaryOpenList);
+	return findPathOnOpenList(startRef, endRef, startPos, endPos, filter, heuristic, path, pathCount, maxPath, m_openList);
+}
+
+template <class TFilter, class THeuristic, class TOpenList>
+dtStatus dtNavMeshQuery::findPathOnOpenList(dtPolyRef startRef, dtPolyRef endRef,
+											const float* startPos, const float* endPos,
+											const TFilter* filter, const THeuristic& heuristic,
+											dtPolyRef* path, int* pathCount, const int maxPath,
+											TOpenList* openList) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(openList);
+
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+	
+	// Validate input
+	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
+		!startPos || !dtVisfinite(startPos) ||
+		!endPos || !dtVisfinite(endPos) ||
+		!filter || !path || maxPath <= 0)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	if (startRef == endRef)
+	{
+		path[0] = startRef;
+		*pathCount = 1;
+		return DT_SUCCESS;
+	}
+	
+	m_nodePool->clear();
+	openList->clear();
+	
+	dtNode* startNode = m_nodePool->getNode(startRef);
+	dtVcopy(startNode->pos, startPos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = heuristic(startRef, startPos) * DT_H_SCALE;
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_OPEN;
+	openList->push(startNode);
+	
+	dtNode* lastBestNode = startNode;
+	float lastBestNodeCost = startNode->total;
+	
+	bool outOfNodes = false;
+	
+	while (!openList->empty())
+	{
+		// Remove node from open list and put it in closed list.
+		dtNode* bestNode = openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		
+		// Reached the goal, stop searching.
+		if (bestNode->id == endRef)
+		{
+			lastBestNode = bestNode;
+			break;
+		}
+		
+		// Get current poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+		
+		// Get parent poly and tile.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef)
+			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+		
+		// With an adjacency the neighbours, their tiles and the portal
+		// middles are read in order from one array.
+		int adjacentCount = 0;
+		const float* adjacentPos = 0;
+		const dtPolyAdjacency::Link* adjacent = m_adjacency ? m_adjacency->getLinks(bestRef, &adjacentCount, &adjacentPos) : 0;
+		unsigned int linkIdx = adjacent ? DT_NULL_LINK : bestPoly->firstLink;
+		
+		for (int j = 0; j < adjacentCount || linkIdx != DT_NULL_LINK; ++j)
+		{
+			dtPolyRef neighbourRef;
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			unsigned char crossSide = 0;
+			const float* midPoint = 0;
+			
+			if (adjacent)
+			{
+				const dtPolyAdjacency::Link& link = adjacent[j];
+				neighbourRef = link.ref;
+				if (neighbourRef == parentRef)
+					continue;
+				neighbourTile = link.tile;
+				neighbourPoly = &neighbourTile->polys[link.poly];
+				crossSide = link.side;
+				midPoint = &adjacentPos[j * 3];
+			}
+			else
+			{
+				const dtLink& link = bestTile->links[linkIdx];
+				linkIdx = link.next;
+				neighbourRef = link.ref;
+				
+				// Skip invalid ids and do not expand back to where we came from.
+				if (!neighbourRef || neighbourRef == parentRef)
+					continue;
+				
+				// Get neighbour poly and tile.
+				// The API input has been cheked already, skip checking internal data.
+				m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+				
+				// deal explicitly with crossing tile boundaries
+				if (link.side != 0xff)
+					crossSide = link.side >> 1;
+			}
+			
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
+			// get the node
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
+			if (!neighbourNode)
+			{
+				outOfNodes = true;
+				continue;
+			}
+			
+			// If the node is visited the first time, calculate node position.
+			if (neighbourNode->flags == 0)
+			{
+				if (midPoint)
+					dtVcopy(neighbourNode->pos, midPoint);
+				else
+					getEdgeMidPoint(bestRef, bestPoly, bestTile,
+									neighbourRef, neighbourPoly, neighbourTile,
+									neighbourNode->pos);
+			}
+
+			// Calculate cost and heuristic.
+			float cost = 0;
+			float estimate = 0;
+			
+			// Special case for last node.
+			if (neighbourRef == endRef)
+			{
+				// Cost
+				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+													  parentRef, parentTile, parentPoly,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly);
+				const float endCost = filter->getCost(neighbourNode->pos, endPos,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly,
+													  0, 0, 0);
+				
+				cost = bestNode->cost + curCost + endCost;
+				estimate = 0;
+			}
+			else
+			{
+				// Cost
+				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+													  parentRef, parentTile, parentPoly,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly);
+				cost = bestNode->cost + curCost;
+				estimate = heuristic(neighbourRef, neighbourNode->pos)*DT_H_SCALE;
+			}
+
+			const float total = cost + estimate;
+			
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+			// The node is already visited and process, and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
+				continue;
+			
+			// Add or update the node.
+			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->id = neighbourRef;
+			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+			neighbourNode->cost = cost;
+			neighbourNode->total = total;
+			
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				// Already in open, update node location.
+				openList->modify(neighbourNode);
+			}
+			else
+			{
+				// Put the node in open list.
+				neighbourNode->flags |= DT_NODE_OPEN;
+				openList->push(neighbourNode);
+			}
+			
+			// Update nearest node to target so far.
+			if (estimate < lastBestNodeCost)
+			{
+				lastBestNodeCost = estimate;
+				lastBestNode = neighbourNode;
+			}
+		}
+	}
+
+	dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
+
+	if (lastBestNode->id != endRef)
+		status |= DT_PARTIAL_RESULT;
+
+	if (outOfNodes)
+		status |= DT_OUT_OF_NODES;
+	
+	return status;
+}
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::findPathBidirectional(dtPolyRef startRef, dtPolyRef endRef,
+											   const float* startPos, const float* endPos,
+											   const TFilter* filter,
+											   dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	return findPathBidirectional(startRef, endRef, startPos, endPos, filter,
+								 dtDistanceHeuristic(endPos), dtDistanceHeuristic(startPos), path, pathCount, maxPath);
+}
+
+template <class TFilter, class THeuristic>
+dtStatus dtNavMeshQuery::findPathBidirectional(dtPolyRef startRef, dtPolyRef endRef,
+											   const float* startPos, const float* endPos,
+											   const TFilter* filter, const THeuristic& toEnd, const THeuristic& toStart,
+											   dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	dtAssert(m_nav);
+
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+
+	// Validate input
+	if (!m_nodePool || !m_reverseNodePool ||
+		!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
+		!startPos || !dtVisfinite(startPos) ||
+		!endPos || !dtVisfinite(endPos) ||
+		!filter || !path || maxPath <= 0)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	if (startRef == endRef)
+	{
+		path[0] = startRef;
+		*pathCount = 1;
+		return DT_SUCCESS;
+	}
+
+	dtNodePool* pools[2] = { m_nodePool, m_reverseNodePool };
+	dtNodeQueue* openLists[2] = { m_openList, m_reverseOpenList };
+	const THeuristic* heuristics[2] = { &toEnd, &toStart };
+	const dtPolyRef rootRefs[2] = { startRef, endRef };
+	const float* rootPos[2] = { startPos, endPos };
+	dtNode* roots[2];
+
+	for (int side = 0; side < 2; ++side)
+	{
+		pools[side]->clear();
+		openLists[side]->clear();
+
+		dtNode* root = pools[side]->getNode(rootRefs[side]);
+		dtVcopy(root->pos, rootPos[side]);
+		root->pidx = 0;
+		root->cost = 0;
+		root->total = (*heuristics[side])(rootRefs[side], rootPos[side]) * DT_H_SCALE;
+		root->id = rootRefs[side];
+		root->flags = DT_NODE_OPEN;
+		openLists[side]->push(root);
+		roots[side] = root;
+	}
+
+	dtNode* lastBestNode = roots[0];
+	float lastBestNodeCost = lastBestNode->total;
+
+	// Cheapest complete path found so far, joined at a polygon both
+	// searches reached.
+	float bestCost = FLT_MAX;
+	dtNode* meetNodes[2] = { 0, 0 };
+
+	bool outOfNodes = false;
+
+	for (;;)
+	{
+		const bool empty[2] = { openLists[0]->empty(), openLists[1]->empty() };
+		if (empty[0] && empty[1])
+			break;
+
+		// Every path not found yet costs at least the lowest total of either
+		// open list. Once a path is found, an empty list means the other
+		// side can only find longer ones.
+		if (meetNodes[0] &&
+			(empty[0] || empty[1] || openLists[0]->top()->total >= bestCost || openLists[1]->top()->total >= bestCost))
+			break;
+
+		// Expand the side with the smaller frontier.
+		const int side = empty[0] ? 1 : empty[1] ? 0 : (openLists[1]->getSize() < openLists[0]->getSize() ? 1 : 0);
+		dtNodePool* pool = pools[side];
+		dtNodePool* otherPool = pools[side ^ 1];
+
+		dtNode* bestNode = openLists[side]->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+
+		// Do not expand nodes no path cheaper than the best one can go
+		// through (the pruning of NBA*): their own total is too high, or a
+		// path through them reaches the other search's open list, whose
+		// lowest total less the node's estimate towards the other search's
+		// root bounds the rest of the way.
+		if (meetNodes[0])
+		{
+			if (bestNode->total >= bestCost)
+				continue;
+			const float otherEstimate = (*heuristics[side ^ 1])(bestNode->id, bestNode->pos) * DT_H_SCALE;
+			if (bestNode->cost + openLists[side ^ 1]->top()->total - otherEstimate >= bestCost)
+				continue;
+		}
+
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+
+		// The polygon the path came from, or for the backward search the
+		// one it goes on to.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = pool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef)
+			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			const dtPolyRef neighbourRef = bestTile->links[i].ref;
+
+			// Skip invalid ids and do not expand back to where we came from.
+			if (!neighbourRef || neighbourRef == parentRef)
+				continue;
+
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
+			// The backward search walks links against their direction. Off-mesh
+			// connections can be one way, so check that the way back exists.
+			if (side == 1 &&
+				(bestPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION || neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION))
+			{
+				bool linked = false;
+				for (unsigned int j = neighbourPoly->firstLink; j != DT_NULL_LINK && !linked; j = neighbourTile->links[j].next)
+					linked = neighbourTile->links[j].ref == bestRef;
+				if (!linked)
+					continue;
+			}
+
+			// deal explicitly with crossing tile boundaries
+			unsigned char crossSide = 0;
+			if (bestTile->links[i].side != 0xff)
+				crossSide = bestTile->links[i].side >> 1;
+
+			dtNode* neighbourNode = pool->getNode(neighbourRef, crossSide);
+			if (!neighbourNode)
+			{
+				outOfNodes = true;
+				continue;
+			}
+
+			// If the node is visited the first time, calculate node position.
+			if (neighbourNode->flags == 0)
+			{
+				if (side == 0)
+					getEdgeMidPoint(bestRef, bestPoly, bestTile,
+									neighbourRef, neighbourPoly, neighbourTile,
+									neighbourNode->pos);
+				else
+					getEdgeMidPoint(neighbourRef, neighbourPoly, neighbourTile,
+									bestRef, bestPoly, bestTile,
+									neighbourNode->pos);
+			}
+
+			// Both searches cost the segment through the best polygon in the
+			// direction the path takes it.
+			const float cost = bestNode->cost + (side == 0 ?
+				filter->getCost(bestNode->pos, neighbourNode->pos,
+								parentRef, parentTile, parentPoly,
+								bestRef, bestTile, bestPoly,
+								neighbourRef, neighbourTile, neighbourPoly) :
+				filter->getCost(neighbourNode->pos, bestNode->pos,
+								neighbourRef, neighbourTile, neighbourPoly,
+								bestRef, bestTile, bestPoly,
+								parentRef, parentTile, parentPoly));
+			const float estimate = (*heuristics[side])(neighbourRef, neighbourNode->pos) * DT_H_SCALE;
+			const float total = cost + estimate;
+
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+			// The node is already visited and process, and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
+				continue;
+
+			// Add or update the node.
+			neighbourNode->pidx = pool->getNodeIdx(bestNode);
+			neighbourNode->id = neighbourRef;
+			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+			neighbourNode->cost = cost;
+			neighbourNode->total = total;
+
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				openLists[side]->modify(neighbourNode);
+			}
+			else
+			{
+				neighbourNode->flags |= DT_NODE_OPEN;
+				openLists[side]->push(neighbourNode);
+			}
+
+			if (side == 0 && estimate < lastBestNodeCost)
+			{
+				lastBestNodeCost = estimate;
+				lastBestNode = neighbourNode;
+			}
+
+			// Join with the other search where it reached the same polygon:
+			// the path crosses the polygon from the forward node's position
+			// to the backward node's.
+			dtNode* others[DT_MAX_STATES_PER_NODE];
+			const int otherCount = (int)otherPool->findNodes(neighbourRef, others, DT_MAX_STATES_PER_NODE);
+			for (int j = 0; j < otherCount; ++j)
+			{
+				dtNode* forwardNode = side == 0 ? neighbourNode : others[j];
+				dtNode* backwardNode = side == 0 ? others[j] : neighbourNode;
+				const dtNode* prev = pools[0]->getNodeAtIdx(forwardNode->pidx);
+				const dtNode* next = pools[1]->getNodeAtIdx(backwardNode->pidx);
+				const dtMeshTile* prevTile = 0;
+				const dtPoly* prevPoly = 0;
+				const dtMeshTile* nextTile = 0;
+				const dtPoly* nextPoly = 0;
+				if (prev)
+					m_nav->getTileAndPolyByRefUnsafe(prev->id, &prevTile, &prevPoly);
+				if (next)
+					m_nav->getTileAndPolyByRefUnsafe(next->id, &nextTile, &nextPoly);
+
+				const float joined = forwardNode->cost + backwardNode->cost +
+					filter->getCost(forwardNode->pos, backwardNode->pos,
+									prev ? prev->id : 0, prevTile, prevPoly,
+									neighbourRef, neighbourTile, neighbourPoly,
+									next ? next->id : 0, nextTile, nextPoly);
+				if (joined < bestCost)
+				{
+					bestCost = joined;
+					meetNodes[0] = forwardNode;
+					meetNodes[1] = backwardNode;
+				}
+			}
+		}
+	}
+
+	dtStatus status;
+	if (meetNodes[0])
+	{
+		status = getPathToNode(meetNodes[0], path, pathCount, maxPath);
+		for (const dtNode* node = pools[1]->getNodeAtIdx(meetNodes[1]->pidx); node; node = pools[1]->getNodeAtIdx(node->pidx))
+		{
+			if (*pathCount >= maxPath)
+			{
+				status |= DT_BUFFER_TOO_SMALL;
+				break;
+			}
+			path[(*pathCount)++] = node->id;
+		}
+	}
+	else
+	{
+		status = getPathToNode(lastBestNode, path, pathCount, maxPath) | DT_PARTIAL_RESULT;
+	}
+
+	if (outOfNodes)
+		status |= DT_OUT_OF_NODES;
+
+	return status;
+}
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+								 const TFilter* filter, const unsigned int options,
+								 dtRaycastHit* hit, dtPolyRef prevRef) const
+{
+	dtAssert(m_nav);
+
+	if (!hit)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	hit->t = 0;
+	hit->pathCount = 0;
+	hit->pathCost = 0;
+
+	// Validate input
+	if (!m_nav->isValidPolyRef(startRef) ||
+		!startPos || !dtVisfinite(startPos) ||
+		!endPos || !dtVisfinite(endPos) ||
+		!filter ||
+		(prevRef && !m_nav->isValidPolyRef(prevRef)))
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	
+	float dir[3], curPos[3], lastPos[3];
+	float verts[DT_VERTS_PER_POLYGON*3+3];	
+	int n = 0;
+
+	dtVcopy(curPos, startPos);
+	dtVsub(dir, endPos, startPos);
+	dtVset(hit->hitNormal, 0, 0, 0);
+
+	dtStatus status = DT_SUCCESS;
+
+	const dtMeshTile* prevTile, *tile, *nextTile;
+	const dtPoly* prevPoly, *poly, *nextPoly;
+	dtPolyRef curRef;
+
+	// The API input has been checked already, skip checking internal data.
+	curRef = startRef;
+	tile = 0;
+	poly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(curRef, &tile, &poly);
+	nextTile = prevTile = tile;
+	nextPoly = prevPoly = poly;
+	if (prevRef)
+		m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly);
+
+	while (curRef)
+	{
+		// Cast ray against current polygon.
+		
+		// Collect vertices.
+		int nv = 0;
+		for (int i = 0; i < (int)poly->vertCount; ++i)
+		{
+			dtVcopy(&verts[nv*3], &tile->verts[poly->verts[i]*3]);
+			nv++;
+		}
+		
+		float tmin, tmax;
+		int segMin, segMax;
+		if (!dtIntersectSegmentPoly2D(startPos, endPos, verts, nv, tmin, tmax, segMin, segMax))
+		{
+			// Could not hit the polygon, keep the old t and report hit.
+			hit->pathCount = n;
+			return status;
+		}
+
+		hit->hitEdgeIndex = segMax;
+
+		// Keep track of furthest t so far.
+		if (tmax > hit->t)
+			hit->t = tmax;
+		
+		// Store visited polygons.
+		if (n < hit->maxPath)
+			hit->path[n++] = curRef;
+		else
+			status |= DT_BUFFER_TOO_SMALL;
+
+		// Ray end is completely inside the polygon.
+		if (segMax == -1)
+		{
+			hit->t = FLT_MAX;
+			hit->pathCount = n;
+			
+			// add the cost
+			if (options & DT_RAYCAST_USE_COSTS)
+				hit->pathCost += filter->getCost(curPos, endPos, prevRef, prevTile, prevPoly, curRef, tile, poly, curRef, tile, poly);
+			return status;
+		}
+
+		// Follow neighbours.
+		dtPolyRef nextRef = 0;
+		
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtLink* link = &tile->links[i];
+			
+			// Find link which contains this edge.
+			if ((int)link->edge != segMax)
+				continue;
+			
+			// Get pointer to the next polygon.
+			nextTile = 0;
+			nextPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
+			
+			// Skip off-mesh connections.
+			if (nextPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			
+			// Skip links based on filter.
+			if (!filter->passFilter(link->ref, nextTile, nextPoly))
+				continue;
+			
+			// If the link is internal, just return the ref.
+			if (link->side == 0xff)
+			{
+				nextRef = link->ref;
+				break;
+			}
+			
+			// If the link is at tile boundary,
+			
+			// Check if the link spans the whole edge, and accept.
+			if (link->bmin == 0 && link->bmax == 255)
+			{
+				nextRef = link->ref;
+				break;
+			}
+			
+			// Check for partial edge links.
+			const int v0 = poly->verts[link->edge];
+			const int v1 = poly->verts[(link->edge+1) % poly->vertCount];
+			const float* left = &tile->verts[v0*3];
+			const float* right = &tile->verts[v1*3];
+			
+			// Check that the intersection lies inside the link portal.
+			if (link->side == 0 || link->side == 4)
+			{
+				// Calculate link size.
+				const float s = 1.0f/255.0f;
+				float lmin = left[2] + (right[2] - left[2])*(link->bmin*s);
+				float lmax = left[2] + (right[2] - left[2])*(link->bmax*s);
+				if (lmin > lmax) dtSwap(lmin, lmax);
+				
+				// Find Z intersection.
+				float z = startPos[2] + (endPos[2]-startPos[2])*tmax;
+				if (z >= lmin && z <= lmax)
+				{
+					nextRef = link->ref;
+					break;
+				}
+			}
+			else if (link->side == 2 || link->side == 6)
+			{
+				// Calculate link size.
+				const float s = 1.0f/255.0f;
+				float lmin = left[0] + (right[0] - left[0])*(link->bmin*s);
+				float lmax = left[0] + (right[0] - left[0])*(link->bmax*s);
+				if (lmin > lmax) dtSwap(lmin, lmax);
+				
+				// Find X intersection.
+				float x = startPos[0] + (endPos[0]-startPos[0])*tmax;
+				if (x >= lmin && x <= lmax)
+				{
+					nextRef = link->ref;
+					break;
+				}
+			}
+		}
+		
+		// add the cost
+		if (options & DT_RAYCAST_USE_COSTS)
+		{
+			// compute the intersection point at the furthest end of the polygon
+			// and correct the height (since the raycast moves in 2d)
+			dtVcopy(lastPos, curPos);
+			dtVmad(curPos, startPos, dir, hit->t);
+			float* e1 = &verts[segMax*3];
+			float* e2 = &verts[((segMax+1)%nv)*3];
+			float eDir[3], diff[3];
+			dtVsub(eDir, e2, e1);
+			dtVsub(diff, curPos, e1);
+			float s = dtSqr(eDir[0]) > dtSqr(eDir[2]) ? diff[0] / eDir[0] : diff[2] / eDir[2];
+			curPos[1] = e1[1] + eDir[1] * s;
+
+			hit->pathCost += filter->getCost(lastPos, curPos, prevRef, prevTile, prevPoly, curRef, tile, poly, nextRef, nextTile, nextPoly);
+		}
+
+		if (!nextRef)
+		{
+			// No neighbour, we hit a wall.
+			
+			// Calculate hit normal.
+			const int a = segMax;
+			const int b = segMax+1 < nv ? segMax+1 : 0;
+			const float* va = &verts[a*3];
+			const float* vb = &verts[b*3];
+			const float dx = vb[0] - va[0];
+			const float dz = vb[2] - va[2];
+			hit->hitNormal[0] = dz;
+			hit->hitNormal[1] = 0;
+			hit->hitNormal[2] = -dx;
+			dtVnormalize(hit->hitNormal);
+			
+			hit->pathCount = n;
+			return status;
+		}
+
+		// No hit, advance to neighbour polygon.
+		prevRef = curRef;
+		curRef = nextRef;
+		prevTile = tile;
+		tile = nextTile;
+		prevPoly = poly;
+		poly = nextPoly;
+	}
+	
+	hit->pathCount = n;
+	
+	return status;
+}
+
+#endif // DETOURNAVMESHQUERYTEMPLATES_H
@@ -28,7 +28,7 @@ enum dtNodeFlags
 	DT_NODE_PARENT_DETACHED = 0x04 // parent of the node is not adjacent. Found using raycast.
 };
 
-typedef unsigned short dtNodeIndex;
+typedef unsigned int dtNodeIndex;
 static const dtNodeIndex DT_NULL_IDX = (dtNodeIndex)~0;
 
 static const int DT_NODE_PARENT_BITS = 24;
@@ -46,9 +46,30 @@ struct dtNode
 
 static const int DT_MAX_STATES_PER_NODE = 1 << DT_NODE_STATE_BITS;	// number of extra states per node. See dtNode::state
 
+/// Slot of the dtNodePool hash table: the search generation that filled it
+/// in the high bits and the node index in the low ones.
+typedef unsigned int dtNodeSlot;
+
+static const int DT_NODE_PAGE_BITS = 16;
+/// Nodes per page of a large dtNodePool. Pools of up to this many nodes
+/// keep them in a single block.
+static const int DT_NODE_PAGE_SIZE = 1 << DT_NODE_PAGE_BITS;
+
+/// Pool of search nodes found through an open-addressed hash table with
+/// linear probing. Slots are stamped with the generation of the search that
+/// filled them, so clear() only starts a new generation instead of wiping the
+/// table; the table is only reset when the generation counter wraps.
+///
+/// Pools of more than #DT_NODE_PAGE_SIZE nodes allocate their nodes a page
+/// at a time and double the hash table as searches reach further, so they
+/// only take the memory their largest search needed. Their slots keep 24
+/// bits of node index, which leaves 8 bits of generation.
 class dtNodePool
 {
 public:
+	/// @param[in]	maxNodes	The maximum number of nodes of a search. [Limit: < 2^#DT_NODE_PARENT_BITS]
+	/// @param[in]	hashSize	The initial number of hash table slots. Pools that
+	///							do not page must have more than @p maxNodes. [Limit: power of two]
 	dtNodePool(int maxNodes, int hashSize);
 	~dtNodePool();
 	void clear();
@@ -62,34 +83,40 @@ public:
 	inline unsigned int getNodeIdx(const dtNode* node) const
 	{
 		if (!node) return 0;
-		return (unsigned int)(node - m_nodes) + 1;
+		if (node >= m_nodes && node < m_nodes + m_firstPageNodes)
+			return (unsigned int)(node - m_nodes) + 1;
+		return getPagedNodeIdx(node);
 	}
 
 	inline dtNode* getNodeAtIdx(unsigned int idx)
 	{
 		if (!idx) return 0;
-		return &m_nodes[idx - 1];
+		const unsigned int i = idx - 1;
+		if (i < (unsigned int)DT_NODE_PAGE_SIZE)
+			return &m_nodes[i];
+		return &m_pages[i >> DT_NODE_PAGE_BITS][i & (DT_NODE_PAGE_SIZE - 1)];
 	}
 
 	inline const dtNode* getNodeAtIdx(unsigned int idx) const
 	{
 		if (!idx) return 0;
-		return &m_nodes[idx - 1];
+		const unsigned int i = idx - 1;
+		if (i < (unsigned int)DT_NODE_PAGE_SIZE)
+			return &m_nodes[i];
+		return &m_pages[i >> DT_NODE_PAGE_BITS][i & (DT_NODE_PAGE_SIZE - 1)];
 	}
 	
 	inline int getMemUsed() const
 	{
 		return sizeof(*this) +
-			sizeof(dtNode)*m_maxNodes +
-			sizeof(dtNodeIndex)*m_maxNodes +
-			sizeof(dtNodeIndex)*m_hashSize;
+			sizeof(dtNode)*(m_firstPageNodes + (m_pageCount - 1)*DT_NODE_PAGE_SIZE) +
+			sizeof(dtNode*)*m_maxPages +
+			sizeof(dtNodeSlot)*m_hashSize;
 	}
 	
 	inline int getMaxNodes() const { return m_maxNodes; }
 	
 	inline int getHashSize() const { return m_hashSize; }
-	inline dtNodeIndex getFirst(int bucket) const { return m_first[bucket]; }
-	inline dtNodeIndex getNext(int i) const { return m_next[i]; }
 	inline int getNodeCount() const { return m_nodeCount; }
 	
 private:
@@ -97,12 +124,30 @@ private:
 	dtNodePool(const dtNodePool&);
 	dtNodePool& operator=(const dtNodePool&);
 	
-	dtNode* m_nodes;
-	dtNodeIndex* m_first;
-	dtNodeIndex* m_next;
+	unsigned int getPagedNodeIdx(const dtNode* node) const;
+	dtNode* allocPagedNode();
+	bool growHash();
+
+	inline dtNode* getSlotNode(dtNodeSlot entry) const
+	{
+		const unsigned int i = entry & m_indexMask;
+		if (i < (unsigned int)DT_NODE_PAGE_SIZE)
+			return &m_nodes[i];
+		return &m_pages[i >> DT_NODE_PAGE_BITS][i & (DT_NODE_PAGE_SIZE - 1)];
+	}
+	
+	dtNode* m_nodes;				///< The first page, or all nodes of pools that do not page.
+	dtNode** m_pages;				///< Pages of pools that page, null otherwise.
+	dtNodeSlot* m_slots;
 	const int m_maxNodes;
-	const int m_hashSize;
+	const int m_firstPageNodes;
+	const int m_maxPages;
+	int m_pageCount;
+	int m_hashSize;
 	int m_nodeCount;
+	const int m_indexBits;
+	const dtNodeSlot m_indexMask;
+	unsigned int m_generation;
 };
 
 class dtNodeQueue
@@ -143,6 +188,8 @@ public:
 	
 	inline bool empty() const { return m_size == 0; }
 	
+	inline int getSize() const { return m_size; }
+	
 	inline int getMemUsed() const
 	{
 		return sizeof(*this) +
@@ -164,5 +211,172 @@ private:
 	int m_size;
 };		
 
+/// Entry of a dtQuaternaryNodeQueue.
+struct dtNodeQueueEntry
+{
+	float total;
+	dtNode* node;
+};
+
+/// Open list of dtNavMeshQuery::findPath as a 4-ary min-heap of
+/// (total, node) pairs. The keys are stored next to the node pointers, so
+/// sifting does not read the nodes, and the four children of an entry share
+/// a cache line on 64-bit builds.
+///
+/// Entries are not updated in place: modify() pushes the node again and
+/// entries whose total no longer matches their node, or whose node is no
+/// longer open, are dropped when they reach the top. When the heap fills
+/// up it drops all of them at once. getSize() includes them.
+class dtQuaternaryNodeQueue
+{
+public:
+	/// @param[in]	n	The maximum number of open nodes.
+	dtQuaternaryNodeQueue(int n);
+	~dtQuaternaryNodeQueue();
+	
+	inline void clear() { m_size = 0; }
+	
+	inline dtNode* top()
+	{
+		discardStale();
+		return m_heap[0].node;
+	}
+	
+	inline dtNode* pop()
+	{
+		discardStale();
+		dtNode* result = m_heap[0].node;
+		removeTop();
+		return result;
+	}
+	
+	inline void push(dtNode* node)
+	{
+		if (m_size >= m_maxEntries)
+			compact();
+		m_size++;
+		bubbleUp(m_size-1, node->total, node);
+	}
+	
+	inline void modify(dtNode* node) { push(node); }
+	
+	inline bool empty()
+	{
+		discardStale();
+		return m_size == 0;
+	}
+	
+	inline int getSize() const { return m_size; }
+	
+	inline int getMemUsed() const
+	{
+		return sizeof(*this) +
+		sizeof(dtNodeQueueEntry) * (m_maxEntries + 11);
+	}
+	
+	inline int getCapacity() const { return m_capacity; }
+	
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtQuaternaryNodeQueue(const dtQuaternaryNodeQueue&);
+	dtQuaternaryNodeQueue& operator=(const dtQuaternaryNodeQueue&);
+
+	inline bool isStale(const dtNodeQueueEntry& entry) const
+	{
+		return entry.node->total != entry.total || !(entry.node->flags & DT_NODE_OPEN);
+	}
+	
+	inline void discardStale()
+	{
+		while (m_size > 0 && isStale(m_heap[0]))
+			removeTop();
+	}
+	
+	inline void removeTop()
+	{
+		m_size--;
+		if (m_size > 0)
+			trickleDown(0, m_heap[m_size]);
+	}
+	
+	void bubbleUp(int i, float total, dtNode* node);
+	void trickleDown(int i, dtNodeQueueEntry entry);
+	void compact();
+	
+	dtNodeQueueEntry* m_data;
+	dtNodeQueueEntry* m_heap;		///< The root, placed so that each group of four children starts a cache line.
+	const int m_capacity;
+	const int m_maxEntries;
+	int m_size;
+};
+
+/// Entry of a dtCostQueue.
+struct dtCostQueueEntry
+{
+	float cost;
+	unsigned int index;
+};
+
+/// Binary min-heap of costs and caller defined indices in caller owned
+/// memory, for the whole-tile and whole-mesh Dijkstra searches that do not
+/// fit dtNodePool. Entries are not updated in place: push an index again
+/// when it gets cheaper and skip the stale entry when it is popped.
+class dtCostQueue
+{
+public:
+	dtCostQueue(dtCostQueueEntry* entries, int capacity) : m_heap(entries), m_capacity(capacity), m_size(0) {}
+
+	inline void clear() { m_size = 0; }
+
+	inline bool empty() const { return m_size == 0; }
+
+	/// Adds an entry. Returns false if the queue is full.
+	inline bool push(float cost, unsigned int index)
+	{
+		if (m_size >= m_capacity)
+			return false;
+		int i = m_size++;
+		while (i > 0)
+		{
+			const int parent = (i - 1) / 2;
+			if (m_heap[parent].cost <= cost)
+				break;
+			m_heap[i] = m_heap[parent];
+			i = parent;
+		}
+		m_heap[i].cost = cost;
+		m_heap[i].index = index;
+		return true;
+	}
+
+	/// Removes and returns the cheapest entry. The queue must not be empty.
+	inline dtCostQueueEntry pop()
+	{
+		const dtCostQueueEntry result = m_heap[0];
+		const dtCostQueueEntry last = m_heap[--m_size];
+		int i = 0;
+		for (;;)
+		{
+			int child = i * 2 + 1;
+			if (child >= m_size)
+				break;
+			if (child + 1 < m_size && m_heap[child + 1].cost < m_heap[child].cost)
+				child++;
+			if (last.cost <= m_heap[child].cost)
+				break;
+			m_heap[i] = m_heap[child];
+			i = child;
+		}
+		if (m_size > 0)
+			m_heap[i] = last;
+		return result;
+	}
+
+private:
+	dtCostQueueEntry* m_heap;
+	int m_capacity;
+	int m_size;
+};
+
 
 #endif // DETOURNODE_H
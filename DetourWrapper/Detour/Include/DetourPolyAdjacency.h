@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURPOLYADJACENCY_H
+#define DETOURPOLYADJACENCY_H
+
+#include "DetourAlloc.h"
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+/// The neighbours of every polygon of a mesh in compressed sparse row form,
+/// for the expansion of #dtNavMeshQuery::findPath. The links of a polygon
+/// are copied into one contiguous run with the tile and polygon of
+/// each neighbour, and the middles of their portals into another, so the
+/// search reads them in order instead of following the link list and
+/// looking the portal up for every neighbour it reaches.
+///
+/// The adjacency is kept per tile. Adding or removing a mesh tile rebuilds
+/// that tile and its neighbours, whose links into it changed.
+/// @ingroup detour
+class dtPolyAdjacency
+{
+public:
+	/// A link of a polygon to a neighbour.
+	struct Link
+	{
+		const dtMeshTile* tile;		///< The neighbour's tile. Tiles keep their slot in the mesh, so it stays valid like an index.
+		dtPolyRef ref;				///< The neighbour polygon.
+		unsigned short poly;		///< Index of the neighbour in its tile.
+		unsigned char side;			///< Node state of the neighbour: half the tile side the link crosses, 0 inside the tile.
+	};
+
+	/// The links of one mesh tile.
+	struct Tile
+	{
+		unsigned int salt;			///< Salt of the mesh tile the links were copied from.
+		int x, y;					///< Location of the mesh tile, kept to find its neighbours after removal.
+		int polyCount;
+		int linkCount;
+		int* firstLink;				///< The links of polygon i are [firstLink[i], firstLink[i + 1]). [Size: polyCount + 1]
+		Link* links;				///< [Size: linkCount]
+		float* linkPos;				///< Middle of the portal of each link, as dtNavMeshQuery::getEdgeMidPoint places it. [(x, y, z) * linkCount]
+	};
+
+	dtPolyAdjacency();
+	~dtPolyAdjacency();
+
+	/// Builds the adjacency of every tile in the mesh.
+	///  @param[in]	nav		The mesh. Must outlive the adjacency.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav);
+
+	/// Builds the adjacency of a tile that was added to the mesh, and
+	/// rebuilds its neighbours.
+	///  @param[in]	ref		The reference of the added tile.
+	/// @returns The status flags for the operation.
+	dtStatus addTile(dtTileRef ref);
+
+	/// Drops the adjacency of a tile that was removed from the mesh, and
+	/// rebuilds its neighbours.
+	///  @param[in]	ref		The reference the tile had before it was removed.
+	/// @returns The status flags for the operation.
+	dtStatus removeTile(dtTileRef ref);
+
+	/// Returns the links of polygon @p ref, their number and their portal
+	/// middles, or null if its tile has no adjacency or it was built from a
+	/// tile that has since been replaced. Links without a neighbour are left
+	/// out.
+	inline const Link* getLinks(dtPolyRef ref, int* count, const float** pos) const
+	{
+		unsigned int salt, it, ip;
+		m_nav->decodePolyId(ref, salt, it, ip);
+		if (it >= (unsigned int)m_maxTiles)
+			return 0;
+		const Tile* tile = m_tiles[it];
+		if (!tile || tile->salt != salt || ip >= (unsigned int)tile->polyCount)
+			return 0;
+		const int first = tile->firstLink[ip];
+		*count = tile->firstLink[ip + 1] - first;
+		*pos = &tile->linkPos[first * 3];
+		return &tile->links[first];
+	}
+
+	/// The mesh the adjacency was built for.
+	const dtNavMesh* getNavMesh() const { return m_nav; }
+
+	/// The number of links in all tiles.
+	int getLinkCount() const { return m_linkCount; }
+
+private:
+	dtStatus buildTile(int index);
+	void freeTile(int index);
+	dtStatus rebuildNeighbours(int x, int y);
+
+	const dtNavMesh* m_nav;
+	Tile** m_tiles;					///< Indexed by mesh tile index, null for empty tiles.
+	int m_maxTiles;
+	int m_linkCount;
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPolyAdjacency(const dtPolyAdjacency&);
+	dtPolyAdjacency& operator=(const dtPolyAdjacency&);
+};
+
+/// Allocates a poly adjacency object using the Detour allocator.
+/// @return A poly adjacency object that is ready for initialization, or null on failure.
+/// @ingroup detour
+dtPolyAdjacency* dtAllocPolyAdjacency();
+
+/// Frees the specified poly adjacency object using the Detour allocator.
+///  @param[in]	adjacency	A poly adjacency object allocated using #dtAllocPolyAdjacency
+/// @ingroup detour
+void dtFreePolyAdjacency(dtPolyAdjacency* adjacency);
+
+#endif // DETOURPOLYADJACENCY_H
@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURPOLYOVERLAY_H
+#define DETOURPOLYOVERLAY_H
+
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+/// Per-polygon flag and area overrides that dtQueryFilter consults before the
+/// values stored in the navigation mesh. Several users can share one read-only
+/// mesh while each keeps its own door and bridge state.
+///
+/// Overrides are stored per tile, and only for tiles that have at least one,
+/// so clearing, copying and diffing cost is proportional to the touched tiles.
+/// A lookup is a reference decode, a bit test and an array read.
+/// @ingroup detour
+class dtPolyOverlay
+{
+public:
+	dtPolyOverlay();
+	~dtPolyOverlay();
+
+	/// Binds the overlay to a mesh and drops all overrides.
+	///  @param[in]	nav		The mesh the polygon references belong to.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav);
+
+	/// Drops all overrides.
+	void clear();
+
+	/// Overrides the flags of a polygon. Its area keeps its current value.
+	///  @param[in]	ref		The polygon reference.
+	///  @param[in]	flags	The new flags for the polygon.
+	/// @returns The status flags for the operation.
+	dtStatus setPolyFlags(dtPolyRef ref, unsigned short flags);
+
+	/// Overrides the area of a polygon. Its flags keep their current value.
+	///  @param[in]	ref		The polygon reference.
+	///  @param[in]	area	The new area id for the polygon. [Limit: < #DT_MAX_AREAS]
+	/// @returns The status flags for the operation.
+	dtStatus setPolyArea(dtPolyRef ref, unsigned char area);
+
+	/// Removes the override of a polygon so it uses the mesh values again.
+	///  @param[in]	ref		The polygon reference.
+	/// @returns The status flags for the operation.
+	dtStatus resetPoly(dtPolyRef ref);
+
+	/// Gets the effective flags of a polygon.
+	///  @param[in]	ref			The polygon reference.
+	///  @param[out]	resultFlags	The polygon flags.
+	/// @returns The status flags for the operation.
+	dtStatus getPolyFlags(dtPolyRef ref, unsigned short* resultFlags) const;
+
+	/// Gets the effective area of a polygon.
+	///  @param[in]	ref			The polygon reference.
+	///  @param[out]	resultArea	The area id of the polygon.
+	/// @returns The status flags for the operation.
+	dtStatus getPolyArea(dtPolyRef ref, unsigned char* resultArea) const;
+
+	/// Replaces the overrides with a copy of another overlay's, binding to
+	/// its mesh.
+	///  @param[in]	other	The overlay to copy.
+	/// @returns The status flags for the operation.
+	dtStatus copyFrom(const dtPolyOverlay& other);
+
+	/// Finds the polygons whose effective flags or area differ between this
+	/// overlay and another one bound to the same mesh.
+	///  @param[in]	other		The overlay to compare with.
+	///  @param[out]	refs		The differing polygon references. [opt]
+	///  @param[out]	refCount	The number of differing polygons.
+	///  @param[in]	maxRefs		The maximum number of references @p refs can hold.
+	/// @returns The status flags for the operation. #DT_BUFFER_TOO_SMALL if
+	/// more polygons differ than fit in @p refs; @p refCount is still complete.
+	dtStatus diff(const dtPolyOverlay& other, dtPolyRef* refs, int* refCount, int maxRefs) const;
+
+	/// The number of overridden polygons.
+	int getOverrideCount() const { return m_overrideCount; }
+
+	/// The mesh the overlay is bound to.
+	const dtNavMesh* getNavMesh() const { return m_nav; }
+
+	/// Returns the flags of @p poly, overridden if the overlay has an entry
+	/// for @p ref. Used by dtQueryFilter.
+	inline unsigned short getFlags(dtPolyRef ref, const dtPoly* poly) const
+	{
+		unsigned int ip;
+		const Tile* tile = findOverride(ref, ip);
+		return tile ? tile->flags[ip] : poly->flags;
+	}
+
+	/// Returns the area of @p poly, overridden if the overlay has an entry
+	/// for @p ref. Used by dtQueryFilter.
+	inline unsigned char getArea(dtPolyRef ref, const dtPoly* poly) const
+	{
+		unsigned int ip;
+		const Tile* tile = findOverride(ref, ip);
+		return tile ? tile->areas[ip] : poly->getArea();
+	}
+
+private:
+	/// Overrides of the polygons of one mesh tile.
+	struct Tile
+	{
+		unsigned int salt;			///< Salt of the mesh tile the overrides belong to.
+		int polyCount;
+		int overrideCount;
+		unsigned int* mask;			///< One bit per polygon, set if overridden.
+		unsigned short* flags;
+		unsigned char* areas;
+	};
+
+	inline void decodePolyId(dtPolyRef ref, unsigned int& salt, unsigned int& it, unsigned int& ip) const
+	{
+		salt = (unsigned int)((ref >> (m_polyBits + m_tileBits)) & m_saltMask);
+		it = (unsigned int)((ref >> m_polyBits) & m_tileMask);
+		ip = (unsigned int)(ref & m_polyMask);
+	}
+
+	inline const Tile* findOverride(dtPolyRef ref, unsigned int& ip) const
+	{
+		if (!m_overrideCount)
+			return 0;
+		unsigned int salt, it;
+		decodePolyId(ref, salt, it, ip);
+		if (it >= (unsigned int)m_maxTiles)
+			return 0;
+		const Tile* tile = m_tiles[it];
+		if (!tile || tile->salt != salt || ip >= (unsigned int)tile->polyCount)
+			return 0;
+		if (!(tile->mask[ip >> 5] & (1u << (ip & 31))))
+			return 0;
+		return tile;
+	}
+
+	dtStatus getOverrideSlot(dtPolyRef ref, Tile** tile, unsigned int* ip);
+	Tile* allocTile(unsigned int salt, int polyCount);
+	int diffTile(const Tile* tile, const dtPolyOverlay& other, const Tile* otherTile, unsigned int it,
+				 dtPolyRef* refs, int count, int maxRefs) const;
+
+	const dtNavMesh* m_nav;
+	Tile** m_tiles;					///< Indexed by mesh tile index, null for untouched tiles.
+	int* m_used;					///< Indices of the non-null entries of m_tiles.
+	int m_usedCount;
+	int m_maxTiles;
+	int m_overrideCount;
+
+	unsigned int m_polyBits;
+	unsigned int m_tileBits;
+	dtPolyRef m_saltMask;
+	dtPolyRef m_tileMask;
+	dtPolyRef m_polyMask;
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPolyOverlay(const dtPolyOverlay&);
+	dtPolyOverlay& operator=(const dtPolyOverlay&);
+};
+
+#endif // DETOURPOLYOVERLAY_H
@@ -0,0 +1,471 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTILEGRAPH_H
+#define DETOURTILEGRAPH_H
+
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourNode.h"
+#include "DetourStatus.h"
+
+/// Marks a polygon that is not a node of the tile graph.
+static const unsigned short DT_TILE_GRAPH_NO_NODE = 0xffff;
+
+/// Abstract graph of a navigation mesh for long distance searches. Its nodes
+/// are the polygons that have links into a neighbouring tile. One node of
+/// each run of them along a tile border is the exit the search leaves the
+/// tile from, and the edges are the cheapest paths from each node to the
+/// exits of its tile, precomputed with the filter the graph was built with.
+/// Links between tiles are read from the mesh when searching, they are not
+/// copied.
+///
+/// The graph is kept per tile, so adding or removing a mesh tile only rebuilds
+/// that tile and its neighbours. Used by dtNavMeshQuery::findPathHierarchical.
+/// @ingroup detour
+class dtTileGraph
+{
+public:
+	/// The cheapest path from a border polygon to an exit of the same tile.
+	struct Edge
+	{
+		unsigned short node;		///< Index of the target exit in the tile.
+		float cost;					///< Cost of the path, without leaving the tile.
+	};
+
+	/// The nodes and edges of one mesh tile.
+	struct Tile
+	{
+		unsigned int salt;			///< Salt of the mesh tile the graph was built from.
+		int x, y, layer;			///< Location of the mesh tile, kept to find its neighbours after removal.
+		int polyCount;
+		int nodeCount;
+		int edgeCount;
+		unsigned short* nodeOfPoly;	///< Node of each polygon, #DT_TILE_GRAPH_NO_NODE if not on the border. [Size: polyCount]
+		unsigned int* nodePoly;		///< Polygon index of each node. [Size: nodeCount]
+		float* nodePos;				///< Center of the polygon of each node. [(x, y, z) * nodeCount]
+		unsigned char* nodeExit;	///< Nonzero for the nodes searches leave the tile from. [Size: nodeCount]
+		int* firstEdge;				///< The edges of node i are [firstEdge[i], firstEdge[i + 1]). [Size: nodeCount + 1]
+		Edge* edges;				///< [Size: edgeCount]
+	};
+
+	dtTileGraph();
+	~dtTileGraph();
+
+	/// Builds the graph of every tile in the mesh.
+	///  @param[in]	nav		The mesh to build the graph for. Must outlive the graph.
+	///  @param[in]	filter	Decides which polygons the edges may cross and what
+	///  					they cost. It is copied.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter);
+
+	/// Builds the graph of a tile that was added to the mesh, and rebuilds its
+	/// neighbours whose border polygons changed.
+	///  @param[in]	ref		The reference of the added tile.
+	/// @returns The status flags for the operation.
+	dtStatus addTile(dtTileRef ref);
+
+	/// Drops the graph of a tile that was removed from the mesh, and rebuilds
+	/// its neighbours whose border polygons changed.
+	///  @param[in]	ref		The reference the tile had before it was removed.
+	/// @returns The status flags for the operation.
+	dtStatus removeTile(dtTileRef ref);
+
+	/// Returns the graph of the tile @p ref belongs to and the polygon index
+	/// of @p ref in it, or null if the tile has no graph or it was built
+	/// from a tile that has since been replaced.
+	inline const Tile* getPolyTile(dtPolyRef ref, unsigned int* ip) const
+	{
+		unsigned int salt, it;
+		m_nav->decodePolyId(ref, salt, it, *ip);
+		if (it >= (unsigned int)m_maxTiles)
+			return 0;
+		const Tile* tile = m_tiles[it];
+		if (!tile || tile->salt != salt || *ip >= (unsigned int)tile->polyCount)
+			return 0;
+		return tile;
+	}
+
+	/// The mesh the graph was built for.
+	const dtNavMesh* getNavMesh() const { return m_nav; }
+
+	/// The filter the edge costs were computed with.
+	const dtQueryFilter* getFilter() const { return &m_filter; }
+
+	/// The flags found on the polygons of the tiles the graph was built
+	/// from. Removing tiles does not clear flags.
+	unsigned short getPolyFlags() const { return m_polyFlags; }
+
+	/// The number of nodes in all tiles.
+	int getNodeCount() const { return m_nodeCount; }
+
+	/// The number of edges in all tiles.
+	int getEdgeCount() const { return m_edgeCount; }
+
+private:
+	dtStatus buildTile(int index);
+	void freeTile(int index);
+	dtStatus rebuildNeighbours(int x, int y);
+	bool linksInto(const dtMeshTile* tile, int ip, unsigned int neighbourIndex) const;
+
+	const dtNavMesh* m_nav;
+	dtQueryFilter m_filter;
+	Tile** m_tiles;					///< Indexed by mesh tile index, null for empty tiles.
+	int m_maxTiles;
+	int m_nodeCount;
+	int m_edgeCount;
+	unsigned short m_polyFlags;
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTileGraph(const dtTileGraph&);
+	dtTileGraph& operator=(const dtTileGraph&);
+};
+
+/// Allocates a tile graph object using the Detour allocator.
+/// @return A tile graph that is ready for initialization, or null on failure.
+/// @ingroup detour
+dtTileGraph* dtAllocTileGraph();
+
+/// Frees the specified tile graph object using the Detour allocator.
+///  @param[in]	graph		A tile graph allocated using #dtAllocTileGraph
+/// @ingroup detour
+void dtFreeTileGraph(dtTileGraph* graph);
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::findPathHierarchical(const dtTileGraph* graph, dtPolyRef startRef, dtPolyRef endRef,
+											  const float* startPos, const float* endPos,
+											  const TFilter* filter,
+											  dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+
+	// Validate input
+	if (!graph || graph->getNavMesh() != m_nav ||
+		!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
+		!startPos || !dtVisfinite(startPos) ||
+		!endPos || !dtVisfinite(endPos) ||
+		!filter || !path || maxPath <= 0)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	if (startRef == endRef)
+	{
+		path[0] = startRef;
+		*pathCount = 1;
+		return DT_SUCCESS;
+	}
+
+	const unsigned int startTileIndex = m_nav->decodePolyIdTile(startRef);
+	const unsigned int endTileIndex = m_nav->decodePolyIdTile(endRef);
+
+	m_nodePool->clear();
+	m_openList->clear();
+
+	dtNode* startNode = m_nodePool->getNode(startRef);
+	dtVcopy(startNode->pos, startPos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = dtVdist(startPos, endPos) * DT_H_SCALE;
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_OPEN;
+	m_openList->push(startNode);
+
+	dtNode* lastBestNode = startNode;
+	float lastBestNodeCost = startNode->total;
+	bool outOfNodes = false;
+
+	while (!m_openList->empty())
+	{
+		dtNode* bestNode = m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+
+		if (bestNode->id == endRef)
+		{
+			lastBestNode = bestNode;
+			break;
+		}
+
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef)
+			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+
+		// The start and end tiles, and tiles the graph has nothing for, are
+		// searched polygon by polygon. Elsewhere the graph edges cross the
+		// tile and only the links of its exits into other tiles are followed.
+		unsigned int bestIp = 0;
+		const dtTileGraph::Tile* graphTile = graph->getPolyTile(bestRef, &bestIp);
+		const unsigned int bestTileIndex = m_nav->decodePolyIdTile(bestRef);
+		const bool local = !graphTile || bestTileIndex == startTileIndex || bestTileIndex == endTileIndex;
+		const bool exit = !local && graphTile->nodeOfPoly[bestIp] != DT_TILE_GRAPH_NO_NODE &&
+			graphTile->nodeExit[graphTile->nodeOfPoly[bestIp]];
+
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			const dtPolyRef neighbourRef = bestTile->links[i].ref;
+			if (!neighbourRef || neighbourRef == parentRef)
+				continue;
+			if (!local && (!exit || m_nav->decodePolyIdTile(neighbourRef) == bestTileIndex))
+				continue;
+
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef);
+			if (!neighbourNode)
+			{
+				outOfNodes = true;
+				continue;
+			}
+
+			if (neighbourNode->flags == 0)
+			{
+				getEdgeMidPoint(bestRef, bestPoly, bestTile,
+								neighbourRef, neighbourPoly, neighbourTile,
+								neighbourNode->pos);
+			}
+
+			float cost = bestNode->cost + filter->getCost(bestNode->pos, neighbourNode->pos,
+														  parentRef, parentTile, parentPoly,
+														  bestRef, bestTile, bestPoly,
+														  neighbourRef, neighbourTile, neighbourPoly);
+			float heuristic = 0;
+			if (neighbourRef == endRef)
+			{
+				cost += filter->getCost(neighbourNode->pos, endPos,
+										bestRef, bestTile, bestPoly,
+										neighbourRef, neighbourTile, neighbourPoly,
+										0, 0, 0);
+			}
+			else
+			{
+				heuristic = dtVdist(neighbourNode->pos, endPos) * DT_H_SCALE;
+			}
+
+			const float total = cost + heuristic;
+			if ((neighbourNode->flags & (DT_NODE_OPEN | DT_NODE_CLOSED)) && total >= neighbourNode->total)
+				continue;
+
+			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->id = neighbourRef;
+			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+			neighbourNode->cost = cost;
+			neighbourNode->total = total;
+
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				m_openList->modify(neighbourNode);
+			}
+			else
+			{
+				neighbourNode->flags |= DT_NODE_OPEN;
+				m_openList->push(neighbourNode);
+			}
+
+			if (heuristic < lastBestNodeCost)
+			{
+				lastBestNodeCost = heuristic;
+				lastBestNode = neighbourNode;
+			}
+		}
+
+		if (!graphTile || graphTile->nodeOfPoly[bestIp] == DT_TILE_GRAPH_NO_NODE)
+			continue;
+
+		// Graph edges to the exits of the tile.
+		const dtPolyRef base = m_nav->getPolyRefBase(bestTile);
+		const int node = graphTile->nodeOfPoly[bestIp];
+		for (int i = graphTile->firstEdge[node]; i < graphTile->firstEdge[node + 1]; ++i)
+		{
+			const dtTileGraph::Edge& edge = graphTile->edges[i];
+			const dtPolyRef targetRef = base | (dtPolyRef)graphTile->nodePoly[edge.node];
+			if (targetRef == parentRef)
+				continue;
+
+			const dtPoly* targetPoly = &bestTile->polys[graphTile->nodePoly[edge.node]];
+			if (!filter->passFilter(targetRef, bestTile, targetPoly))
+				continue;
+
+			dtNode* targetNode = m_nodePool->getNode(targetRef);
+			if (!targetNode)
+			{
+				outOfNodes = true;
+				continue;
+			}
+
+			if (targetNode->flags == 0)
+				dtVcopy(targetNode->pos, &graphTile->nodePos[edge.node * 3]);
+
+			float cost = bestNode->cost + edge.cost;
+			float heuristic = 0;
+			if (targetRef == endRef)
+			{
+				cost += filter->getCost(targetNode->pos, endPos,
+										bestRef, bestTile, bestPoly,
+										targetRef, bestTile, targetPoly,
+										0, 0, 0);
+			}
+			else
+			{
+				heuristic = dtVdist(targetNode->pos, endPos) * DT_H_SCALE;
+			}
+
+			const float total = cost + heuristic;
+			if ((targetNode->flags & (DT_NODE_OPEN | DT_NODE_CLOSED)) && total >= targetNode->total)
+				continue;
+
+			targetNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			targetNode->id = targetRef;
+			targetNode->flags = (targetNode->flags & ~DT_NODE_CLOSED);
+			targetNode->cost = cost;
+			targetNode->total = total;
+
+			if (targetNode->flags & DT_NODE_OPEN)
+			{
+				m_openList->modify(targetNode);
+			}
+			else
+			{
+				targetNode->flags |= DT_NODE_OPEN;
+				m_openList->push(targetNode);
+			}
+
+			if (heuristic < lastBestNodeCost)
+			{
+				lastBestNodeCost = heuristic;
+				lastBestNode = targetNode;
+			}
+		}
+	}
+
+	// Copy the route out of the node pool, the searches along the graph
+	// edges below reuse it.
+	const bool reached = lastBestNode->id == endRef;
+	int waypointCount = 0;
+	for (const dtNode* node = lastBestNode; node; node = m_nodePool->getNodeAtIdx(node->pidx))
+		waypointCount++;
+
+	unsigned char* waypointData = (unsigned char*)dtAlloc((sizeof(dtPolyRef) + sizeof(float) * 3) * waypointCount, DT_ALLOC_TEMP);
+	if (!waypointData)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	dtPolyRef* waypoints = (dtPolyRef*)waypointData;
+	float* waypointPos = (float*)(waypointData + sizeof(dtPolyRef) * waypointCount);
+
+	int n = waypointCount;
+	for (const dtNode* node = lastBestNode; node; node = m_nodePool->getNodeAtIdx(node->pidx))
+	{
+		--n;
+		waypoints[n] = node->id;
+		dtVcopy(&waypointPos[n * 3], node->pos);
+	}
+	if (reached)
+		dtVcopy(&waypointPos[(waypointCount - 1) * 3], endPos);
+
+	dtStatus status = DT_SUCCESS;
+	int count = 0;
+	path[count++] = startRef;
+	for (int i = 1; i < waypointCount; ++i)
+	{
+		// Waypoints next to each other are linked, a graph edge needs the
+		// corridor inside its tile.
+		const dtPolyRef fromRef = waypoints[i - 1];
+		const dtPolyRef toRef = waypoints[i];
+		const dtMeshTile* fromTile = 0;
+		const dtPoly* fromPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(fromRef, &fromTile, &fromPoly);
+
+		bool linked = false;
+		for (unsigned int j = fromPoly->firstLink; j != DT_NULL_LINK; j = fromTile->links[j].next)
+		{
+			if (fromTile->links[j].ref == toRef)
+			{
+				linked = true;
+				break;
+			}
+		}
+
+		if (linked)
+		{
+			if (count >= maxPath)
+			{
+				status |= DT_BUFFER_TOO_SMALL;
+				break;
+			}
+			path[count++] = toRef;
+			continue;
+		}
+
+		int legCount = 0;
+		dtStatus legStatus = findPath(fromRef, toRef, &waypointPos[(i - 1) * 3], &waypointPos[i * 3], filter,
+									  path + count - 1, &legCount, maxPath - count + 1);
+		if (dtStatusFailed(legStatus))
+		{
+			status = legStatus;
+			break;
+		}
+		count += legCount - 1;
+		if (dtStatusDetail(legStatus, DT_BUFFER_TOO_SMALL))
+		{
+			status |= DT_BUFFER_TOO_SMALL;
+			break;
+		}
+		if (path[count - 1] != toRef)
+		{
+			// The filter blocks a polygon the edge was built through.
+			status = DT_FAILURE;
+			break;
+		}
+	}
+
+	dtFree(waypointData);
+
+	if (dtStatusFailed(status))
+		return status;
+
+	*pathCount = count;
+	if (!reached)
+		status |= DT_PARTIAL_RESULT;
+	if (outOfNodes)
+		status |= DT_OUT_OF_NODES;
+	return status;
+}
+
+#endif // DETOURTILEGRAPH_H
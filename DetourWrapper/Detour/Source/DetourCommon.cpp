@@ -264,7 +264,28 @@ bool dtDistancePtPolyEdgesSqr(const float* pt, const float* verts, const int nve
 		if (((vi[2] > pt[2]) != (vj[2] > pt[2])) &&
 			(pt[0] < (vj[0]-vi[0]) * (pt[2]-vi[2]) / (vj[2]-vi[2]) + vi[0]) )
 			c = !c;
-		ed[j] = dtDistancePtSegSqr2D(pt, vj, vi, et[j]);
+	}
+
+	// Edge i runs from vertex i to the next one.
+	for (i = 0; i < nverts; i += DT_BATCH_WIDTH)
+	{
+		const int n = dtMin(nverts - i, DT_BATCH_WIDTH);
+		const float* vp[DT_BATCH_WIDTH];
+		const float* vq[DT_BATCH_WIDTH];
+		for (j = 0; j < DT_BATCH_WIDTH; ++j)
+		{
+			// Unused lanes repeat the last edge.
+			const int k = i + dtMin(j, n-1);
+			vp[j] = &verts[k*3];
+			vq[j] = &verts[((k+1) % nverts)*3];
+		}
+		float dist[DT_BATCH_WIDTH], t[DT_BATCH_WIDTH];
+		dtDistancePtSegsSqr2D(pt, vp, vq, dist, t);
+		for (j = 0; j < n; ++j)
+		{
+			ed[i+j] = dist[j];
+			et[i+j] = t[j];
+		}
 	}
 	return c;
 }
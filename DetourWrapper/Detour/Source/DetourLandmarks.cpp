@@ -0,0 +1,416 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <string.h>
+#include <new>
+#include "DetourLandmarks.h"
+#include "DetourNode.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+
+/// @class dtLandmarks
+///
+/// The costs are those of the portal graph: a node per link between two
+/// polygons, at the middle of the shared edge, and an edge between every two
+/// portals of a polygon costed with that polygon's area. This is the graph
+/// #dtNavMeshQuery::findPath walks, so the bounds hold for its paths; costs
+/// between polygon centers would not, they zigzag and overestimate.
+///
+/// A polygon keeps the lowest and highest cost of its portals. Rounding the
+/// lowest down and the highest up keeps the bounds of #dtLandmarkHeuristic
+/// below the real cost.
+///
+/// Landmarks are picked by farthest point selection: the first is the
+/// portal farthest from the start of the search, each further one the
+/// portal whose cost from the nearest landmark so far is highest.
+
+dtLandmarks* dtAllocLandmarks()
+{
+	void* mem = dtAlloc(sizeof(dtLandmarks), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtLandmarks;
+}
+
+void dtFreeLandmarks(dtLandmarks* landmarks)
+{
+	if (!landmarks) return;
+	landmarks->~dtLandmarks();
+	dtFree(landmarks);
+}
+
+namespace
+{
+	/// Build time scratch shared by the searches.
+	struct LandmarkScratch
+	{
+		int linkCount;
+		int* tileLinkOffsets;			///< First link of each tile in the arrays below.
+		int* portals;					///< Portal of each link, -1 for unused links.
+		int* portalPolys;				///< [(polygon index) * 2 * links], the two polygons of each portal.
+		float* portalPos;				///< [(x, y, z) * links], middle of each portal.
+		dtCostQueueEntry* heap;
+		int heapSize;
+	};
+}
+
+static const dtLink* findLink(const dtMeshTile* tile, const dtPoly* poly, dtPolyRef to)
+{
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		if (tile->links[i].ref == to)
+			return &tile->links[i];
+	}
+	return 0;
+}
+
+// Middle of the portal of link, the way dtNavMeshQuery::getPortalPoints
+// places it.
+static void calcPortalMid(const dtMeshTile* fromTile, const dtPoly* fromPoly, const dtLink* link,
+						  dtPolyRef from, const dtMeshTile* toTile, const dtPoly* toPoly, float* mid)
+{
+	if (fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		dtVcopy(mid, &fromTile->verts[fromPoly->verts[link->edge]*3]);
+		return;
+	}
+	if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		const dtLink* back = findLink(toTile, toPoly, from);
+		dtVcopy(mid, &toTile->verts[toPoly->verts[back ? back->edge : 0]*3]);
+		return;
+	}
+
+	const float* v0 = &fromTile->verts[fromPoly->verts[link->edge]*3];
+	const float* v1 = &fromTile->verts[fromPoly->verts[(link->edge+1) % (int)fromPoly->vertCount]*3];
+	float tmin = 0.0f, tmax = 1.0f;
+	if (link->side != 0xff && (link->bmin != 0 || link->bmax != 255))
+	{
+		tmin = link->bmin/255.0f;
+		tmax = link->bmax/255.0f;
+	}
+	dtVlerp(mid, v0, v1, (tmin + tmax) * 0.5f);
+}
+
+dtLandmarks::dtLandmarks() :
+	m_nav(0),
+	m_count(0),
+	m_scale(0),
+	m_maxTiles(0),
+	m_polyCount(0),
+	m_tileOffsets(0),
+	m_tilePolyCounts(0),
+	m_tileSalts(0),
+	m_costs(0)
+{
+}
+
+dtLandmarks::~dtLandmarks()
+{
+	clear();
+}
+
+void dtLandmarks::clear()
+{
+	dtFree(m_tileOffsets);
+	dtFree(m_tilePolyCounts);
+	dtFree(m_tileSalts);
+	dtFree(m_costs);
+	m_tileOffsets = 0;
+	m_tilePolyCounts = 0;
+	m_tileSalts = 0;
+	m_costs = 0;
+	m_nav = 0;
+	m_count = 0;
+	m_scale = 0;
+	m_maxTiles = 0;
+	m_polyCount = 0;
+}
+
+/// Costs from portal @p start to every portal through the polygons that
+/// pass the filter. Unreached portals get FLT_MAX.
+static dtStatus searchPortals(const dtNavMesh* nav, const dtQueryFilter& filter, const dtPolyRef* refs,
+							  const LandmarkScratch& scratch, int start, float* costs)
+{
+	for (int i = 0; i < scratch.linkCount; ++i)
+		costs[i] = FLT_MAX;
+	costs[start] = 0.0f;
+
+	dtCostQueue open(scratch.heap, scratch.heapSize);
+	open.push(0.0f, (unsigned int)start);
+	while (!open.empty())
+	{
+		const dtCostQueueEntry best = open.pop();
+		if (best.cost > costs[best.index])
+			continue;
+
+		const float* bestPos = &scratch.portalPos[best.index*3];
+		for (int side = 0; side < 2; ++side)
+		{
+			const dtPolyRef ref = refs[scratch.portalPolys[best.index*2 + side]];
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+			if (!filter.passFilter(ref, tile, poly))
+				continue;
+
+			unsigned int salt, it, ip;
+			nav->decodePolyId(ref, salt, it, ip);
+			for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+			{
+				const int portal = scratch.portals[scratch.tileLinkOffsets[it] + (int)i];
+				if (portal < 0 || portal == (int)best.index)
+					continue;
+
+				const float cost = best.cost + filter.getCost(bestPos, &scratch.portalPos[portal*3],
+															  0, 0, 0, ref, tile, poly, 0, 0, 0);
+				if (cost >= costs[portal])
+					continue;
+				if (!open.push(cost, (unsigned int)portal))
+					return DT_FAILURE | DT_OUT_OF_MEMORY;
+				costs[portal] = cost;
+			}
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtLandmarks::init(const dtNavMesh* nav, const dtQueryFilter* filter, int count)
+{
+	clear();
+
+	if (!nav || !filter || count <= 0 || count > DT_MAX_LANDMARKS)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const int maxTiles = nav->getMaxTiles();
+	m_tileOffsets = (int*)dtAlloc(sizeof(int) * maxTiles, DT_ALLOC_PERM);
+	m_tilePolyCounts = (int*)dtAlloc(sizeof(int) * maxTiles, DT_ALLOC_PERM);
+	m_tileSalts = (unsigned int*)dtAlloc(sizeof(unsigned int) * maxTiles, DT_ALLOC_PERM);
+	LandmarkScratch scratch;
+	memset(&scratch, 0, sizeof(scratch));
+	scratch.tileLinkOffsets = (int*)dtAlloc(sizeof(int) * maxTiles, DT_ALLOC_TEMP);
+	if (!m_tileOffsets || !m_tilePolyCounts || !m_tileSalts || !scratch.tileLinkOffsets)
+	{
+		dtFree(scratch.tileLinkOffsets);
+		clear();
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	m_nav = nav;
+	m_filter = *filter;
+	m_maxTiles = maxTiles;
+
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		const dtMeshTile* tile = nav->getTile(i);
+		m_tileOffsets[i] = tile->header ? m_polyCount : -1;
+		m_tilePolyCounts[i] = tile->header ? tile->header->polyCount : 0;
+		m_tileSalts[i] = tile->salt;
+		scratch.tileLinkOffsets[i] = scratch.linkCount;
+		if (tile->header)
+		{
+			m_polyCount += tile->header->polyCount;
+			scratch.linkCount += tile->header->maxLinkCount;
+		}
+	}
+
+	// Scratch: polygon references, portals, costs from each landmark plus
+	// one set for picking the first, the nearest landmark's cost of each
+	// portal, and the open list.
+	dtPolyRef* refs = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef) * (m_polyCount + 1), DT_ALLOC_TEMP);
+	scratch.portals = (int*)dtAlloc(sizeof(int) * (scratch.linkCount + 1), DT_ALLOC_TEMP);
+	scratch.portalPolys = (int*)dtAlloc(sizeof(int) * 2 * (scratch.linkCount + 1), DT_ALLOC_TEMP);
+	scratch.portalPos = (float*)dtAlloc(sizeof(float) * 3 * (scratch.linkCount + 1), DT_ALLOC_TEMP);
+	float* costs = (float*)dtAlloc(sizeof(float) * (scratch.linkCount + 1) * (count + 1), DT_ALLOC_TEMP);
+	float* nearest = (float*)dtAlloc(sizeof(float) * (scratch.linkCount + 1), DT_ALLOC_TEMP);
+	m_costs = (unsigned short*)dtAlloc(sizeof(unsigned short) * (m_polyCount + 1) * count * 2, DT_ALLOC_PERM);
+
+	dtStatus status = DT_SUCCESS;
+	if (!m_polyCount || !scratch.linkCount)
+		status = DT_FAILURE | DT_INVALID_PARAM;
+	else if (!refs || !scratch.portals || !scratch.portalPolys || !scratch.portalPos || !costs || !nearest || !m_costs)
+		status = DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	// Number the portals after the first of their two links and find the
+	// open list size: every portal is expanded once and pushes at most the
+	// portals of its two polygons, so each polygon adds its links squared.
+	int portalCount = 0;
+	for (int i = 0; i < maxTiles && dtStatusSucceed(status); ++i)
+	{
+		const dtMeshTile* tile = nav->getTile(i);
+		if (!tile->header)
+			continue;
+		for (int j = 0; j < tile->header->maxLinkCount; ++j)
+			scratch.portals[scratch.tileLinkOffsets[i] + j] = -1;
+		const dtPolyRef base = nav->getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; ++j)
+			refs[m_tileOffsets[i] + j] = base | (dtPolyRef)j;
+	}
+	for (int i = 0; i < maxTiles && dtStatusSucceed(status); ++i)
+	{
+		const dtMeshTile* tile = nav->getTile(i);
+		if (!tile->header)
+			continue;
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			const dtPoly* poly = &tile->polys[j];
+			const dtPolyRef ref = refs[m_tileOffsets[i] + j];
+			int degree = 0;
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const dtLink* link = &tile->links[k];
+				const int index = scratch.tileLinkOffsets[i] + (int)k;
+				if (link->ref)
+					degree++;
+				if (!link->ref || scratch.portals[index] >= 0)
+					continue;
+
+				const dtMeshTile* toTile = 0;
+				const dtPoly* toPoly = 0;
+				nav->getTileAndPolyByRefUnsafe(link->ref, &toTile, &toPoly);
+				unsigned int salt, it, ip;
+				nav->decodePolyId(link->ref, salt, it, ip);
+
+				const int portal = portalCount++;
+				scratch.portals[index] = portal;
+				scratch.portalPolys[portal*2+0] = m_tileOffsets[i] + j;
+				scratch.portalPolys[portal*2+1] = m_tileOffsets[it] + (int)ip;
+				calcPortalMid(tile, poly, link, ref, toTile, toPoly, &scratch.portalPos[portal*3]);
+
+				// The way back is the same portal.
+				const dtLink* back = findLink(toTile, toPoly, ref);
+				if (back)
+					scratch.portals[scratch.tileLinkOffsets[it] + (int)(back - toTile->links)] = portal;
+			}
+			scratch.heapSize += degree * degree;
+		}
+	}
+	scratch.linkCount = portalCount;
+	scratch.heapSize += 1;
+	scratch.heap = (dtCostQueueEntry*)dtAlloc(sizeof(dtCostQueueEntry) * scratch.heapSize, DT_ALLOC_TEMP);
+	if (dtStatusSucceed(status) && !scratch.heap)
+		status = DT_FAILURE | DT_OUT_OF_MEMORY;
+	if (dtStatusSucceed(status) && !portalCount)
+		status = DT_FAILURE | DT_INVALID_PARAM;
+
+	// The mesh is often several unconnected parts. Start in the part that
+	// holds the most portals, searching from one portal of each part until
+	// a part holds more than half of them or all were tried.
+	float* startCosts = &costs[portalCount * count];
+	int bestReached = 0;
+	int bestStart = 0;
+	for (int i = 0; i < portalCount && dtStatusSucceed(status); ++i)
+		nearest[i] = FLT_MAX;
+	for (int i = 0; i < portalCount && dtStatusSucceed(status); ++i)
+	{
+		if (nearest[i] != FLT_MAX)
+			continue;
+
+		status = searchPortals(nav, m_filter, refs, scratch, i, startCosts);
+		int reached = 0;
+		for (int j = 0; j < portalCount; ++j)
+		{
+			if (startCosts[j] != FLT_MAX)
+			{
+				nearest[j] = 0.0f;
+				reached++;
+			}
+		}
+		if (reached > bestReached)
+		{
+			bestReached = reached;
+			bestStart = i;
+		}
+		if (bestReached * 2 > portalCount)
+			break;
+	}
+	if (dtStatusSucceed(status))
+		status = searchPortals(nav, m_filter, refs, scratch, bestStart, startCosts);
+
+	// Farthest point selection.
+	float maxCost = 0.0f;
+	for (int i = 0; i < portalCount && dtStatusSucceed(status); ++i)
+		nearest[i] = startCosts[i];
+	for (int k = 0; k < count && dtStatusSucceed(status); ++k)
+	{
+		int farthest = bestStart;
+		float farthestCost = -1.0f;
+		for (int i = 0; i < portalCount; ++i)
+		{
+			if (nearest[i] != FLT_MAX && nearest[i] > farthestCost)
+			{
+				farthestCost = nearest[i];
+				farthest = i;
+			}
+		}
+
+		m_landmarks[k] = refs[scratch.portalPolys[farthest*2]];
+		float* landmarkCosts = &costs[portalCount * k];
+		status = searchPortals(nav, m_filter, refs, scratch, farthest, landmarkCosts);
+		for (int i = 0; i < portalCount && dtStatusSucceed(status); ++i)
+		{
+			if (landmarkCosts[i] == FLT_MAX)
+				continue;
+			maxCost = dtMax(maxCost, landmarkCosts[i]);
+			if (k == 0 || landmarkCosts[i] < nearest[i])
+				nearest[i] = landmarkCosts[i];
+		}
+	}
+
+	if (dtStatusSucceed(status))
+	{
+		// Lowest and highest portal cost of each polygon, rounded outwards.
+		m_count = count;
+		m_scale = maxCost > 0.0f ? maxCost / (float)(DT_LANDMARK_UNREACHABLE - 2) : 1.0f;
+		for (int i = 0; i < m_polyCount * count; ++i)
+		{
+			m_costs[(i / count)*count*2 + i % count] = DT_LANDMARK_UNREACHABLE;
+			m_costs[(i / count)*count*2 + count + i % count] = 0;
+		}
+		for (int p = 0; p < portalCount; ++p)
+		{
+			for (int k = 0; k < count; ++k)
+			{
+				const float cost = costs[portalCount * k + p];
+				if (cost == FLT_MAX)
+					continue;
+				const unsigned short low = (unsigned short)dtMin((float)(DT_LANDMARK_UNREACHABLE - 2), cost / m_scale);
+				const unsigned short high = (unsigned short)(low + 1);
+				for (int side = 0; side < 2; ++side)
+				{
+					unsigned short* polyCosts = &m_costs[scratch.portalPolys[p*2 + side]*count*2];
+					polyCosts[k] = dtMin(polyCosts[k], low);
+					polyCosts[count + k] = dtMax(polyCosts[count + k], high);
+				}
+			}
+		}
+	}
+
+	dtFree(refs);
+	dtFree(scratch.tileLinkOffsets);
+	dtFree(scratch.portals);
+	dtFree(scratch.portalPolys);
+	dtFree(scratch.portalPos);
+	dtFree(scratch.heap);
+	dtFree(costs);
+	dtFree(nearest);
+	if (dtStatusFailed(status))
+		clear();
+	return status;
+}
@@ -191,6 +191,8 @@ dtNavMesh::dtNavMesh() :
 	m_maxTiles(0),
 	m_tileLutSize(0),
 	m_tileLutMask(0),
+	m_tileGridWidth(0),
+	m_tileGridHeight(0),
 	m_posLookup(0),
 	m_nextFree(0),
 	m_tiles(0)
@@ -204,6 +206,8 @@ dtNavMesh::dtNavMesh() :
 	m_orig[0] = 0;
 	m_orig[1] = 0;
 	m_orig[2] = 0;
+	m_tileGridMin[0] = 0;
+	m_tileGridMin[1] = 0;
 }
 
 dtNavMesh::~dtNavMesh()
@@ -216,12 +220,24 @@ dtNavMesh::~dtNavMesh()
 			m_tiles[i].data = 0;
 			m_tiles[i].dataSize = 0;
 		}
+		dtFree(m_tiles[i].bvWideTree);
 	}
 	dtFree(m_posLookup);
 	dtFree(m_tiles);
 }
 		
 dtStatus dtNavMesh::init(const dtNavMeshParams* params)
+{
+	return init(params, 0);
+}
+
+/// @par
+///
+/// Zones are bounded, so their tile locations fill most of their bounds and
+/// a grid finds a tile with one lookup, where the hash has about four tiles
+/// per slot to compare. Sparse worlds, whose bounds would need a grid much
+/// larger than the tile count, keep the hash.
+dtStatus dtNavMesh::init(const dtNavMeshParams* params, const dtNavMeshTileBounds* bounds)
 {
 	memcpy(&m_params, params, sizeof(dtNavMeshParams));
 	dtVcopy(m_orig, params->orig);
@@ -233,6 +249,25 @@ dtStatus dtNavMesh::init(const dtNavMeshParams* params)
 	m_tileLutSize = dtNextPow2(params->maxTiles/4);
 	if (!m_tileLutSize) m_tileLutSize = 1;
 	m_tileLutMask = m_tileLutSize-1;
+	m_tileGridMin[0] = 0;
+	m_tileGridMin[1] = 0;
+	m_tileGridWidth = 0;
+	m_tileGridHeight = 0;
+
+	if (bounds && bounds->minx <= bounds->maxx && bounds->miny <= bounds->maxy)
+	{
+		const long long width = (long long)bounds->maxx - bounds->minx + 1;
+		const long long height = (long long)bounds->maxy - bounds->miny + 1;
+		if (width * height <= (long long)dtMax(m_maxTiles, 1) * DT_TILE_GRID_MAX_CELLS_PER_TILE)
+		{
+			m_tileGridMin[0] = bounds->minx;
+			m_tileGridMin[1] = bounds->miny;
+			m_tileGridWidth = (int)width;
+			m_tileGridHeight = (int)height;
+			m_tileLutSize = (int)(width * height);
+			m_tileLutMask = 0;
+		}
+	}
 	
 	m_tiles = (dtMeshTile*)dtAlloc(sizeof(dtMeshTile)*m_maxTiles, DT_ALLOC_PERM);
 	if (!m_tiles)
@@ -279,8 +314,12 @@ dtStatus dtNavMesh::init(unsigned char* data, const int dataSize, const int flag
 	params.tileHeight = header->bmax[2] - header->bmin[2];
 	params.maxTiles = 1;
 	params.maxPolys = header->polyCount;
+
+	dtNavMeshTileBounds bounds;
+	bounds.minx = bounds.maxx = header->x;
+	bounds.miny = bounds.maxy = header->y;
 	
-	dtStatus status = init(&params);
+	dtStatus status = init(&params, &bounds);
 	if (dtStatusFailed(status))
 		return status;
 
@@ -618,16 +657,69 @@ void dtNavMesh::baseOffMeshLinks(dtMeshTile* tile)
 
 namespace
 {
+	inline const float* getDetailVertex(const dtMeshTile* tile, const dtPoly* poly, const dtPolyDetail* pd, unsigned char index)
+	{
+		if (index < poly->vertCount)
+			return &tile->verts[poly->verts[index]*3];
+		return &tile->detailVerts[(pd->vertBase+(index-poly->vertCount))*3];
+	}
+
+	// Collects detail edges into blocks for dtDistancePtSegsSqr2D and keeps
+	// the first closest one, as testing them one by one would.
+	struct ClosestDetailEdge
+	{
+		const float* p[DT_BATCH_WIDTH];
+		const float* q[DT_BATCH_WIDTH];
+		int count;
+		float dmin;
+		float tmin;
+		const float* pmin;
+		const float* pmax;
+
+		ClosestDetailEdge() : count(0), dmin(FLT_MAX), tmin(0), pmin(0), pmax(0) {}
+
+		void add(const float* pos, const float* a, const float* b)
+		{
+			p[count] = a;
+			q[count] = b;
+			if (++count == DT_BATCH_WIDTH)
+				flush(pos);
+		}
+
+		void flush(const float* pos)
+		{
+			if (!count)
+				return;
+			// Unused lanes repeat the last edge.
+			for (int i = count; i < DT_BATCH_WIDTH; ++i)
+			{
+				p[i] = p[count-1];
+				q[i] = q[count-1];
+			}
+
+			float dist[DT_BATCH_WIDTH], t[DT_BATCH_WIDTH];
+			dtDistancePtSegsSqr2D(pos, p, q, dist, t);
+			for (int i = 0; i < count; ++i)
+			{
+				if (dist[i] < dmin)
+				{
+					dmin = dist[i];
+					tmin = t[i];
+					pmin = p[i];
+					pmax = q[i];
+				}
+			}
+			count = 0;
+		}
+	};
+
 	template<bool onlyBoundary>
 	void closestPointOnDetailEdges(const dtMeshTile* tile, const dtPoly* poly, const float* pos, float* closest)
 	{
 		const unsigned int ip = (unsigned int)(poly - tile->polys);
 		const dtPolyDetail* pd = &tile->detailMeshes[ip];
 
-		float dmin = FLT_MAX;
-		float tmin = 0;
-		const float* pmin = 0;
-		const float* pmax = 0;
+		ClosestDetailEdge edge;
 
 		for (int i = 0; i < pd->triCount; i++)
 		{
@@ -658,19 +750,12 @@ namespace
 					continue;
 				}
 
-				float t;
-				float d = dtDistancePtSegSqr2D(pos, v[j], v[k], t);
-				if (d < dmin)
-				{
-					dmin = d;
-					tmin = t;
-					pmin = v[j];
-					pmax = v[k];
-				}
+				edge.add(pos, v[j], v[k]);
 			}
 		}
+		edge.flush(pos);
 
-		dtVlerp(closest, pmin, pmax, tmin);
+		dtVlerp(closest, edge.pmin, edge.pmax, edge.tmin);
 	}
 }
 
@@ -695,20 +780,33 @@ bool dtNavMesh::getPolyHeight(const dtMeshTile* tile, const dtPoly* poly, const
 	if (!height)
 		return true;
 	
-	// Find height at the location.
-	for (int j = 0; j < pd->triCount; ++j)
+	// Find height at the location. Three or more triangles are tested a
+	// block at a time, one or two are cheaper to test one by one.
+	int j = 0;
+	for (; pd->triCount - j > 2; j += DT_BATCH_WIDTH)
 	{
-		const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
-		const float* v[3];
-		for (int k = 0; k < 3; ++k)
+		const int n = dtMin((int)pd->triCount - j, DT_BATCH_WIDTH);
+		const float* tris[DT_BATCH_WIDTH*3];
+		for (int i = 0; i < DT_BATCH_WIDTH; ++i)
 		{
-			if (t[k] < poly->vertCount)
-				v[k] = &tile->verts[poly->verts[t[k]]*3];
-			else
-				v[k] = &tile->detailVerts[(pd->vertBase+(t[k]-poly->vertCount))*3];
+			// Unused lanes repeat the last triangle.
+			const unsigned char* t = &tile->detailTris[(pd->triBase+j+dtMin(i, n-1))*4];
+			for (int k = 0; k < 3; ++k)
+				tris[k*DT_BATCH_WIDTH + i] = getDetailVertex(tile, poly, pd, t[k]);
 		}
 		float h;
-		if (dtClosestHeightPointTriangle(pos, v[0], v[1], v[2], h))
+		if (dtClosestHeightPointTriangles(pos, tris, n, h) >= 0)
+		{
+			*height = h;
+			return true;
+		}
+	}
+	for (; j < pd->triCount; ++j)
+	{
+		const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
+		float h;
+		if (dtClosestHeightPointTriangle(pos, getDetailVertex(tile, poly, pd, t[0]),
+										 getDetailVertex(tile, poly, pd, t[1]), getDetailVertex(tile, poly, pd, t[2]), h))
 		{
 			*height = h;
 			return true;
@@ -905,11 +1003,229 @@ int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, co
 /// removed from this nav mesh.
 ///
 /// @see dtCreateNavMeshData, #removeTile
-dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
-							dtTileRef lastRef, dtTileRef* result)
+/// Returns the number of bytes the sections described by the header take up
+/// in the tile data.
+static int getTileDataSize(const dtMeshHeader* header)
+{
+	return dtAlign4(sizeof(dtMeshHeader)) +
+		dtAlign4(sizeof(float)*3*header->vertCount) +
+		dtAlign4(sizeof(dtPoly)*header->polyCount) +
+		dtAlign4(sizeof(dtLink)*(header->maxLinkCount)) +
+		dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount) +
+		dtAlign4(sizeof(float)*3*header->detailVertCount) +
+		dtAlign4(sizeof(unsigned char)*4*header->detailTriCount) +
+		dtAlign4(sizeof(dtBVNode)*header->bvNodeCount) +
+		dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+}
+
+/// Points the tile at its data and patches the section pointers.
+static void attachTileData(dtMeshTile* tile, unsigned char* data, int dataSize, int flags)
 {
-	// Make sure the data is in right format.
 	dtMeshHeader* header = (dtMeshHeader*)data;
+
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
+	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
+	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
+	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
+	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
+	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
+	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
+	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	
+	unsigned char* d = data + headerSize;
+	tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
+	tile->polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
+	tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
+	tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
+	tile->detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
+	tile->detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
+	tile->bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
+	tile->offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
+
+	// If there are no items in the bvtree, reset the tree pointer.
+	if (!bvtreeSize)
+		tile->bvTree = 0;
+
+	// Init tile.
+	tile->header = header;
+	tile->data = data;
+	tile->dataSize = dataSize;
+	tile->flags = flags;
+}
+
+#ifdef DT_SSE2
+namespace
+{
+	/// State of the wide bounding volume tree build of one tile.
+	struct dtBVWideBuild
+	{
+		const dtBVNode* nodes;
+		int nodeCount;
+		int polyCount;
+		dtBVWideNode* wide;
+		int wideCount;
+		int maxWideCount;
+	};
+}
+
+static int bvSubtreeSize(const dtBVNode* node)
+{
+	return node->i >= 0 ? 1 : -node->i;
+}
+
+static bool bvContains(const dtBVNode* outer, const dtBVNode* inner)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		if (inner->bmin[i] < outer->bmin[i] || inner->bmax[i] > outer->bmax[i])
+			return false;
+	}
+	return true;
+}
+
+/// Finds the two children of internal node @p index, checking that they
+/// split its subtree and lie inside its box.
+static bool bvSplit(const dtBVWideBuild& build, int index, int* left, int* right)
+{
+	const int end = index + bvSubtreeSize(&build.nodes[index]);
+	if (end > build.nodeCount || end - index < 3)
+		return false;
+	*left = index + 1;
+	*right = *left + bvSubtreeSize(&build.nodes[*left]);
+	if (*right >= end || *right + bvSubtreeSize(&build.nodes[*right]) != end)
+		return false;
+	return bvContains(&build.nodes[index], &build.nodes[*left]) &&
+		bvContains(&build.nodes[index], &build.nodes[*right]);
+}
+
+/// Adds a wide node holding binary nodes @p roots, or their descendants,
+/// and depth first the wide nodes below it. Returns its index, or -1 if the
+/// nodes can not be collapsed.
+static int buildBVWideNode(dtBVWideBuild& build, const int* roots, int rootCount, int depth)
+{
+	if (depth >= DT_BV_WIDE_MAX_DEPTH || build.wideCount >= build.maxWideCount || rootCount > DT_BV_WIDE_CHILDREN)
+		return -1;
+
+	// Replace the largest internal child by its two children until the
+	// node is full. Skipping the box test of the replaced node does not
+	// change the result, as its children's boxes are inside it.
+	int children[DT_BV_WIDE_CHILDREN];
+	int n = rootCount;
+	memcpy(children, roots, sizeof(int) * rootCount);
+	while (n < DT_BV_WIDE_CHILDREN)
+	{
+		int best = -1;
+		for (int i = 0; i < n; ++i)
+		{
+			if (build.nodes[children[i]].i < 0 && (best < 0 || bvSubtreeSize(&build.nodes[children[i]]) > bvSubtreeSize(&build.nodes[children[best]])))
+				best = i;
+		}
+		if (best < 0)
+			break;
+		int left, right;
+		if (!bvSplit(build, children[best], &left, &right))
+			return -1;
+		for (int i = n; i > best + 1; --i)
+			children[i] = children[i - 1];
+		children[best] = left;
+		children[best + 1] = right;
+		n++;
+	}
+
+	const int wideIndex = build.wideCount++;
+	dtBVWideNode* wide = &build.wide[wideIndex];
+	for (int j = 0; j < DT_BV_WIDE_CHILDREN; ++j)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			wide->bmin[i][j] = 0x7fff;
+			wide->bmax[i][j] = -0x8000;
+		}
+		wide->child[j] = DT_BV_WIDE_EMPTY;
+	}
+
+	for (int j = 0; j < n; ++j)
+	{
+		const dtBVNode* node = &build.nodes[children[j]];
+		for (int i = 0; i < 3; ++i)
+		{
+			wide->bmin[i][j] = (short)((int)node->bmin[i] - 0x8000);
+			wide->bmax[i][j] = (short)((int)node->bmax[i] - 0x8000);
+		}
+		if (node->i >= 0)
+		{
+			if (node->i >= build.polyCount)
+				return -1;
+			wide->child[j] = ~node->i;
+		}
+		else
+		{
+			const int child = buildBVWideNode(build, &children[j], 1, depth + 1);
+			if (child < 0)
+				return -1;
+			wide->child[j] = child;
+		}
+	}
+
+	return wideIndex;
+}
+
+#endif // DT_SSE2
+
+/// @par
+///
+/// dtCreateNavMeshData stores one node more than its tree has, a leaf of
+/// polygon 0 with an empty box at the origin, which the binary walk visits
+/// after the tree. The wide tree starts from every top level node of the
+/// array so it finds the same polygons.
+///
+/// Without SSE2 testing the eight boxes of a node one by one is slower than
+/// the binary walk, so the tree is only built with it.
+void dtNavMesh::buildTileWideBVTree(dtMeshTile* tile)
+{
+	dtFree(tile->bvWideTree);
+	tile->bvWideTree = 0;
+
+#ifdef DT_SSE2
+	const int nodeCount = tile->header->bvNodeCount;
+	if (!tile->bvTree || nodeCount <= 0)
+		return;
+
+	int roots[DT_BV_WIDE_CHILDREN];
+	int rootCount = 0;
+	for (int i = 0; i < nodeCount; i += bvSubtreeSize(&tile->bvTree[i]))
+	{
+		if (rootCount == DT_BV_WIDE_CHILDREN)
+			return;
+		roots[rootCount++] = i;
+	}
+
+	// Every wide node holds at least one internal node of the binary tree,
+	// which has fewer than half of its nodes internal.
+	dtBVWideBuild build;
+	build.nodes = tile->bvTree;
+	build.nodeCount = nodeCount;
+	build.polyCount = tile->header->polyCount;
+	build.wideCount = 0;
+	build.maxWideCount = nodeCount / 2 + 1;
+	build.wide = (dtBVWideNode*)dtAlloc(sizeof(dtBVWideNode) * build.maxWideCount, DT_ALLOC_TEMP);
+	if (!build.wide)
+		return;
+
+	if (buildBVWideNode(build, roots, rootCount, 0) == 0)
+	{
+		tile->bvWideTree = (dtBVWideNode*)dtAlloc(sizeof(dtBVWideNode) * build.wideCount, DT_ALLOC_PERM);
+		if (tile->bvWideTree)
+			memcpy(tile->bvWideTree, build.wide, sizeof(dtBVWideNode) * build.wideCount);
+	}
+	dtFree(build.wide);
+#endif // DT_SSE2
+}
+
+dtStatus dtNavMesh::allocTile(const dtMeshHeader* header, dtTileRef lastRef, dtMeshTile** result)
+{
+	// Make sure the data is in right format.
 	if (header->magic != DT_NAVMESH_MAGIC)
 		return DT_FAILURE | DT_WRONG_MAGIC;
 	if (header->version != DT_NAVMESH_VERSION)
@@ -922,7 +1238,9 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		return DT_FAILURE | DT_INVALID_PARAM;
 #endif
 		
-	// Make sure the location is free.
+	// Make sure the location is free and inside the tile grid.
+	if (!getTileLookup(header->x, header->y))
+		return DT_FAILURE | DT_INVALID_PARAM;
 	if (getTileAt(header->x, header->y, header->layer))
 		return DT_FAILURE | DT_ALREADY_OCCUPIED;
 		
@@ -968,36 +1286,34 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	// Make sure we could allocate a tile.
 	if (!tile)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	
-	// Insert tile into the position lut.
-	int h = computeTileHash(header->x, header->y, m_tileLutMask);
-	tile->next = m_posLookup[h];
-	m_posLookup[h] = tile;
-	
-	// Patch header pointers.
-	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
-	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
-	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
-	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
-	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
-	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
-	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
-	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
-	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
-	
-	unsigned char* d = data + headerSize;
-	tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
-	tile->polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
-	tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
-	tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
-	tile->detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
-	tile->detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
-	tile->bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
-	tile->offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
+	tile->next = 0;
 
-	// If there are no items in the bvtree, reset the tree pointer.
-	if (!bvtreeSize)
-		tile->bvTree = 0;
+	*result = tile;
+	return DT_SUCCESS;
+}
+
+dtMeshTile** dtNavMesh::getTileLookup(int x, int y) const
+{
+	if (!m_tileGridWidth)
+		return &m_posLookup[computeTileHash(x, y, m_tileLutMask)];
+
+	const unsigned int gx = (unsigned int)(x - m_tileGridMin[0]);
+	const unsigned int gy = (unsigned int)(y - m_tileGridMin[1]);
+	if (gx >= (unsigned int)m_tileGridWidth || gy >= (unsigned int)m_tileGridHeight)
+		return 0;
+	return &m_posLookup[gy * (unsigned int)m_tileGridWidth + gx];
+}
+
+void dtNavMesh::insertTileLookup(dtMeshTile* tile)
+{
+	dtMeshTile** head = getTileLookup(tile->header->x, tile->header->y);
+	tile->next = *head;
+	*head = tile;
+}
+
+void dtNavMesh::connectTileLinks(dtMeshTile* tile)
+{
+	const dtMeshHeader* header = tile->header;
 
 	// Build links freelist
 	tile->linksFreeList = 0;
@@ -1005,18 +1321,19 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	for (int i = 0; i < header->maxLinkCount-1; ++i)
 		tile->links[i].next = i+1;
 
-	// Init tile.
-	tile->header = header;
-	tile->data = data;
-	tile->dataSize = dataSize;
-	tile->flags = flags;
-
 	connectIntLinks(tile);
 
 	// Base off-mesh connections to their starting polygons and connect connections inside the tile.
 	baseOffMeshLinks(tile);
 	connectExtOffMeshLinks(tile, tile, -1);
 
+	buildTileWideBVTree(tile);
+}
+
+void dtNavMesh::connectTileNeighbours(dtMeshTile* tile)
+{
+	const dtMeshHeader* header = tile->header;
+
 	// Create connections with neighbour tiles.
 	static const int MAX_NEIS = 32;
 	dtMeshTile* neis[MAX_NEIS];
@@ -1047,6 +1364,26 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 			connectExtOffMeshLinks(neis[j], tile, dtOppositeTile(i));
 		}
 	}
+}
+
+dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
+							dtTileRef lastRef, dtTileRef* result)
+{
+	dtMeshHeader* header = (dtMeshHeader*)data;
+
+	dtMeshTile* tile = 0;
+	dtStatus status = allocTile(header, lastRef, &tile);
+	if (dtStatusFailed(status))
+		return status;
+	
+	// Patch header pointers.
+	attachTileData(tile, data, dataSize, flags);
+
+	// Insert tile into the position lut.
+	insertTileLookup(tile);
+
+	connectTileLinks(tile);
+	connectTileNeighbours(tile);
 	
 	if (result)
 		*result = getTileRef(tile);
@@ -1054,11 +1391,124 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	return DT_SUCCESS;
 }
 
+/// @par
+///
+/// Splits addTile() into three phases so the per-tile work of a bulk load can
+/// run on several threads:
+/// -# addTileDeferred() reserves the slot and patches the data pointers.
+/// -# connectTileInternal() builds the links inside the tile. It only touches
+///    the tile itself, so different tiles can be processed concurrently.
+/// -# connectTileExternal() makes the tile visible to position lookups and
+///    links it with its neighbours. Call it serially, in the order the tiles
+///    would have been passed to addTile(), to get the same links.
+///
+/// Until its external phase is done the tile is not found by location, so
+/// queries must not run on the mesh in between. Tiles that fail a later phase
+/// have to be released with removeTile().
+dtStatus dtNavMesh::addTileDeferred(unsigned char* data, int dataSize, int flags,
+									dtTileRef lastRef, dtTileRef* result)
+{
+	dtMeshHeader* header = (dtMeshHeader*)data;
+
+	dtMeshTile* tile = 0;
+	dtStatus status = allocTile(header, lastRef, &tile);
+	if (dtStatusFailed(status))
+		return status;
+
+	attachTileData(tile, data, dataSize, flags);
+
+	if (result)
+		*result = getTileRef(tile);
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMesh::connectTileInternal(dtTileRef ref)
+{
+	dtMeshTile* tile = (dtMeshTile*)getTileByRef(ref);
+	if (!tile || !tile->header)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	connectTileLinks(tile);
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMesh::connectTileExternal(dtTileRef ref)
+{
+	dtMeshTile* tile = (dtMeshTile*)getTileByRef(ref);
+	if (!tile || !tile->header)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// Tiles of the same batch were not visible when the slot was reserved.
+	if (getTileAt(tile->header->x, tile->header->y, tile->header->layer))
+		return DT_FAILURE | DT_ALREADY_OCCUPIED;
+
+	insertTileLookup(tile);
+	connectTileNeighbours(tile);
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The tile data must come from a tile that was added with addTile() to a mesh
+/// with the same parameters, and must have been saved after all of its
+/// neighbours were added, so its links are complete. The links are checked
+/// for consistency but not rebuilt; all tiles of the saved mesh have to be
+/// restored with their original references before the mesh is queried.
+dtStatus dtNavMesh::restoreTile(unsigned char* data, int dataSize, int flags,
+								dtTileRef tileRef, unsigned int linksFreeList)
+{
+	if (!data || !tileRef || dataSize < (int)sizeof(dtMeshHeader))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	if (header->magic != DT_NAVMESH_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (header->version != DT_NAVMESH_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (header->maxLinkCount <= 0 || dataSize < getTileDataSize(header))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// Validate the stored links before the tile becomes visible.
+	const unsigned char* d = data + dtAlign4(sizeof(dtMeshHeader)) + dtAlign4(sizeof(float)*3*header->vertCount);
+	const dtPoly* polys = (const dtPoly*)d;
+	const dtLink* links = (const dtLink*)(d + dtAlign4(sizeof(dtPoly)*header->polyCount));
+
+	const unsigned int maxLinks = (unsigned int)header->maxLinkCount;
+	if (linksFreeList != DT_NULL_LINK && linksFreeList >= maxLinks)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < header->polyCount; ++i)
+	{
+		unsigned int steps = 0;
+		for (unsigned int j = polys[i].firstLink; j != DT_NULL_LINK; j = links[j].next)
+		{
+			if (j >= maxLinks || ++steps > maxLinks)
+				return DT_FAILURE | DT_INVALID_PARAM;
+			const dtPolyRef ref = links[j].ref;
+			if (ref && decodePolyIdTile(ref) >= (unsigned int)m_maxTiles)
+				return DT_FAILURE | DT_INVALID_PARAM;
+		}
+	}
+
+	dtMeshTile* tile = 0;
+	dtStatus status = allocTile(header, tileRef, &tile);
+	if (dtStatusFailed(status))
+		return status;
+
+	attachTileData(tile, data, dataSize, flags);
+	insertTileLookup(tile);
+	tile->linksFreeList = linksFreeList;
+	buildTileWideBVTree(tile);
+
+	return DT_SUCCESS;
+}
+
 const dtMeshTile* dtNavMesh::getTileAt(const int x, const int y, const int layer) const
 {
-	// Find tile based on hash.
-	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
+	// Find tile based on hash or grid.
+	dtMeshTile* const* head = getTileLookup(x, y);
+	dtMeshTile* tile = head ? *head : 0;
 	while (tile)
 	{
 		if (tile->header &&
@@ -1095,9 +1545,9 @@ int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile** tiles, const in
 {
 	int n = 0;
 	
-	// Find tile based on hash.
-	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
+	// Find tile based on hash or grid.
+	dtMeshTile* const* head = getTileLookup(x, y);
+	dtMeshTile* tile = head ? *head : 0;
 	while (tile)
 	{
 		if (tile->header &&
@@ -1121,9 +1571,9 @@ int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile const** tiles, co
 {
 	int n = 0;
 	
-	// Find tile based on hash.
-	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
+	// Find tile based on hash or grid.
+	dtMeshTile* const* head = getTileLookup(x, y);
+	dtMeshTile* tile = head ? *head : 0;
 	while (tile)
 	{
 		if (tile->header &&
@@ -1142,9 +1592,9 @@ int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile const** tiles, co
 
 dtTileRef dtNavMesh::getTileRefAt(const int x, const int y, const int layer) const
 {
-	// Find tile based on hash.
-	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
+	// Find tile based on hash or grid.
+	dtMeshTile* const* head = getTileLookup(x, y);
+	dtMeshTile* tile = head ? *head : 0;
 	while (tile)
 	{
 		if (tile->header &&
@@ -1249,10 +1699,10 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	if (tile->salt != tileSalt)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
-	// Remove tile from hash lookup.
-	int h = computeTileHash(tile->header->x,tile->header->y,m_tileLutMask);
+	// Remove tile from position lookup.
+	dtMeshTile** head = getTileLookup(tile->header->x, tile->header->y);
 	dtMeshTile* prev = 0;
-	dtMeshTile* cur = m_posLookup[h];
+	dtMeshTile* cur = *head;
 	while (cur)
 	{
 		if (cur == tile)
@@ -1260,7 +1710,7 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 			if (prev)
 				prev->next = cur->next;
 			else
-				m_posLookup[h] = cur->next;
+				*head = cur->next;
 			break;
 		}
 		prev = cur;
@@ -1315,6 +1765,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	tile->detailTris = 0;
 	tile->bvTree = 0;
 	tile->offMeshCons = 0;
+	dtFree(tile->bvWideTree);
+	tile->bvWideTree = 0;
 
 	// Update salt, salt should never be zero.
 #ifdef DT_POLYREF64
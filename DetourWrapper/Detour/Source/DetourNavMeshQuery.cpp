@@ -21,6 +21,8 @@
 #include "DetourNavMeshQuery.h"
 #include "DetourNavMesh.h"
 #include "DetourNode.h"
+#include "DetourTileGraph.h"
+#include "DetourPolyAdjacency.h"
 #include "DetourCommon.h"
 #include "DetourMath.h"
 #include "DetourAlloc.h"
@@ -62,46 +64,32 @@
 
 dtQueryFilter::dtQueryFilter() :
 	m_includeFlags(0xffff),
-	m_excludeFlags(0)
+	m_excludeFlags(0),
+	m_overlay(0)
 {
 	for (int i = 0; i < DT_MAX_AREAS; ++i)
 		m_areaCost[i] = 1.0f;
 }
 
 #ifdef DT_VIRTUAL_QUERYFILTER
-bool dtQueryFilter::passFilter(const dtPolyRef /*ref*/,
+bool dtQueryFilter::passFilter(const dtPolyRef ref,
 							   const dtMeshTile* /*tile*/,
 							   const dtPoly* poly) const
 {
-	return (poly->flags & m_includeFlags) != 0 && (poly->flags & m_excludeFlags) == 0;
+	const unsigned short flags = m_overlay ? m_overlay->getFlags(ref, poly) : poly->flags;
+	return (flags & m_includeFlags) != 0 && (flags & m_excludeFlags) == 0;
 }
 
 float dtQueryFilter::getCost(const float* pa, const float* pb,
 							 const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
-							 const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
+							 const dtPolyRef curRef, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
 							 const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
 {
-	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
-}
-#else
-inline bool dtQueryFilter::passFilter(const dtPolyRef /*ref*/,
-									  const dtMeshTile* /*tile*/,
-									  const dtPoly* poly) const
-{
-	return (poly->flags & m_includeFlags) != 0 && (poly->flags & m_excludeFlags) == 0;
-}
-
-inline float dtQueryFilter::getCost(const float* pa, const float* pb,
-									const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
-									const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
-									const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
-{
-	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
+	const unsigned char area = m_overlay ? m_overlay->getArea(curRef, curPoly) : curPoly->getArea();
+	return dtVdist(pa, pb) * m_areaCost[area];
 }
 #endif	
 	
-static const float H_SCALE = 0.999f; // Search heuristic scale.
-
 
 dtNavMeshQuery* dtAllocNavMeshQuery()
 {
@@ -144,7 +132,12 @@ dtNavMeshQuery::dtNavMeshQuery() :
 	m_nav(0),
 	m_tinyNodePool(0),
 	m_nodePool(0),
-	m_openList(0)
+	m_openList(0),
+	m_reverseNodePool(0),
+	m_reverseOpenList(0),
+	m_quaternaryOpenList(0),
+	m_openListType(DT_OPEN_LIST_BINARY_HEAP),
+	m_adjacency(0)
 {
 	memset(&m_query, 0, sizeof(dtQueryData));
 }
@@ -157,9 +150,18 @@ dtNavMeshQuery::~dtNavMeshQuery()
 		m_nodePool->~dtNodePool();
 	if (m_openList)
 		m_openList->~dtNodeQueue();
+	if (m_reverseNodePool)
+		m_reverseNodePool->~dtNodePool();
+	if (m_reverseOpenList)
+		m_reverseOpenList->~dtNodeQueue();
+	if (m_quaternaryOpenList)
+		m_quaternaryOpenList->~dtQuaternaryNodeQueue();
 	dtFree(m_tinyNodePool);
 	dtFree(m_nodePool);
 	dtFree(m_openList);
+	dtFree(m_reverseNodePool);
+	dtFree(m_reverseOpenList);
+	dtFree(m_quaternaryOpenList);
 }
 
 /// @par 
@@ -170,10 +172,11 @@ dtNavMeshQuery::~dtNavMeshQuery()
 /// This function can be used multiple times.
 dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 {
-	if (maxNodes > DT_NULL_IDX || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
+	if (maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
 	m_nav = nav;
+	m_adjacency = 0;
 	
 	if (!m_nodePool || m_nodePool->getMaxNodes() < maxNodes)
 	{
@@ -183,7 +186,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 			dtFree(m_nodePool);
 			m_nodePool = 0;
 		}
-		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, (int)dtNextPow2(dtMin(maxNodes, DT_NODE_PAGE_SIZE)*2));
 		if (!m_nodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -194,7 +197,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 	
 	if (!m_tinyNodePool)
 	{
-		m_tinyNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(64, 32);
+		m_tinyNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(64, 128);
 		if (!m_tinyNodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -220,6 +223,84 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 		m_openList->clear();
 	}
 	
+	if (m_quaternaryOpenList && m_quaternaryOpenList->getCapacity() < maxNodes)
+	{
+		m_quaternaryOpenList->~dtQuaternaryNodeQueue();
+		dtFree(m_quaternaryOpenList);
+		m_quaternaryOpenList = new (dtAlloc(sizeof(dtQuaternaryNodeQueue), DT_ALLOC_PERM)) dtQuaternaryNodeQueue(maxNodes);
+		if (!m_quaternaryOpenList)
+		{
+			m_openListType = DT_OPEN_LIST_BINARY_HEAP;
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+	}
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshQuery::initBidirectional(const int maxNodes)
+{
+	if (maxNodes <= 0 || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	if (!m_reverseNodePool || m_reverseNodePool->getMaxNodes() < maxNodes)
+	{
+		if (m_reverseNodePool)
+		{
+			m_reverseNodePool->~dtNodePool();
+			dtFree(m_reverseNodePool);
+			m_reverseNodePool = 0;
+		}
+		m_reverseNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, (int)dtNextPow2(dtMin(maxNodes, DT_NODE_PAGE_SIZE)*2));
+		if (!m_reverseNodePool)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	if (!m_reverseOpenList || m_reverseOpenList->getCapacity() < maxNodes)
+	{
+		if (m_reverseOpenList)
+		{
+			m_reverseOpenList->~dtNodeQueue();
+			dtFree(m_reverseOpenList);
+			m_reverseOpenList = 0;
+		}
+		m_reverseOpenList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes);
+		if (!m_reverseOpenList)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshQuery::setOpenListType(const dtOpenListType type)
+{
+	if (!m_nodePool)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	if (type == DT_OPEN_LIST_QUATERNARY_HEAP)
+	{
+		if (!m_quaternaryOpenList)
+		{
+			m_quaternaryOpenList = new (dtAlloc(sizeof(dtQuaternaryNodeQueue), DT_ALLOC_PERM)) dtQuaternaryNodeQueue(m_nodePool->getMaxNodes());
+			if (!m_quaternaryOpenList)
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+	}
+	else if (type != DT_OPEN_LIST_BINARY_HEAP)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	m_openListType = type;
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshQuery::setPolyAdjacency(const dtPolyAdjacency* adjacency)
+{
+	if (adjacency && adjacency->getNavMesh() != m_nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_adjacency = adjacency;
 	return DT_SUCCESS;
 }
 
@@ -620,70 +701,6 @@ dtStatus dtNavMeshQuery::getPolyHeight(dtPolyRef ref, const float* pos, float* h
 		: DT_FAILURE | DT_INVALID_PARAM;
 }
 
-class dtFindNearestPolyQuery : public dtPolyQuery
-{
-	const dtNavMeshQuery* m_query;
-	const float* m_center;
-	float m_nearestDistanceSqr;
-	dtPolyRef m_nearestRef;
-	float m_nearestPoint[3];
-	bool m_overPoly;
-
-public:
-	dtFindNearestPolyQuery(const dtNavMeshQuery* query, const float* center)
-		: m_query(query), m_center(center), m_nearestDistanceSqr(FLT_MAX), m_nearestRef(0), m_nearestPoint(), m_overPoly(false)
-	{
-	}
-
-	virtual ~dtFindNearestPolyQuery();
-
-	dtPolyRef nearestRef() const { return m_nearestRef; }
-	const float* nearestPoint() const { return m_nearestPoint; }
-	bool isOverPoly() const { return m_overPoly; }
-
-	void process(const dtMeshTile* tile, dtPoly** polys, dtPolyRef* refs, int count)
-	{
-		dtIgnoreUnused(polys);
-
-		for (int i = 0; i < count; ++i)
-		{
-			dtPolyRef ref = refs[i];
-			float closestPtPoly[3];
-			float diff[3];
-			bool posOverPoly = false;
-			float d;
-			m_query->closestPointOnPoly(ref, m_center, closestPtPoly, &posOverPoly);
-
-			// If a point is directly over a polygon and closer than
-			// climb height, favor that instead of straight line nearest point.
-			dtVsub(diff, m_center, closestPtPoly);
-			if (posOverPoly)
-			{
-				d = dtAbs(diff[1]) - tile->header->walkableClimb;
-				d = d > 0 ? d*d : 0;			
-			}
-			else
-			{
-				d = dtVlenSqr(diff);
-			}
-			
-			if (d < m_nearestDistanceSqr)
-			{
-				dtVcopy(m_nearestPoint, closestPtPoly);
-
-				m_nearestDistanceSqr = d;
-				m_nearestRef = ref;
-				m_overPoly = posOverPoly;
-			}
-		}
-	}
-};
-
-dtFindNearestPolyQuery::~dtFindNearestPolyQuery()
-{
-	// Defined out of line to fix the weak v-tables warning
-}
-
 /// @par 
 ///
 /// @note If the search box does not intersect any polygons the search will 
@@ -703,147 +720,7 @@ dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfE
 										 const dtQueryFilter* filter,
 										 dtPolyRef* nearestRef, float* nearestPt, bool* isOverPoly) const
 {
-	dtAssert(m_nav);
-
-	if (!nearestRef)
-		return DT_FAILURE | DT_INVALID_PARAM;
-
-	// queryPolygons below will check rest of params
-	
-	dtFindNearestPolyQuery query(this, center);
-
-	dtStatus status = queryPolygons(center, halfExtents, filter, &query);
-	if (dtStatusFailed(status))
-		return status;
-
-	*nearestRef = query.nearestRef();
-	// Only override nearestPt if we actually found a poly so the nearest point
-	// is valid.
-	if (nearestPt && *nearestRef)
-	{
-		dtVcopy(nearestPt, query.nearestPoint());
-		if (isOverPoly)
-			*isOverPoly = query.isOverPoly();
-	}
-	
-	return DT_SUCCESS;
-}
-
-void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
-										 const dtQueryFilter* filter, dtPolyQuery* query) const
-{
-	dtAssert(m_nav);
-	static const int batchSize = 32;
-	dtPolyRef polyRefs[batchSize];
-	dtPoly* polys[batchSize];
-	int n = 0;
-
-	if (tile->bvTree)
-	{
-		const dtBVNode* node = &tile->bvTree[0];
-		const dtBVNode* end = &tile->bvTree[tile->header->bvNodeCount];
-		const float* tbmin = tile->header->bmin;
-		const float* tbmax = tile->header->bmax;
-		const float qfac = tile->header->bvQuantFactor;
-
-		// Calculate quantized box
-		unsigned short bmin[3], bmax[3];
-		// dtClamp query box to world box.
-		float minx = dtClamp(qmin[0], tbmin[0], tbmax[0]) - tbmin[0];
-		float miny = dtClamp(qmin[1], tbmin[1], tbmax[1]) - tbmin[1];
-		float minz = dtClamp(qmin[2], tbmin[2], tbmax[2]) - tbmin[2];
-		float maxx = dtClamp(qmax[0], tbmin[0], tbmax[0]) - tbmin[0];
-		float maxy = dtClamp(qmax[1], tbmin[1], tbmax[1]) - tbmin[1];
-		float maxz = dtClamp(qmax[2], tbmin[2], tbmax[2]) - tbmin[2];
-		// Quantize
-		bmin[0] = (unsigned short)(qfac * minx) & 0xfffe;
-		bmin[1] = (unsigned short)(qfac * miny) & 0xfffe;
-		bmin[2] = (unsigned short)(qfac * minz) & 0xfffe;
-		bmax[0] = (unsigned short)(qfac * maxx + 1) | 1;
-		bmax[1] = (unsigned short)(qfac * maxy + 1) | 1;
-		bmax[2] = (unsigned short)(qfac * maxz + 1) | 1;
-
-		// Traverse tree
-		const dtPolyRef base = m_nav->getPolyRefBase(tile);
-		while (node < end)
-		{
-			const bool overlap = dtOverlapQuantBounds(bmin, bmax, node->bmin, node->bmax);
-			const bool isLeafNode = node->i >= 0;
-
-			if (isLeafNode && overlap)
-			{
-				dtPolyRef ref = base | (dtPolyRef)node->i;
-				if (filter->passFilter(ref, tile, &tile->polys[node->i]))
-				{
-					polyRefs[n] = ref;
-					polys[n] = &tile->polys[node->i];
-
-					if (n == batchSize - 1)
-					{
-						query->process(tile, polys, polyRefs, batchSize);
-						n = 0;
-					}
-					else
-					{
-						n++;
-					}
-				}
-			}
-
-			if (overlap || isLeafNode)
-				node++;
-			else
-			{
-				const int escapeIndex = -node->i;
-				node += escapeIndex;
-			}
-		}
-	}
-	else
-	{
-		float bmin[3], bmax[3];
-		const dtPolyRef base = m_nav->getPolyRefBase(tile);
-		for (int i = 0; i < tile->header->polyCount; ++i)
-		{
-			dtPoly* p = &tile->polys[i];
-			// Do not return off-mesh connection polygons.
-			if (p->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
-				continue;
-			// Must pass filter
-			const dtPolyRef ref = base | (dtPolyRef)i;
-			if (!filter->passFilter(ref, tile, p))
-				continue;
-			// Calc polygon bounds.
-			const float* v = &tile->verts[p->verts[0]*3];
-			dtVcopy(bmin, v);
-			dtVcopy(bmax, v);
-			for (int j = 1; j < p->vertCount; ++j)
-			{
-				v = &tile->verts[p->verts[j]*3];
-				dtVmin(bmin, v);
-				dtVmax(bmax, v);
-			}
-			if (dtOverlapBounds(qmin, qmax, bmin, bmax))
-			{
-				polyRefs[n] = ref;
-				polys[n] = p;
-
-				if (n == batchSize - 1)
-				{
-					query->process(tile, polys, polyRefs, batchSize);
-					n = 0;
-				}
-				else
-				{
-					n++;
-				}
-			}
-		}
-	}
-
-	// Process the last polygons that didn't make a full batch.
-	if (n > 0)
-		query->process(tile, polys, polyRefs, n);
+	return findNearestPoly<dtQueryFilter>(center, halfExtents, filter, nearestRef, nearestPt, isOverPoly);
 }
 
 class dtCollectPolysQuery : public dtPolyQuery
@@ -923,40 +800,7 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExtents,
 									   const dtQueryFilter* filter, dtPolyQuery* query) const
 {
-	dtAssert(m_nav);
-
-	if (!center || !dtVisfinite(center) ||
-		!halfExtents || !dtVisfinite(halfExtents) ||
-		!filter || !query)
-	{
-		return DT_FAILURE | DT_INVALID_PARAM;
-	}
-
-	float bmin[3], bmax[3];
-	dtVsub(bmin, center, halfExtents);
-	dtVadd(bmax, center, halfExtents);
-	
-	// Find tiles the query touches.
-	int minx, miny, maxx, maxy;
-	m_nav->calcTileLoc(bmin, &minx, &miny);
-	m_nav->calcTileLoc(bmax, &maxx, &maxy);
-
-	static const int MAX_NEIS = 32;
-	const dtMeshTile* neis[MAX_NEIS];
-	
-	for (int y = miny; y <= maxy; ++y)
-	{
-		for (int x = minx; x <= maxx; ++x)
-		{
-			const int nneis = m_nav->getTilesAt(x,y,neis,MAX_NEIS);
-			for (int j = 0; j < nneis; ++j)
-			{
-				queryPolygonsInTile(neis[j], bmin, bmax, filter, query);
-			}
-		}
-	}
-	
-	return DT_SUCCESS;
+	return queryPolygons<dtQueryFilter, dtPolyQuery>(center, halfExtents, filter, query);
 }
 
 /// @par
@@ -975,193 +819,23 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 								  const dtQueryFilter* filter,
 								  dtPolyRef* path, int* pathCount, const int maxPath) const
 {
-	dtAssert(m_nav);
-	dtAssert(m_nodePool);
-	dtAssert(m_openList);
-
-	if (!pathCount)
-		return DT_FAILURE | DT_INVALID_PARAM;
-
-	*pathCount = 0;
-	
-	// Validate input
-	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
-		!startPos || !dtVisfinite(startPos) ||
-		!endPos || !dtVisfinite(endPos) ||
-		!filter || !path || maxPath <= 0)
-	{
-		return DT_FAILURE | DT_INVALID_PARAM;
-	}
-
-	if (startRef == endRef)
-	{
-		path[0] = startRef;
-		*pathCount = 1;
-		return DT_SUCCESS;
-	}
-	
-	m_nodePool->clear();
-	m_openList->clear();
-	
-	dtNode* startNode = m_nodePool->getNode(startRef);
-	dtVcopy(startNode->pos, startPos);
-	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_OPEN;
-	m_openList->push(startNode);
-	
-	dtNode* lastBestNode = startNode;
-	float lastBestNodeCost = startNode->total;
-	
-	bool outOfNodes = false;
-	
-	while (!m_openList->empty())
-	{
-		// Remove node from open list and put it in closed list.
-		dtNode* bestNode = m_openList->pop();
-		bestNode->flags &= ~DT_NODE_OPEN;
-		bestNode->flags |= DT_NODE_CLOSED;
-		
-		// Reached the goal, stop searching.
-		if (bestNode->id == endRef)
-		{
-			lastBestNode = bestNode;
-			break;
-		}
-		
-		// Get current poly and tile.
-		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef bestRef = bestNode->id;
-		const dtMeshTile* bestTile = 0;
-		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
-		
-		// Get parent poly and tile.
-		dtPolyRef parentRef = 0;
-		const dtMeshTile* parentTile = 0;
-		const dtPoly* parentPoly = 0;
-		if (bestNode->pidx)
-			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
-		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
-		
-		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
-		{
-			dtPolyRef neighbourRef = bestTile->links[i].ref;
-			
-			// Skip invalid ids and do not expand back to where we came from.
-			if (!neighbourRef || neighbourRef == parentRef)
-				continue;
-			
-			// Get neighbour poly and tile.
-			// The API input has been cheked already, skip checking internal data.
-			const dtMeshTile* neighbourTile = 0;
-			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);			
-			
-			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
-				continue;
-
-			// deal explicitly with crossing tile boundaries
-			unsigned char crossSide = 0;
-			if (bestTile->links[i].side != 0xff)
-				crossSide = bestTile->links[i].side >> 1;
-
-			// get the node
-			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
-			if (!neighbourNode)
-			{
-				outOfNodes = true;
-				continue;
-			}
-			
-			// If the node is visited the first time, calculate node position.
-			if (neighbourNode->flags == 0)
-			{
-				getEdgeMidPoint(bestRef, bestPoly, bestTile,
-								neighbourRef, neighbourPoly, neighbourTile,
-								neighbourNode->pos);
-			}
-
-			// Calculate cost and heuristic.
-			float cost = 0;
-			float heuristic = 0;
-			
-			// Special case for last node.
-			if (neighbourRef == endRef)
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				const float endCost = filter->getCost(neighbourNode->pos, endPos,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly,
-													  0, 0, 0);
-				
-				cost = bestNode->cost + curCost + endCost;
-				heuristic = 0;
-			}
-			else
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				cost = bestNode->cost + curCost;
-				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
-			}
-
-			const float total = cost + heuristic;
-			
-			// The node is already in open list and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
-				continue;
-			// The node is already visited and process, and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
-				continue;
-			
-			// Add or update the node.
-			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
-			neighbourNode->id = neighbourRef;
-			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
-			neighbourNode->cost = cost;
-			neighbourNode->total = total;
-			
-			if (neighbourNode->flags & DT_NODE_OPEN)
-			{
-				// Already in open, update node location.
-				m_openList->modify(neighbourNode);
-			}
-			else
-			{
-				// Put the node in open list.
-				neighbourNode->flags |= DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
-			}
-			
-			// Update nearest node to target so far.
-			if (heuristic < lastBestNodeCost)
-			{
-				lastBestNodeCost = heuristic;
-				lastBestNode = neighbourNode;
-			}
-		}
-	}
-
-	dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
+	return findPath<dtQueryFilter>(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+}
 
-	if (lastBestNode->id != endRef)
-		status |= DT_PARTIAL_RESULT;
+dtStatus dtNavMeshQuery::findPathHierarchical(const dtTileGraph* graph, dtPolyRef startRef, dtPolyRef endRef,
+											  const float* startPos, const float* endPos,
+											  const dtQueryFilter* filter,
+											  dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	return findPathHierarchical<dtQueryFilter>(graph, startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+}
 
-	if (outOfNodes)
-		status |= DT_OUT_OF_NODES;
-	
-	return status;
+dtStatus dtNavMeshQuery::findPathBidirectional(dtPolyRef startRef, dtPolyRef endRef,
+											   const float* startPos, const float* endPos,
+											   const dtQueryFilter* filter,
+											   dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	return findPathBidirectional<dtQueryFilter>(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
 }
 
 dtStatus dtNavMeshQuery::getPathToNode(dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const
@@ -1265,7 +939,7 @@ dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef
 	dtVcopy(startNode->pos, startPos);
 	startNode->pidx = 0;
 	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
+	startNode->total = dtVdist(startPos, endPos) * DT_H_SCALE;
 	startNode->id = startRef;
 	startNode->flags = DT_NODE_OPEN;
 	m_openList->push(startNode);
@@ -1377,8 +1051,14 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			if (!m_query.filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
 				continue;
 			
+			// Without any-angle shortcuts, deal with tile boundary crossings
+			// the same way findPath() does so both searches return the same corridor.
+			unsigned char crossSide = 0;
+			if (!(m_query.options & DT_FINDPATH_ANY_ANGLE) && bestTile->links[i].side != 0xff)
+				crossSide = bestTile->links[i].side >> 1;
+
 			// get the neighbor node
-			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, 0);
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
 			if (!neighbourNode)
 			{
 				m_query.status |= DT_OUT_OF_NODES;
@@ -1439,7 +1119,7 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			}
 			else
 			{
-				heuristic = dtVdist(neighbourNode->pos, m_query.endPos)*H_SCALE;
+				heuristic = dtVdist(neighbourNode->pos, m_query.endPos)*DT_H_SCALE;
 			}
 			
 			const float total = cost + heuristic;
@@ -2467,225 +2147,7 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 								 const dtQueryFilter* filter, const unsigned int options,
 								 dtRaycastHit* hit, dtPolyRef prevRef) const
 {
-	dtAssert(m_nav);
-
-	if (!hit)
-		return DT_FAILURE | DT_INVALID_PARAM;
-
-	hit->t = 0;
-	hit->pathCount = 0;
-	hit->pathCost = 0;
-
-	// Validate input
-	if (!m_nav->isValidPolyRef(startRef) ||
-		!startPos || !dtVisfinite(startPos) ||
-		!endPos || !dtVisfinite(endPos) ||
-		!filter ||
-		(prevRef && !m_nav->isValidPolyRef(prevRef)))
-	{
-		return DT_FAILURE | DT_INVALID_PARAM;
-	}
-	
-	float dir[3], curPos[3], lastPos[3];
-	float verts[DT_VERTS_PER_POLYGON*3+3];	
-	int n = 0;
-
-	dtVcopy(curPos, startPos);
-	dtVsub(dir, endPos, startPos);
-	dtVset(hit->hitNormal, 0, 0, 0);
-
-	dtStatus status = DT_SUCCESS;
-
-	const dtMeshTile* prevTile, *tile, *nextTile;
-	const dtPoly* prevPoly, *poly, *nextPoly;
-	dtPolyRef curRef;
-
-	// The API input has been checked already, skip checking internal data.
-	curRef = startRef;
-	tile = 0;
-	poly = 0;
-	m_nav->getTileAndPolyByRefUnsafe(curRef, &tile, &poly);
-	nextTile = prevTile = tile;
-	nextPoly = prevPoly = poly;
-	if (prevRef)
-		m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly);
-
-	while (curRef)
-	{
-		// Cast ray against current polygon.
-		
-		// Collect vertices.
-		int nv = 0;
-		for (int i = 0; i < (int)poly->vertCount; ++i)
-		{
-			dtVcopy(&verts[nv*3], &tile->verts[poly->verts[i]*3]);
-			nv++;
-		}
-		
-		float tmin, tmax;
-		int segMin, segMax;
-		if (!dtIntersectSegmentPoly2D(startPos, endPos, verts, nv, tmin, tmax, segMin, segMax))
-		{
-			// Could not hit the polygon, keep the old t and report hit.
-			hit->pathCount = n;
-			return status;
-		}
-
-		hit->hitEdgeIndex = segMax;
-
-		// Keep track of furthest t so far.
-		if (tmax > hit->t)
-			hit->t = tmax;
-		
-		// Store visited polygons.
-		if (n < hit->maxPath)
-			hit->path[n++] = curRef;
-		else
-			status |= DT_BUFFER_TOO_SMALL;
-
-		// Ray end is completely inside the polygon.
-		if (segMax == -1)
-		{
-			hit->t = FLT_MAX;
-			hit->pathCount = n;
-			
-			// add the cost
-			if (options & DT_RAYCAST_USE_COSTS)
-				hit->pathCost += filter->getCost(curPos, endPos, prevRef, prevTile, prevPoly, curRef, tile, poly, curRef, tile, poly);
-			return status;
-		}
-
-		// Follow neighbours.
-		dtPolyRef nextRef = 0;
-		
-		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
-		{
-			const dtLink* link = &tile->links[i];
-			
-			// Find link which contains this edge.
-			if ((int)link->edge != segMax)
-				continue;
-			
-			// Get pointer to the next polygon.
-			nextTile = 0;
-			nextPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
-			
-			// Skip off-mesh connections.
-			if (nextPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
-				continue;
-			
-			// Skip links based on filter.
-			if (!filter->passFilter(link->ref, nextTile, nextPoly))
-				continue;
-			
-			// If the link is internal, just return the ref.
-			if (link->side == 0xff)
-			{
-				nextRef = link->ref;
-				break;
-			}
-			
-			// If the link is at tile boundary,
-			
-			// Check if the link spans the whole edge, and accept.
-			if (link->bmin == 0 && link->bmax == 255)
-			{
-				nextRef = link->ref;
-				break;
-			}
-			
-			// Check for partial edge links.
-			const int v0 = poly->verts[link->edge];
-			const int v1 = poly->verts[(link->edge+1) % poly->vertCount];
-			const float* left = &tile->verts[v0*3];
-			const float* right = &tile->verts[v1*3];
-			
-			// Check that the intersection lies inside the link portal.
-			if (link->side == 0 || link->side == 4)
-			{
-				// Calculate link size.
-				const float s = 1.0f/255.0f;
-				float lmin = left[2] + (right[2] - left[2])*(link->bmin*s);
-				float lmax = left[2] + (right[2] - left[2])*(link->bmax*s);
-				if (lmin > lmax) dtSwap(lmin, lmax);
-				
-				// Find Z intersection.
-				float z = startPos[2] + (endPos[2]-startPos[2])*tmax;
-				if (z >= lmin && z <= lmax)
-				{
-					nextRef = link->ref;
-					break;
-				}
-			}
-			else if (link->side == 2 || link->side == 6)
-			{
-				// Calculate link size.
-				const float s = 1.0f/255.0f;
-				float lmin = left[0] + (right[0] - left[0])*(link->bmin*s);
-				float lmax = left[0] + (right[0] - left[0])*(link->bmax*s);
-				if (lmin > lmax) dtSwap(lmin, lmax);
-				
-				// Find X intersection.
-				float x = startPos[0] + (endPos[0]-startPos[0])*tmax;
-				if (x >= lmin && x <= lmax)
-				{
-					nextRef = link->ref;
-					break;
-				}
-			}
-		}
-		
-		// add the cost
-		if (options & DT_RAYCAST_USE_COSTS)
-		{
-			// compute the intersection point at the furthest end of the polygon
-			// and correct the height (since the raycast moves in 2d)
-			dtVcopy(lastPos, curPos);
-			dtVmad(curPos, startPos, dir, hit->t);
-			float* e1 = &verts[segMax*3];
-			float* e2 = &verts[((segMax+1)%nv)*3];
-			float eDir[3], diff[3];
-			dtVsub(eDir, e2, e1);
-			dtVsub(diff, curPos, e1);
-			float s = dtSqr(eDir[0]) > dtSqr(eDir[2]) ? diff[0] / eDir[0] : diff[2] / eDir[2];
-			curPos[1] = e1[1] + eDir[1] * s;
-
-			hit->pathCost += filter->getCost(lastPos, curPos, prevRef, prevTile, prevPoly, curRef, tile, poly, nextRef, nextTile, nextPoly);
-		}
-
-		if (!nextRef)
-		{
-			// No neighbour, we hit a wall.
-			
-			// Calculate hit normal.
-			const int a = segMax;
-			const int b = segMax+1 < nv ? segMax+1 : 0;
-			const float* va = &verts[a*3];
-			const float* vb = &verts[b*3];
-			const float dx = vb[0] - va[0];
-			const float dz = vb[2] - va[2];
-			hit->hitNormal[0] = dz;
-			hit->hitNormal[1] = 0;
-			hit->hitNormal[2] = -dx;
-			dtVnormalize(hit->hitNormal);
-			
-			hit->pathCount = n;
-			return status;
-		}
-
-		// No hit, advance to neighbour polygon.
-		prevRef = curRef;
-		curRef = nextRef;
-		prevTile = tile;
-		tile = nextTile;
-		prevPoly = poly;
-		poly = nextPoly;
-	}
-	
-	hit->pathCount = n;
-	
-	return status;
+	return raycast<dtQueryFilter>(startRef, startPos, endPos, filter, options, hit, prevRef);
 }
 
 /// @par
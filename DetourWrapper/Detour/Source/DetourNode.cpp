@@ -50,56 +50,91 @@ inline unsigned int dtHashRef(dtPolyRef a)
 //////////////////////////////////////////////////////////////////////////////////////////
 dtNodePool::dtNodePool(int maxNodes, int hashSize) :
 	m_nodes(0),
-	m_first(0),
-	m_next(0),
+	m_pages(0),
+	m_slots(0),
 	m_maxNodes(maxNodes),
+	m_firstPageNodes(dtMin(maxNodes, DT_NODE_PAGE_SIZE)),
+	m_maxPages(maxNodes > DT_NODE_PAGE_SIZE ? (maxNodes + DT_NODE_PAGE_SIZE - 1) / DT_NODE_PAGE_SIZE : 0),
+	m_pageCount(1),
 	m_hashSize(hashSize),
-	m_nodeCount(0)
+	m_nodeCount(0),
+	m_indexBits(maxNodes > DT_NODE_PAGE_SIZE ? DT_NODE_PARENT_BITS : DT_NODE_PAGE_BITS),
+	m_indexMask((1u << m_indexBits) - 1),
+	m_generation(1)
 {
 	dtAssert(dtNextPow2(m_hashSize) == (unsigned int)m_hashSize);
+	// Probing stops at the first slot of an older generation, so there must
+	// always be one left.
+	dtAssert(m_maxPages || m_hashSize > m_maxNodes);
 	// pidx is special as 0 means "none" and 1 is the first node. For that reason
 	// we have 1 fewer nodes available than the number of values it can contain.
-	dtAssert(m_maxNodes > 0 && m_maxNodes <= DT_NULL_IDX && m_maxNodes <= (1 << DT_NODE_PARENT_BITS) - 1);
+	dtAssert(m_maxNodes > 0 && m_maxNodes <= (1 << DT_NODE_PARENT_BITS) - 1);
 
-	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM);
-	m_next = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*m_maxNodes, DT_ALLOC_PERM);
-	m_first = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*hashSize, DT_ALLOC_PERM);
+	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_firstPageNodes, DT_ALLOC_PERM);
+	m_slots = (dtNodeSlot*)dtAlloc(sizeof(dtNodeSlot)*m_hashSize, DT_ALLOC_PERM);
 
 	dtAssert(m_nodes);
-	dtAssert(m_next);
-	dtAssert(m_first);
+	dtAssert(m_slots);
 
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
-	memset(m_next, 0xff, sizeof(dtNodeIndex)*m_maxNodes);
+	if (m_maxPages)
+	{
+		m_pages = (dtNode**)dtAlloc(sizeof(dtNode*)*m_maxPages, DT_ALLOC_PERM);
+		dtAssert(m_pages);
+		memset(m_pages, 0, sizeof(dtNode*)*m_maxPages);
+		m_pages[0] = m_nodes;
+	}
+
+	memset(m_slots, 0, sizeof(dtNodeSlot)*m_hashSize);
 }
 
 dtNodePool::~dtNodePool()
 {
+	for (int i = 1; i < m_pageCount; ++i)
+		dtFree(m_pages[i]);
+	dtFree(m_pages);
 	dtFree(m_nodes);
-	dtFree(m_next);
-	dtFree(m_first);
+	dtFree(m_slots);
 }
 
 void dtNodePool::clear()
 {
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+	// Slots of earlier generations read as empty. Generation 0 is never
+	// used, so the table only needs resetting when the counter wraps.
+	if (++m_generation >> (32 - m_indexBits))
+	{
+		memset(m_slots, 0, sizeof(dtNodeSlot)*m_hashSize);
+		m_generation = 1;
+	}
 	m_nodeCount = 0;
 }
 
+unsigned int dtNodePool::getPagedNodeIdx(const dtNode* node) const
+{
+	for (int i = 1; i < m_pageCount; ++i)
+	{
+		if (node >= m_pages[i] && node < m_pages[i] + DT_NODE_PAGE_SIZE)
+			return (unsigned int)(i * DT_NODE_PAGE_SIZE) + (unsigned int)(node - m_pages[i]) + 1;
+	}
+	dtAssert(!"Node is not in the pool");
+	return 0;
+}
+
 unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNodes)
 {
 	int n = 0;
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	while (i != DT_NULL_IDX)
+	const unsigned int mask = (unsigned int)m_hashSize - 1;
+	for (unsigned int slot = dtHashRef(id) & mask; ; slot = (slot + 1) & mask)
 	{
-		if (m_nodes[i].id == id)
+		const dtNodeSlot entry = m_slots[slot];
+		if ((entry >> m_indexBits) != m_generation)
+			break;
+		dtNode* node = getSlotNode(entry);
+		if (node->id == id)
 		{
 			if (n >= maxNodes)
 				return n;
-			nodes[n++] = &m_nodes[i];
+			nodes[n++] = node;
 		}
-		i = m_next[i];
 	}
 
 	return n;
@@ -107,37 +142,107 @@ unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNo
 
 dtNode* dtNodePool::findNode(dtPolyRef id, unsigned char state)
 {
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	while (i != DT_NULL_IDX)
+	const unsigned int mask = (unsigned int)m_hashSize - 1;
+	for (unsigned int slot = dtHashRef(id) & mask; ; slot = (slot + 1) & mask)
 	{
-		if (m_nodes[i].id == id && m_nodes[i].state == state)
-			return &m_nodes[i];
-		i = m_next[i];
+		const dtNodeSlot entry = m_slots[slot];
+		if ((entry >> m_indexBits) != m_generation)
+			return 0;
+		dtNode* node = getSlotNode(entry);
+		if (node->id == id && node->state == state)
+			return node;
 	}
-	return 0;
+}
+
+dtNode* dtNodePool::allocPagedNode()
+{
+	const int i = m_nodeCount;
+	if (i >= m_pageCount * DT_NODE_PAGE_SIZE)
+	{
+		// Pages stay allocated once a search has reached them.
+		dtNode* page = (dtNode*)dtAlloc(sizeof(dtNode)*DT_NODE_PAGE_SIZE, DT_ALLOC_PERM);
+		if (!page)
+			return 0;
+		m_pages[m_pageCount++] = page;
+	}
+
+	m_nodeCount++;
+	return &m_pages[i >> DT_NODE_PAGE_BITS][i & (DT_NODE_PAGE_SIZE - 1)];
+}
+
+bool dtNodePool::growHash()
+{
+	const int hashSize = m_hashSize * 2;
+	dtNodeSlot* slots = (dtNodeSlot*)dtAlloc(sizeof(dtNodeSlot)*hashSize, DT_ALLOC_PERM);
+	if (!slots)
+		return false;
+	memset(slots, 0, sizeof(dtNodeSlot)*hashSize);
+
+	const unsigned int mask = (unsigned int)hashSize - 1;
+	for (int i = 0; i < m_nodeCount; ++i)
+	{
+		unsigned int slot = dtHashRef(getNodeAtIdx((unsigned int)i + 1)->id) & mask;
+		while (slots[slot])
+			slot = (slot + 1) & mask;
+		slots[slot] = (m_generation << m_indexBits) | (unsigned int)i;
+	}
+
+	dtFree(m_slots);
+	m_slots = slots;
+	m_hashSize = hashSize;
+	return true;
 }
 
 dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 {
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	dtNode* node = 0;
-	while (i != DT_NULL_IDX)
+	unsigned int mask = (unsigned int)m_hashSize - 1;
+	unsigned int slot = dtHashRef(id) & mask;
+	for (;;)
 	{
-		if (m_nodes[i].id == id && m_nodes[i].state == state)
-			return &m_nodes[i];
-		i = m_next[i];
+		const dtNodeSlot entry = m_slots[slot];
+		if ((entry >> m_indexBits) != m_generation)
+			break;
+		dtNode* node = getSlotNode(entry);
+		if (node->id == id && node->state == state)
+			return node;
+		slot = (slot + 1) & mask;
 	}
 	
 	if (m_nodeCount >= m_maxNodes)
 		return 0;
 	
-	i = (dtNodeIndex)m_nodeCount;
-	m_nodeCount++;
+	// Pools that page keep the table at most half full. If it can not grow
+	// the search may carry on as long as a free slot is left.
+	if (m_maxPages && (m_nodeCount + 1) * 2 > m_hashSize)
+	{
+		if (growHash())
+		{
+			mask = (unsigned int)m_hashSize - 1;
+			slot = dtHashRef(id) & mask;
+			while ((m_slots[slot] >> m_indexBits) == m_generation)
+				slot = (slot + 1) & mask;
+		}
+		else if (m_nodeCount + 1 >= m_hashSize)
+		{
+			return 0;
+		}
+	}
+	
+	const unsigned int i = (unsigned int)m_nodeCount;
+	dtNode* node;
+	if (m_nodeCount < m_firstPageNodes)
+	{
+		node = &m_nodes[i];
+		m_nodeCount++;
+	}
+	else
+	{
+		node = allocPagedNode();
+		if (!node)
+			return 0;
+	}
 	
 	// Init node
-	node = &m_nodes[i];
 	node->pidx = 0;
 	node->cost = 0;
 	node->total = 0;
@@ -145,8 +250,7 @@ dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 	node->state = state;
 	node->flags = 0;
 	
-	m_next[i] = m_first[bucket];
-	m_first[bucket] = i;
+	m_slots[slot] = (m_generation << m_indexBits) | i;
 	
 	return node;
 }
@@ -198,3 +302,99 @@ void dtNodeQueue::trickleDown(int i, dtNode* node)
 	}
 	bubbleUp(i, node);
 }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+dtQuaternaryNodeQueue::dtQuaternaryNodeQueue(int n) :
+	m_data(0),
+	m_heap(0),
+	m_capacity(n),
+	m_maxEntries(n + n/2 + 1),
+	m_size(0)
+{
+	dtAssert(m_capacity > 0);
+	
+	// Room to align the children of the root to 64 bytes.
+	m_data = (dtNodeQueueEntry*)dtAlloc(sizeof(dtNodeQueueEntry)*(m_maxEntries + 11), DT_ALLOC_PERM);
+	dtAssert(m_data);
+	
+	const size_t line = 64;
+	const size_t first = ((size_t)&m_data[4] + line - 1) & ~(line - 1);
+	m_heap = (dtNodeQueueEntry*)first - 1;
+}
+
+dtQuaternaryNodeQueue::~dtQuaternaryNodeQueue()
+{
+	dtFree(m_data);
+}
+
+void dtQuaternaryNodeQueue::bubbleUp(int i, float total, dtNode* node)
+{
+	while (i > 0)
+	{
+		const int parent = (i-1)/4;
+		if (m_heap[parent].total <= total)
+			break;
+		m_heap[i] = m_heap[parent];
+		i = parent;
+	}
+	m_heap[i].total = total;
+	m_heap[i].node = node;
+}
+
+void dtQuaternaryNodeQueue::trickleDown(int i, dtNodeQueueEntry entry)
+{
+	// The entry comes from the bottom of the heap and usually goes back
+	// there, so follow the smallest children down to a leaf without
+	// comparing against it and bubble it up from there.
+	for (;;)
+	{
+		const int first = i*4 + 1;
+		int child;
+		if (first + 4 <= m_size)
+		{
+			// Pick the smallest of the four without branching on the keys.
+			const dtNodeQueueEntry* c = &m_heap[first];
+			const int a = (int)(c[1].total < c[0].total);
+			const int b = 2 + (int)(c[3].total < c[2].total);
+			const float ta = dtMin(c[0].total, c[1].total);
+			const float tb = dtMin(c[2].total, c[3].total);
+			child = first + a + (int)(tb < ta) * (b - a);
+		}
+		else if (first < m_size)
+		{
+			child = first;
+			for (int j = first + 1; j < m_size; ++j)
+			{
+				if (m_heap[j].total < m_heap[child].total)
+					child = j;
+			}
+		}
+		else
+		{
+			break;
+		}
+		m_heap[i] = m_heap[child];
+		i = child;
+	}
+	bubbleUp(i, entry.total, entry.node);
+}
+
+void dtQuaternaryNodeQueue::compact()
+{
+	// At most m_capacity nodes are open, so this frees room for at least
+	// half as many pushes again. The kept entries are pushed again in order;
+	// each one lands at or before the slot it is read from.
+	const int size = m_size;
+	m_size = 0;
+	for (int i = 0; i < size; ++i)
+	{
+		const dtNodeQueueEntry entry = m_heap[i];
+		if (!isStale(entry))
+		{
+			m_size++;
+			bubbleUp(m_size-1, entry.total, entry.node);
+		}
+	}
+	dtAssert(m_size < m_maxEntries);
+}
@@ -0,0 +1,301 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include <new>
+#include "DetourPolyAdjacency.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include "DetourCommon.h"
+
+/// @class dtPolyAdjacency
+///
+/// Each tile keeps one block: the header, the offset of the first link of
+/// every polygon, the links and their portal middles. The middles are only
+/// read when a search reaches a polygon for the first time, so they are
+/// kept out of the links it reads on every expansion. Portal middles are computed with the same
+/// operations as dtNavMeshQuery::getPortalPoints and getEdgeMidPoint, so a
+/// search over the adjacency places its nodes exactly where one over the
+/// mesh links does and returns the same paths.
+
+dtPolyAdjacency* dtAllocPolyAdjacency()
+{
+	void* mem = dtAlloc(sizeof(dtPolyAdjacency), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtPolyAdjacency;
+}
+
+void dtFreePolyAdjacency(dtPolyAdjacency* adjacency)
+{
+	if (!adjacency) return;
+	adjacency->~dtPolyAdjacency();
+	dtFree(adjacency);
+}
+
+// Middle of the portal from polygon from to polygon to, the way
+// dtNavMeshQuery::getEdgeMidPoint computes it. The portal is that of the
+// first link to the neighbour, as there.
+static void calcEdgeMid(dtPolyRef from, const dtPoly* fromPoly, const dtMeshTile* fromTile,
+						dtPolyRef to, const dtPoly* toPoly, const dtMeshTile* toTile, float* mid)
+{
+	const dtLink* link = 0;
+	for (unsigned int i = fromPoly->firstLink; i != DT_NULL_LINK; i = fromTile->links[i].next)
+	{
+		if (fromTile->links[i].ref == to)
+		{
+			link = &fromTile->links[i];
+			break;
+		}
+	}
+	dtAssert(link);
+
+	float left[3], right[3];
+	if (fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		dtVcopy(left, &fromTile->verts[fromPoly->verts[link->edge]*3]);
+		dtVcopy(right, left);
+	}
+	else if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		// getPortalPoints fails without a link back and the search keeps
+		// whatever position the node had, use the connection's start.
+		int v = 0;
+		for (unsigned int i = toPoly->firstLink; i != DT_NULL_LINK; i = toTile->links[i].next)
+		{
+			if (toTile->links[i].ref == from)
+			{
+				v = toTile->links[i].edge;
+				break;
+			}
+		}
+		dtVcopy(left, &toTile->verts[toPoly->verts[v]*3]);
+		dtVcopy(right, left);
+	}
+	else
+	{
+		const int v0 = fromPoly->verts[link->edge];
+		const int v1 = fromPoly->verts[(link->edge+1) % (int)fromPoly->vertCount];
+		dtVcopy(left, &fromTile->verts[v0*3]);
+		dtVcopy(right, &fromTile->verts[v1*3]);
+		if (link->side != 0xff && (link->bmin != 0 || link->bmax != 255))
+		{
+			const float s = 1.0f/255.0f;
+			const float tmin = link->bmin*s;
+			const float tmax = link->bmax*s;
+			dtVlerp(left, &fromTile->verts[v0*3], &fromTile->verts[v1*3], tmin);
+			dtVlerp(right, &fromTile->verts[v0*3], &fromTile->verts[v1*3], tmax);
+		}
+	}
+
+	mid[0] = (left[0]+right[0])*0.5f;
+	mid[1] = (left[1]+right[1])*0.5f;
+	mid[2] = (left[2]+right[2])*0.5f;
+}
+
+dtPolyAdjacency::dtPolyAdjacency() :
+	m_nav(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_linkCount(0)
+{
+}
+
+dtPolyAdjacency::~dtPolyAdjacency()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+		dtFree(m_tiles[i]);
+	dtFree(m_tiles);
+}
+
+dtStatus dtPolyAdjacency::init(const dtNavMesh* nav)
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+		dtFree(m_tiles[i]);
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_linkCount = 0;
+	m_nav = 0;
+
+	if (!nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const int maxTiles = nav->getMaxTiles();
+	m_tiles = (Tile**)dtAlloc(sizeof(Tile*) * maxTiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_tiles, 0, sizeof(Tile*) * maxTiles);
+
+	m_maxTiles = maxTiles;
+	m_nav = nav;
+
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		dtStatus status = buildTile(i);
+		if (dtStatusFailed(status))
+			return status;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyAdjacency::addTile(dtTileRef ref)
+{
+	if (!m_nav)
+		return DT_FAILURE;
+
+	const dtMeshTile* tile = m_nav->getTileByRef(ref);
+	if (!tile)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtStatus status = buildTile((int)m_nav->decodePolyIdTile((dtPolyRef)ref));
+	if (dtStatusFailed(status))
+		return status;
+
+	return rebuildNeighbours(tile->header->x, tile->header->y);
+}
+
+dtStatus dtPolyAdjacency::removeTile(dtTileRef ref)
+{
+	if (!m_nav)
+		return DT_FAILURE;
+
+	const int index = (int)m_nav->decodePolyIdTile((dtPolyRef)ref);
+	if (index >= m_maxTiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const Tile* tile = m_tiles[index];
+	if (!tile || tile->salt != m_nav->decodePolyIdSalt((dtPolyRef)ref))
+		return DT_SUCCESS;
+
+	const int x = tile->x;
+	const int y = tile->y;
+	freeTile(index);
+	return rebuildNeighbours(x, y);
+}
+
+void dtPolyAdjacency::freeTile(int index)
+{
+	Tile* tile = m_tiles[index];
+	if (!tile)
+		return;
+
+	m_linkCount -= tile->linkCount;
+	dtFree(tile);
+	m_tiles[index] = 0;
+}
+
+dtStatus dtPolyAdjacency::rebuildNeighbours(int x, int y)
+{
+	// Links only connect a tile to the eight around it.
+	static const int MAX_NEIS = 32;
+	const dtMeshTile* neis[MAX_NEIS];
+
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			if (!dx && !dy)
+				continue;
+			const int nneis = m_nav->getTilesAt(x + dx, y + dy, neis, MAX_NEIS);
+			for (int j = 0; j < nneis; ++j)
+			{
+				dtStatus status = buildTile((int)m_nav->decodePolyIdTile((dtPolyRef)m_nav->getTileRef(neis[j])));
+				if (dtStatusFailed(status))
+					return status;
+			}
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyAdjacency::buildTile(int index)
+{
+	freeTile(index);
+
+	const dtMeshTile* tile = m_nav->getTile(index);
+	if (!tile->header)
+		return DT_SUCCESS;
+
+	const int polyCount = tile->header->polyCount;
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+
+	int linkCount = 0;
+	for (int ip = 0; ip < polyCount; ++ip)
+	{
+		const dtPoly* poly = &tile->polys[ip];
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			if (tile->links[i].ref)
+				linkCount++;
+		}
+	}
+
+	// One block: header, link ranges, links, portal middles.
+	const int headerSize = ((int)sizeof(Tile) + 7) & ~7;
+	const int firstLinkSize = ((int)sizeof(int) * (polyCount + 1) + 7) & ~7;
+	const int linksSize = (int)sizeof(Link) * linkCount;
+	const int linkPosSize = (int)sizeof(float) * 3 * linkCount;
+
+	unsigned char* data = (unsigned char*)dtAlloc(headerSize + firstLinkSize + linksSize + linkPosSize, DT_ALLOC_PERM);
+	if (!data)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	Tile* adjacencyTile = (Tile*)data;
+	adjacencyTile->firstLink = (int*)(data + headerSize);
+	adjacencyTile->links = (Link*)(data + headerSize + firstLinkSize);
+	adjacencyTile->linkPos = (float*)(data + headerSize + firstLinkSize + linksSize);
+	adjacencyTile->salt = tile->salt;
+	adjacencyTile->x = tile->header->x;
+	adjacencyTile->y = tile->header->y;
+	adjacencyTile->polyCount = polyCount;
+	adjacencyTile->linkCount = linkCount;
+
+	int n = 0;
+	for (int ip = 0; ip < polyCount; ++ip)
+	{
+		adjacencyTile->firstLink[ip] = n;
+
+		const dtPolyRef ref = base | (dtPolyRef)ip;
+		const dtPoly* poly = &tile->polys[ip];
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtLink& meshLink = tile->links[i];
+			if (!meshLink.ref)
+				continue;
+
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(meshLink.ref, &neighbourTile, &neighbourPoly);
+
+			Link& link = adjacencyTile->links[n];
+			link.ref = meshLink.ref;
+			link.tile = neighbourTile;
+			link.poly = (unsigned short)m_nav->decodePolyIdPoly(meshLink.ref);
+			link.side = meshLink.side != 0xff ? (unsigned char)(meshLink.side >> 1) : 0;
+			calcEdgeMid(ref, poly, tile, meshLink.ref, neighbourPoly, neighbourTile, &adjacencyTile->linkPos[n * 3]);
+			n++;
+		}
+	}
+	adjacencyTile->firstLink[polyCount] = n;
+
+	m_tiles[index] = adjacencyTile;
+	m_linkCount += linkCount;
+	return DT_SUCCESS;
+}
@@ -0,0 +1,370 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include "DetourPolyOverlay.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include "DetourCommon.h"
+
+/// @class dtPolyOverlay
+///
+/// The overlay does not keep the mesh alive and never dereferences it on the
+/// lookup path: the reference layout is copied in #init, so an overlay left
+/// bound to a freed mesh only ever returns stale values, it does not touch
+/// freed memory. Only the setters and #diff read polygon data from the mesh.
+///
+/// Tiles are matched by salt, so overrides of a tile that was removed and
+/// replaced in the mesh are ignored.
+
+dtPolyOverlay::dtPolyOverlay() :
+	m_nav(0),
+	m_tiles(0),
+	m_used(0),
+	m_usedCount(0),
+	m_maxTiles(0),
+	m_overrideCount(0),
+	m_polyBits(0),
+	m_tileBits(0),
+	m_saltMask(0),
+	m_tileMask(0),
+	m_polyMask(0)
+{
+}
+
+dtPolyOverlay::~dtPolyOverlay()
+{
+	clear();
+	dtFree(m_tiles);
+	dtFree(m_used);
+}
+
+dtStatus dtPolyOverlay::init(const dtNavMesh* nav)
+{
+	clear();
+	dtFree(m_tiles);
+	dtFree(m_used);
+	m_tiles = 0;
+	m_used = 0;
+	m_maxTiles = 0;
+	m_nav = 0;
+
+	if (!nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtNavMeshParams* params = nav->getParams();
+#ifdef DT_POLYREF64
+	m_tileBits = DT_TILE_BITS;
+	m_polyBits = DT_POLY_BITS;
+	const unsigned int saltBits = DT_SALT_BITS;
+#else
+	m_tileBits = dtIlog2(dtNextPow2((unsigned int)params->maxTiles));
+	m_polyBits = dtIlog2(dtNextPow2((unsigned int)params->maxPolys));
+	const unsigned int saltBits = dtMin((unsigned int)31, 32 - m_tileBits - m_polyBits);
+#endif
+	m_saltMask = ((dtPolyRef)1 << saltBits) - 1;
+	m_tileMask = ((dtPolyRef)1 << m_tileBits) - 1;
+	m_polyMask = ((dtPolyRef)1 << m_polyBits) - 1;
+
+	const int maxTiles = nav->getMaxTiles();
+	m_tiles = (Tile**)dtAlloc(sizeof(Tile*) * maxTiles, DT_ALLOC_PERM);
+	m_used = (int*)dtAlloc(sizeof(int) * maxTiles, DT_ALLOC_PERM);
+	if (!m_tiles || !m_used)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_tiles, 0, sizeof(Tile*) * maxTiles);
+
+	m_maxTiles = maxTiles;
+	m_nav = nav;
+	return DT_SUCCESS;
+}
+
+void dtPolyOverlay::clear()
+{
+	for (int i = 0; i < m_usedCount; ++i)
+	{
+		dtFree(m_tiles[m_used[i]]);
+		m_tiles[m_used[i]] = 0;
+	}
+	m_usedCount = 0;
+	m_overrideCount = 0;
+}
+
+dtPolyOverlay::Tile* dtPolyOverlay::allocTile(unsigned int salt, int polyCount)
+{
+	// One block: header, mask words, flags, areas.
+	const int maskWords = (polyCount + 31) / 32;
+	const int headerSize = dtAlign4((int)sizeof(Tile));
+	const int maskSize = (int)sizeof(unsigned int) * maskWords;
+	const int flagsSize = dtAlign4((int)sizeof(unsigned short) * polyCount);
+	const int areasSize = dtAlign4((int)sizeof(unsigned char) * polyCount);
+
+	unsigned char* data = (unsigned char*)dtAlloc(headerSize + maskSize + flagsSize + areasSize, DT_ALLOC_PERM);
+	if (!data)
+		return 0;
+
+	Tile* tile = (Tile*)data;
+	tile->salt = salt;
+	tile->polyCount = polyCount;
+	tile->overrideCount = 0;
+	tile->mask = (unsigned int*)(data + headerSize);
+	tile->flags = (unsigned short*)(data + headerSize + maskSize);
+	tile->areas = data + headerSize + maskSize + flagsSize;
+	memset(tile->mask, 0, maskSize);
+	return tile;
+}
+
+dtStatus dtPolyOverlay::getOverrideSlot(dtPolyRef ref, Tile** result, unsigned int* resultIp)
+{
+	if (!m_nav)
+		return DT_FAILURE;
+
+	const dtMeshTile* meshTile = 0;
+	const dtPoly* poly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRef(ref, &meshTile, &poly)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	unsigned int salt, it, ip;
+	decodePolyId(ref, salt, it, ip);
+
+	Tile* tile = m_tiles[it];
+	if (tile && tile->salt != salt)
+	{
+		// The mesh tile was replaced, its old overrides no longer apply.
+		m_overrideCount -= tile->overrideCount;
+		tile->overrideCount = 0;
+		tile->salt = salt;
+		if (tile->polyCount != meshTile->header->polyCount)
+		{
+			dtFree(tile);
+			tile = 0;
+			m_tiles[it] = 0;
+			for (int i = 0; i < m_usedCount; ++i)
+			{
+				if (m_used[i] == (int)it)
+				{
+					m_used[i] = m_used[--m_usedCount];
+					break;
+				}
+			}
+		}
+		else
+		{
+			memset(tile->mask, 0, sizeof(unsigned int) * ((tile->polyCount + 31) / 32));
+		}
+	}
+
+	if (!tile)
+	{
+		tile = allocTile(salt, meshTile->header->polyCount);
+		if (!tile)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		m_tiles[it] = tile;
+		m_used[m_usedCount++] = (int)it;
+	}
+
+	const unsigned int bit = 1u << (ip & 31);
+	if (!(tile->mask[ip >> 5] & bit))
+	{
+		tile->mask[ip >> 5] |= bit;
+		tile->flags[ip] = poly->flags;
+		tile->areas[ip] = poly->getArea();
+		tile->overrideCount++;
+		m_overrideCount++;
+	}
+
+	*result = tile;
+	*resultIp = ip;
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyOverlay::setPolyFlags(dtPolyRef ref, unsigned short flags)
+{
+	Tile* tile;
+	unsigned int ip;
+	dtStatus status = getOverrideSlot(ref, &tile, &ip);
+	if (dtStatusFailed(status))
+		return status;
+
+	tile->flags[ip] = flags;
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyOverlay::setPolyArea(dtPolyRef ref, unsigned char area)
+{
+	if (area >= DT_MAX_AREAS)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	Tile* tile;
+	unsigned int ip;
+	dtStatus status = getOverrideSlot(ref, &tile, &ip);
+	if (dtStatusFailed(status))
+		return status;
+
+	tile->areas[ip] = area;
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyOverlay::resetPoly(dtPolyRef ref)
+{
+	unsigned int ip;
+	Tile* tile = const_cast<Tile*>(findOverride(ref, ip));
+	if (!tile)
+		return DT_SUCCESS;
+
+	tile->mask[ip >> 5] &= ~(1u << (ip & 31));
+	tile->overrideCount--;
+	m_overrideCount--;
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyOverlay::getPolyFlags(dtPolyRef ref, unsigned short* resultFlags) const
+{
+	if (!m_nav)
+		return DT_FAILURE;
+
+	const dtMeshTile* meshTile = 0;
+	const dtPoly* poly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRef(ref, &meshTile, &poly)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*resultFlags = getFlags(ref, poly);
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyOverlay::getPolyArea(dtPolyRef ref, unsigned char* resultArea) const
+{
+	if (!m_nav)
+		return DT_FAILURE;
+
+	const dtMeshTile* meshTile = 0;
+	const dtPoly* poly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRef(ref, &meshTile, &poly)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*resultArea = getArea(ref, poly);
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyOverlay::copyFrom(const dtPolyOverlay& other)
+{
+	if (&other == this)
+		return DT_SUCCESS;
+
+	if (!other.m_nav)
+	{
+		init(0);
+		return DT_SUCCESS;
+	}
+
+	if (m_nav != other.m_nav)
+	{
+		dtStatus status = init(other.m_nav);
+		if (dtStatusFailed(status))
+			return status;
+	}
+	else
+	{
+		clear();
+	}
+
+	for (int i = 0; i < other.m_usedCount; ++i)
+	{
+		const int it = other.m_used[i];
+		const Tile* src = other.m_tiles[it];
+		if (!src->overrideCount)
+			continue;
+
+		Tile* dst = allocTile(src->salt, src->polyCount);
+		if (!dst)
+		{
+			clear();
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+		const int maskWords = (src->polyCount + 31) / 32;
+		memcpy(dst->mask, src->mask, sizeof(unsigned int) * maskWords);
+		memcpy(dst->flags, src->flags, sizeof(unsigned short) * src->polyCount);
+		memcpy(dst->areas, src->areas, sizeof(unsigned char) * src->polyCount);
+		dst->overrideCount = src->overrideCount;
+
+		m_tiles[it] = dst;
+		m_used[m_usedCount++] = it;
+		m_overrideCount += dst->overrideCount;
+	}
+
+	return DT_SUCCESS;
+}
+
+int dtPolyOverlay::diffTile(const Tile* tile, const dtPolyOverlay& other, const Tile* otherTile, unsigned int it,
+						   dtPolyRef* refs, int count, int maxRefs) const
+{
+	const dtMeshTile* meshTile = m_nav->getTile((int)it);
+	if (!meshTile->header || meshTile->salt != tile->salt)
+		return count;
+
+	const int polyCount = dtMin(tile->polyCount, meshTile->header->polyCount);
+	for (int ip = 0; ip < polyCount; ++ip)
+	{
+		const unsigned int bit = 1u << (ip & 31);
+		const bool mine = (tile->mask[ip >> 5] & bit) != 0;
+		const bool theirs = otherTile && (otherTile->mask[ip >> 5] & bit) != 0;
+		if (!mine && !theirs)
+			continue;
+
+		const dtPoly* poly = &meshTile->polys[ip];
+		const dtPolyRef ref = m_nav->encodePolyId(tile->salt, it, (unsigned int)ip);
+		if (getFlags(ref, poly) == other.getFlags(ref, poly) && getArea(ref, poly) == other.getArea(ref, poly))
+			continue;
+
+		if (refs && count < maxRefs)
+			refs[count] = ref;
+		count++;
+	}
+	return count;
+}
+
+dtStatus dtPolyOverlay::diff(const dtPolyOverlay& other, dtPolyRef* refs, int* refCount, int maxRefs) const
+{
+	*refCount = 0;
+	if (m_nav != other.m_nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	int count = 0;
+	for (int i = 0; i < m_usedCount; ++i)
+	{
+		const unsigned int it = (unsigned int)m_used[i];
+		const Tile* tile = m_tiles[it];
+		const Tile* otherTile = other.m_tiles[it];
+		if (otherTile && otherTile->salt != tile->salt)
+			otherTile = 0;
+		count = diffTile(tile, other, otherTile, it, refs, count, maxRefs);
+	}
+
+	// Tiles only the other overlay touched.
+	for (int i = 0; i < other.m_usedCount; ++i)
+	{
+		const unsigned int it = (unsigned int)other.m_used[i];
+		const Tile* tile = m_tiles[it];
+		const Tile* otherTile = other.m_tiles[it];
+		if (tile && tile->salt == otherTile->salt)
+			continue;
+		count = other.diffTile(otherTile, *this, 0, it, refs, count, maxRefs);
+	}
+
+	*refCount = count;
+	return count > maxRefs ? DT_SUCCESS | DT_BUFFER_TOO_SMALL : DT_SUCCESS;
+}
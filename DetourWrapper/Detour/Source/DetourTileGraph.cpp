@@ -0,0 +1,453 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <string.h>
+#include <new>
+#include "DetourTileGraph.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include "DetourCommon.h"
+#include "DetourNode.h"
+
+/// @class dtTileGraph
+///
+/// A node is a polygon with at least one link into another tile. Border
+/// polygons next to each other that lead into the same tile form an
+/// entrance, and one polygon of each entrance is marked as its exit. The
+/// edges of a node lead to every exit of the same tile that can be reached
+/// without leaving the tile, with the cost of the cheapest such path. Costs are
+/// measured between polygon centers, as the search that uses them only
+/// needs to rank routes; the corridor along a route is searched again with
+/// the caller's filter.
+///
+/// Exits keep the graph small: the edges of a tile are its border polygons
+/// times its entrances, and a search crossing a tile opens few nodes in it.
+
+dtTileGraph* dtAllocTileGraph()
+{
+	void* mem = dtAlloc(sizeof(dtTileGraph), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtTileGraph;
+}
+
+void dtFreeTileGraph(dtTileGraph* graph)
+{
+	if (!graph) return;
+	graph->~dtTileGraph();
+	dtFree(graph);
+}
+
+dtTileGraph::dtTileGraph() :
+	m_nav(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_nodeCount(0),
+	m_edgeCount(0),
+	m_polyFlags(0)
+{
+}
+
+dtTileGraph::~dtTileGraph()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+		dtFree(m_tiles[i]);
+	dtFree(m_tiles);
+}
+
+dtStatus dtTileGraph::init(const dtNavMesh* nav, const dtQueryFilter* filter)
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+		dtFree(m_tiles[i]);
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_nodeCount = 0;
+	m_edgeCount = 0;
+	m_polyFlags = 0;
+	m_nav = 0;
+
+	if (!nav || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const int maxTiles = nav->getMaxTiles();
+	m_tiles = (Tile**)dtAlloc(sizeof(Tile*) * maxTiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_tiles, 0, sizeof(Tile*) * maxTiles);
+
+	m_maxTiles = maxTiles;
+	m_nav = nav;
+	m_filter = *filter;
+
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		dtStatus status = buildTile(i);
+		if (dtStatusFailed(status))
+			return status;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileGraph::addTile(dtTileRef ref)
+{
+	if (!m_nav)
+		return DT_FAILURE;
+
+	const dtMeshTile* tile = m_nav->getTileByRef(ref);
+	if (!tile)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtStatus status = buildTile((int)m_nav->decodePolyIdTile((dtPolyRef)ref));
+	if (dtStatusFailed(status))
+		return status;
+
+	return rebuildNeighbours(tile->header->x, tile->header->y);
+}
+
+dtStatus dtTileGraph::removeTile(dtTileRef ref)
+{
+	if (!m_nav)
+		return DT_FAILURE;
+
+	const int index = (int)m_nav->decodePolyIdTile((dtPolyRef)ref);
+	if (index >= m_maxTiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const Tile* tile = m_tiles[index];
+	if (!tile || tile->salt != m_nav->decodePolyIdSalt((dtPolyRef)ref))
+		return DT_SUCCESS;
+
+	const int x = tile->x;
+	const int y = tile->y;
+	freeTile(index);
+	return rebuildNeighbours(x, y);
+}
+
+void dtTileGraph::freeTile(int index)
+{
+	Tile* tile = m_tiles[index];
+	if (!tile)
+		return;
+
+	m_nodeCount -= tile->nodeCount;
+	m_edgeCount -= tile->edgeCount;
+	dtFree(tile);
+	m_tiles[index] = 0;
+}
+
+bool dtTileGraph::linksInto(const dtMeshTile* tile, int ip, unsigned int neighbourIndex) const
+{
+	const dtPoly* poly = &tile->polys[ip];
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		const dtPolyRef ref = tile->links[i].ref;
+		if (ref && m_nav->decodePolyIdTile(ref) == neighbourIndex)
+			return true;
+	}
+	return false;
+}
+
+dtStatus dtTileGraph::rebuildNeighbours(int x, int y)
+{
+	// Links only connect a tile to the eight around it, so only their border
+	// polygons can have changed.
+	static const int MAX_NEIS = 32;
+	const dtMeshTile* neis[MAX_NEIS];
+
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			if (!dx && !dy)
+				continue;
+			const int nneis = m_nav->getTilesAt(x + dx, y + dy, neis, MAX_NEIS);
+			for (int j = 0; j < nneis; ++j)
+			{
+				dtStatus status = buildTile((int)m_nav->decodePolyIdTile((dtPolyRef)m_nav->getTileRef(neis[j])));
+				if (dtStatusFailed(status))
+					return status;
+			}
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileGraph::buildTile(int index)
+{
+	freeTile(index);
+
+	const dtMeshTile* tile = m_nav->getTile(index);
+	if (!tile->header)
+		return DT_SUCCESS;
+
+	const int polyCount = tile->header->polyCount;
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+
+	// Scratch: node of each polygon, polygon centers, entrance marks and
+	// exits, and the costs and open list of the searches inside the tile.
+	const int heapSize = tile->header->maxLinkCount + 1;
+	const int nodeOfPolySize = dtAlign4((int)sizeof(unsigned short) * polyCount);
+	const int centersSize = (int)sizeof(float) * 3 * polyCount;
+	const int marksSize = (int)sizeof(int) * polyCount;
+	const int queueSize = (int)sizeof(int) * polyCount;
+	const int exitSize = dtAlign4((int)sizeof(unsigned char) * polyCount);
+	const int costsSize = (int)sizeof(float) * polyCount;
+	const int heapBytes = (int)sizeof(dtCostQueueEntry) * heapSize;
+
+	unsigned char* scratch = (unsigned char*)dtAlloc(nodeOfPolySize + centersSize + marksSize + queueSize + exitSize + costsSize + heapBytes, DT_ALLOC_TEMP);
+	if (!scratch)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	unsigned short* nodeOfPoly = (unsigned short*)scratch;
+	float* centers = (float*)(scratch + nodeOfPolySize);
+	int* marks = (int*)(scratch + nodeOfPolySize + centersSize);
+	int* queue = (int*)(scratch + nodeOfPolySize + centersSize + marksSize);
+	unsigned char* exit = scratch + nodeOfPolySize + centersSize + marksSize + queueSize;
+	float* costs = (float*)(scratch + nodeOfPolySize + centersSize + marksSize + queueSize + exitSize);
+	dtCostQueueEntry* heap = (dtCostQueueEntry*)(scratch + nodeOfPolySize + centersSize + marksSize + queueSize + exitSize + costsSize);
+
+	// Border polygons, and the tiles they link into.
+	static const int MAX_NEIS = 32;
+	unsigned int neis[MAX_NEIS];
+	int nneis = 0;
+
+	int nodeCount = 0;
+	for (int ip = 0; ip < polyCount; ++ip)
+	{
+		const dtPoly* poly = &tile->polys[ip];
+		dtCalcPolyCenter(&centers[ip * 3], poly->verts, (int)poly->vertCount, tile->verts);
+		nodeOfPoly[ip] = DT_TILE_GRAPH_NO_NODE;
+		marks[ip] = -1;
+		exit[ip] = 0;
+		m_polyFlags |= poly->flags;
+
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtPolyRef ref = tile->links[i].ref;
+			if (!ref)
+				continue;
+			const unsigned int it = m_nav->decodePolyIdTile(ref);
+			if (it == (unsigned int)index)
+				continue;
+
+			if (nodeOfPoly[ip] == DT_TILE_GRAPH_NO_NODE)
+				nodeOfPoly[ip] = (unsigned short)nodeCount++;
+
+			int j = 0;
+			while (j < nneis && neis[j] != it)
+				j++;
+			if (j == nneis)
+			{
+				if (nneis < MAX_NEIS)
+					neis[nneis++] = it;
+				else
+					exit[ip] = 1;	// Too many neighbours to group, leave from every polygon.
+			}
+		}
+
+		if (nodeCount >= DT_TILE_GRAPH_NO_NODE)
+		{
+			dtFree(scratch);
+			return DT_FAILURE | DT_INVALID_PARAM;
+		}
+	}
+
+	// Group the border polygons into entrances: polygons with the same flags,
+	// linked to each other inside the tile, that link into the same
+	// neighbour. The polygon nearest the middle of an entrance becomes its
+	// exit; the search only leaves the tile from exits.
+	for (int k = 0; k < nneis; ++k)
+	{
+		for (int ip = 0; ip < polyCount; ++ip)
+		{
+			if (marks[ip] == k || !linksInto(tile, ip, neis[k]))
+				continue;
+
+			const unsigned short flags = tile->polys[ip].flags;
+			int queueCount = 0;
+			queue[queueCount++] = ip;
+			marks[ip] = k;
+			for (int head = 0; head < queueCount; ++head)
+			{
+				const dtPoly* poly = &tile->polys[queue[head]];
+				for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+				{
+					const dtPolyRef ref = tile->links[i].ref;
+					if (!ref || m_nav->decodePolyIdTile(ref) != (unsigned int)index)
+						continue;
+					const int neighbour = (int)m_nav->decodePolyIdPoly(ref);
+					if (marks[neighbour] == k || tile->polys[neighbour].flags != flags || !linksInto(tile, neighbour, neis[k]))
+						continue;
+					marks[neighbour] = k;
+					queue[queueCount++] = neighbour;
+				}
+			}
+
+			float mid[3] = { 0, 0, 0 };
+			for (int i = 0; i < queueCount; ++i)
+				dtVadd(mid, mid, &centers[queue[i] * 3]);
+			dtVscale(mid, mid, 1.0f / (float)queueCount);
+
+			int best = queue[0];
+			float bestDist = FLT_MAX;
+			for (int i = 0; i < queueCount; ++i)
+			{
+				const float d = dtVdistSqr(mid, &centers[queue[i] * 3]);
+				if (d < bestDist)
+				{
+					bestDist = d;
+					best = queue[i];
+				}
+			}
+			exit[best] = 1;
+		}
+	}
+
+	int exitCount = 0;
+	for (int ip = 0; ip < polyCount; ++ip)
+		exitCount += exit[ip];
+
+	const int maxEdges = dtMax(1, nodeCount * exitCount);
+	unsigned char* edgeScratch = (unsigned char*)dtAlloc(sizeof(Edge) * maxEdges + sizeof(int) * (nodeCount + 1), DT_ALLOC_TEMP);
+	if (!edgeScratch)
+	{
+		dtFree(scratch);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	Edge* edges = (Edge*)edgeScratch;
+	int* firstEdge = (int*)(edgeScratch + sizeof(Edge) * maxEdges);
+
+	// Cheapest paths from each border polygon to the exits, not leaving the tile.
+	int edgeCount = 0;
+	for (int ip = 0; ip < polyCount; ++ip)
+	{
+		const unsigned short source = nodeOfPoly[ip];
+		if (source == DT_TILE_GRAPH_NO_NODE)
+			continue;
+
+		firstEdge[source] = edgeCount;
+		if (!m_filter.passFilter(base | (dtPolyRef)ip, tile, &tile->polys[ip]))
+			continue;
+
+		for (int i = 0; i < polyCount; ++i)
+			costs[i] = FLT_MAX;
+		costs[ip] = 0.0f;
+
+		dtCostQueue open(heap, heapSize);
+		open.push(0.0f, (unsigned int)ip);
+		while (!open.empty())
+		{
+			const dtCostQueueEntry best = open.pop();
+			if (best.cost > costs[best.index])
+				continue;
+
+			if (exit[best.index] && (int)best.index != ip)
+			{
+				edges[edgeCount].node = nodeOfPoly[best.index];
+				edges[edgeCount].cost = best.cost;
+				edgeCount++;
+			}
+
+			const dtPolyRef bestRef = base | (dtPolyRef)best.index;
+			const dtPoly* bestPoly = &tile->polys[best.index];
+			for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+			{
+				const dtPolyRef neighbourRef = tile->links[i].ref;
+				if (!neighbourRef || m_nav->decodePolyIdTile(neighbourRef) != (unsigned int)index)
+					continue;
+
+				const int neighbour = (int)m_nav->decodePolyIdPoly(neighbourRef);
+				const dtPoly* neighbourPoly = &tile->polys[neighbour];
+				if (!m_filter.passFilter(neighbourRef, tile, neighbourPoly))
+					continue;
+
+				const float cost = best.cost + m_filter.getCost(&centers[best.index * 3], &centers[neighbour * 3],
+																0, 0, 0,
+																bestRef, tile, bestPoly,
+																neighbourRef, tile, neighbourPoly);
+				if (cost >= costs[neighbour] || !open.push(cost, (unsigned int)neighbour))
+					continue;
+
+				costs[neighbour] = cost;
+			}
+		}
+	}
+	firstEdge[nodeCount] = edgeCount;
+
+	// One block: header, polygon to node map, node polygons, node positions,
+	// exit marks, edge ranges, edges.
+	const int headerSize = dtAlign4((int)sizeof(Tile));
+	const int nodePolySize = (int)sizeof(unsigned int) * nodeCount;
+	const int nodePosSize = (int)sizeof(float) * 3 * nodeCount;
+	const int nodeExitSize = dtAlign4((int)sizeof(unsigned char) * nodeCount);
+	const int firstEdgeSize = (int)sizeof(int) * (nodeCount + 1);
+	const int edgesSize = (int)sizeof(Edge) * edgeCount;
+
+	unsigned char* data = (unsigned char*)dtAlloc(headerSize + nodeOfPolySize + nodePolySize + nodePosSize + nodeExitSize + firstEdgeSize + edgesSize, DT_ALLOC_PERM);
+	if (!data)
+	{
+		dtFree(scratch);
+		dtFree(edgeScratch);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	Tile* graphTile = (Tile*)data;
+	data += headerSize;
+	graphTile->nodeOfPoly = (unsigned short*)data;
+	data += nodeOfPolySize;
+	graphTile->nodePoly = (unsigned int*)data;
+	data += nodePolySize;
+	graphTile->nodePos = (float*)data;
+	data += nodePosSize;
+	graphTile->nodeExit = data;
+	data += nodeExitSize;
+	graphTile->firstEdge = (int*)data;
+	data += firstEdgeSize;
+	graphTile->edges = (Edge*)data;
+
+	graphTile->salt = tile->salt;
+	graphTile->x = tile->header->x;
+	graphTile->y = tile->header->y;
+	graphTile->layer = tile->header->layer;
+	graphTile->polyCount = polyCount;
+	graphTile->nodeCount = nodeCount;
+	graphTile->edgeCount = edgeCount;
+
+	memcpy(graphTile->nodeOfPoly, nodeOfPoly, sizeof(unsigned short) * polyCount);
+	for (int ip = 0; ip < polyCount; ++ip)
+	{
+		const unsigned short node = nodeOfPoly[ip];
+		if (node == DT_TILE_GRAPH_NO_NODE)
+			continue;
+		graphTile->nodePoly[node] = (unsigned int)ip;
+		graphTile->nodeExit[node] = exit[ip];
+		dtVcopy(&graphTile->nodePos[node * 3], &centers[ip * 3]);
+	}
+	memcpy(graphTile->firstEdge, firstEdge, sizeof(int) * (nodeCount + 1));
+	memcpy(graphTile->edges, edges, sizeof(Edge) * edgeCount);
+
+	dtFree(scratch);
+	dtFree(edgeScratch);
+
+	m_tiles[index] = graphTile;
+	m_nodeCount += nodeCount;
+	m_edgeCount += edgeCount;
+	return DT_SUCCESS;
+}
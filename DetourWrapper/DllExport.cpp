@@ -21,12 +21,58 @@ DETOUR_API uint32_t load(void* ptr, const char* filename)
     return detour->load(std::string{ filename });
 }
 
+DETOUR_API uint32_t load_with_flags(void* ptr, const char* filename, uint32_t flags)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->load(std::string{ filename }, flags);
+}
+
+DETOUR_API uint32_t load_with_stats(void* ptr, const char* filename, uint32_t flags, void* stats)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->load(std::string{ filename }, flags, static_cast<NavMeshLoadStats*>(stats));
+}
+
+DETOUR_API uint32_t shared_mesh_count()
+{
+    return (uint32_t)eqoa::MeshRegistry::instance().size();
+}
+
+DETOUR_API uint32_t save_snapshot(void* ptr, const char* filename)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->save_snapshot(std::string{ filename });
+}
+
+DETOUR_API uint32_t reserve_queries(void* ptr, int count)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->reserve_queries(count);
+}
+
 DETOUR_API uint32_t find_path(void* ptr, void* start, void* end, uint16_t includeFlags, uint16_t excludeFlags, float* strPath)
 {
     eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
     return detour->find_path(*static_cast<glm::vec3*>(start), *static_cast<glm::vec3*>(end), includeFlags, excludeFlags, strPath);
 }
 
+DETOUR_API uint32_t find_path_into(void* ptr, void* start, void* end, uint16_t includeFlags, uint16_t excludeFlags,
+    float* outPoints, int maxPoints, uint8_t* outFlags, dtPolyRef* outRefs, int* outCount)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->find_path_into(*static_cast<glm::vec3*>(start), *static_cast<glm::vec3*>(end), includeFlags, excludeFlags,
+        outPoints, maxPoints, outFlags, outRefs, outCount);
+}
+
+DETOUR_API uint32_t find_path_batch(void* ptr, int count, void* starts, void* ends,
+    uint16_t* includeFlags, uint16_t* excludeFlags,
+    float* outPoints, int outCapacity, int* outOffsets, int* outCounts, uint32_t* outStatus)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->find_path_batch(count, static_cast<const glm::vec3*>(starts), static_cast<const glm::vec3*>(ends),
+        includeFlags, excludeFlags, outPoints, outCapacity, outOffsets, outCounts, outStatus);
+}
+
 DETOUR_API uint32_t find_smoothPath(void* ptr, void* start, void* end, uint16_t includeFlags, uint16_t excludeFlags, float* smoothPath)
 {
     eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
@@ -45,8 +91,134 @@ DETOUR_API uint32_t random_point(void* ptr, void* centerPoint, int radius, uint1
     return detour->random_point(*static_cast<const glm::vec3*>(centerPoint), static_cast<float>(radius), includeFlags, excludeFlags, rndPoint);
 }
 
+DETOUR_API uint32_t set_filter_preset(void* ptr, uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags, const float* areaCosts)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->set_filter_preset(preset, includeFlags, excludeFlags, areaCosts);
+}
+
+DETOUR_API uint32_t remove_filter_preset(void* ptr, uint32_t preset)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->remove_filter_preset(preset);
+}
+
+DETOUR_API uint32_t find_path_preset(void* ptr, void* start, void* end, uint32_t preset, float* strPath)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->find_path_preset(*static_cast<glm::vec3*>(start), *static_cast<glm::vec3*>(end), preset, strPath);
+}
+
+DETOUR_API uint32_t find_smoothPath_preset(void* ptr, void* start, void* end, uint32_t preset, float* smoothPath)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->find_smoothPath_preset(*static_cast<glm::vec3*>(start), *static_cast<glm::vec3*>(end), preset, smoothPath);
+}
+
+DETOUR_API uint32_t random_point_preset(void* ptr, void* centerPoint, int radius, uint32_t preset, float* rndPoint)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->random_point_preset(*static_cast<const glm::vec3*>(centerPoint), static_cast<float>(radius), preset, rndPoint);
+}
+
 DETOUR_API uint32_t getPolyFlags(void* ptr, void* posIn, uint16_t includeFlags, uint16_t excludeFlags)
 {
     eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
     return detour->getPolyFlags(*static_cast<const glm::vec3*>(posIn), includeFlags, excludeFlags);
+}
+
+DETOUR_API uint32_t set_worker_threads(void* ptr, int threadCount, uint64_t* affinityMasks)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->set_worker_threads(threadCount, affinityMasks);
+}
+
+DETOUR_API uint32_t run_batch(void* ptr, int count, void* requests, void* results, float* outPoints, int maxPointsPerRequest)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->run_batch(count, static_cast<const NavRequest*>(requests), static_cast<NavResult*>(results), outPoints, maxPointsPerRequest);
+}
+
+DETOUR_API uint32_t request_path(void* ptr, void* start, void* end, uint16_t includeFlags, uint16_t excludeFlags)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    glm::vec3* startPoint = static_cast<glm::vec3*>(start);
+    glm::vec3* endPoint = static_cast<glm::vec3*>(end);
+    return detour->request_path(*startPoint, *endPoint, includeFlags, excludeFlags);
+}
+
+DETOUR_API uint32_t update_paths(void* ptr, int maxIterations)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->update_paths(maxIterations);
+}
+
+DETOUR_API uint32_t get_path_status(void* ptr, uint32_t handle)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->get_path_status(handle);
+}
+
+DETOUR_API uint32_t get_path_result(void* ptr, uint32_t handle, float* strPath, int maxPoints)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->get_path_result(handle, strPath, maxPoints);
+}
+
+DETOUR_API uint32_t cancel_path(void* ptr, uint32_t handle)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->cancel_path(handle);
+}
+
+DETOUR_API uint32_t set_poly_flags(void* ptr, void* pos, uint16_t includeFlags, uint16_t excludeFlags, uint16_t flags)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    glm::vec3* position = static_cast<glm::vec3*>(pos);
+    return detour->set_poly_flags(*position, includeFlags, excludeFlags, flags);
+}
+
+DETOUR_API uint32_t reset_poly_flags(void* ptr, void* pos, uint16_t includeFlags, uint16_t excludeFlags)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    glm::vec3* position = static_cast<glm::vec3*>(pos);
+    return detour->reset_poly_flags(*position, includeFlags, excludeFlags);
+}
+
+DETOUR_API uint32_t copy_poly_flags(void* dst, void* src)
+{
+    eqoa::detour* destination = static_cast<eqoa::detour*>(dst);
+    eqoa::detour* source = static_cast<eqoa::detour*>(src);
+    return destination->copy_poly_flags(*source);
+}
+
+DETOUR_API uint32_t diff_poly_flags(void* a, void* b)
+{
+    eqoa::detour* first = static_cast<eqoa::detour*>(a);
+    eqoa::detour* second = static_cast<eqoa::detour*>(b);
+    return first->diff_poly_flags(*second);
+}
+
+DETOUR_API uint32_t configure_path_cache(void* ptr, uint64_t maxBytes, float quantum)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->configure_path_cache(maxBytes, quantum);
+}
+
+DETOUR_API uint32_t get_path_cache_stats(void* ptr, uint64_t* hits, uint64_t* misses, uint64_t* entries, uint64_t* bytes)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->get_path_cache_stats(hits, misses, entries, bytes);
+}
+
+DETOUR_API uint32_t get_search_stats(void* ptr, uint64_t* searches, uint64_t* nodes, uint64_t* landmarkSearches, uint64_t* landmarkNodes)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->get_search_stats(searches, nodes, landmarkSearches, landmarkNodes);
+}
+
+DETOUR_API uint32_t set_search_mode(void* ptr, uint32_t mode)
+{
+    eqoa::detour* detour = static_cast<eqoa::detour*>(ptr);
+    return detour->set_search_mode(mode);
 }
\ No newline at end of file
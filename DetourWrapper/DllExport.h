@@ -17,14 +17,129 @@ extern "C"
 {
     DETOUR_API void* allocDetour();
     DETOUR_API void freeDetour(void* ptr);    
+    // Loads a mesh file and swaps it in. Safe to call while other threads are querying:
+    // calls already in progress finish on the previous mesh.
     DETOUR_API uint32_t load(void* ptr, const char* filename);
 
+    // Same as load with NavMeshLoadFlags, e.g. NAVMESH_LOAD_MAPPED to map the file
+    // instead of reading every tile into its own buffer.
+    DETOUR_API uint32_t load_with_flags(void* ptr, const char* filename, uint32_t flags);
+
+    // Same as load_with_flags, also filling a NavMeshLoadStats with the time spent in each
+    // load phase. NAVMESH_LOAD_PARALLEL uses the set_worker_threads pool, starting one
+    // worker per hardware thread if none is configured.
+    DETOUR_API uint32_t load_with_stats(void* ptr, const char* filename, uint32_t flags, void* stats);
+
+    // Number of distinct meshes loaded with NAVMESH_LOAD_SHARED that are still in use
+    // by at least one instance.
+    DETOUR_API uint32_t shared_mesh_count();
+
+    // Writes the loaded mesh as a linked snapshot. Both load functions read snapshots
+    // back without rebuilding tile links; they are only valid for the same build of
+    // the library (poly reference size, tile format version and byte order).
+    DETOUR_API uint32_t save_snapshot(void* ptr, const char* filename);
+
+    // Pre-initializes count pooled queries (one per worker thread that will call in concurrently)
+    DETOUR_API uint32_t reserve_queries(void* ptr, int count);
+
     // Updated to match new signatures with include/exclude flags
     DETOUR_API uint32_t find_path(void* ptr, void* start, void* end, uint16_t includeFlags, uint16_t excludeFlags, float* strPath);
+
+    // Same as find_path, writing straight into the caller's buffers: outPoints holds
+    // maxPoints points (3 floats each), outFlags (dtStraightPathFlags) and outRefs (the
+    // poly entered at each point) are optional and hold maxPoints entries. *outCount gets
+    // the number of points written. Returns a PathRequestStatus; PATH_REQUEST_OUT_OF_SPACE
+    // means the path was truncated to maxPoints points. The corridor is not limited to
+    // MAX_POLYS polys, so long routes come back whole when maxPoints allows it;
+    // PATH_REQUEST_PARTIAL means the end was not reached.
+    DETOUR_API uint32_t find_path_into(void* ptr, void* start, void* end, uint16_t includeFlags, uint16_t excludeFlags,
+        float* outPoints, int maxPoints, uint8_t* outFlags, dtPolyRef* outRefs, int* outCount);
+
+    // Runs count path requests in one call. Points of request i are written to
+    // outPoints starting at point outOffsets[i] (outCounts[i] points, 3 floats each);
+    // outCapacity is the size of outPoints in points. outStatus[i] receives a
+    // PathRequestStatus. Returns the number of requests that produced a path.
+    DETOUR_API uint32_t find_path_batch(void* ptr, int count, void* starts, void* ends,
+        uint16_t* includeFlags, uint16_t* excludeFlags,
+        float* outPoints, int outCapacity, int* outOffsets, int* outCounts, uint32_t* outStatus);
+
     DETOUR_API uint32_t find_smoothPath(void* ptr, void* start, void* end, uint16_t includeFlags, uint16_t excludeFlags, float* smoothPath);
     DETOUR_API uint32_t random_point(void* ptr, void* centerPoint, int radius, uint16_t includeFlags, uint16_t excludeFlags, float* rndPoint);
     DETOUR_API uint32_t getPolyFlags(void* ptr, void* pos, uint16_t includeFlags, uint16_t excludeFlags);
 
+    // Registers filter preset id (0..MAX_FILTER_PRESETS-1) with its flags and a table of
+    // DT_MAX_AREAS (64) area costs, or null for the built-in costs. Replaces an existing
+    // preset with the same id. Returns 1 on success.
+    DETOUR_API uint32_t set_filter_preset(void* ptr, uint32_t preset, uint16_t includeFlags, uint16_t excludeFlags, const float* areaCosts);
+    DETOUR_API uint32_t remove_filter_preset(void* ptr, uint32_t preset);
+
+    // Same as find_path, find_smoothPath and random_point with a registered filter preset
+    // instead of per-call flags. Fail like a missing path if the preset is not registered.
+    DETOUR_API uint32_t find_path_preset(void* ptr, void* start, void* end, uint32_t preset, float* strPath);
+    DETOUR_API uint32_t find_smoothPath_preset(void* ptr, void* start, void* end, uint32_t preset, float* smoothPath);
+    DETOUR_API uint32_t random_point_preset(void* ptr, void* centerPoint, int radius, uint32_t preset, float* rndPoint);
+
+    // Sets the flags of the poly nearest to pos that passes the include/exclude filter.
+    // Returns its previous flags, or UINT32_MAX if no poly was found. The change is kept
+    // in this instance's flag overlay, the mesh itself is never written to, so instances
+    // sharing a mesh keep independent door and bridge state. Loading a mesh drops it.
+    DETOUR_API uint32_t set_poly_flags(void* ptr, void* pos, uint16_t includeFlags, uint16_t excludeFlags, uint16_t flags);
+
+    // Drops the overlay entry of the poly nearest to pos so it uses the mesh flags again.
+    // The include/exclude filter is matched against the mesh flags. Returns the mesh
+    // flags, or UINT32_MAX if no poly was found.
+    DETOUR_API uint32_t reset_poly_flags(void* ptr, void* pos, uint16_t includeFlags, uint16_t excludeFlags);
+
+    // Replaces the flag overlay of dst with a copy of the one of src. Both instances must
+    // be on the same mesh (NAVMESH_LOAD_SHARED). Returns 1 on success.
+    DETOUR_API uint32_t copy_poly_flags(void* dst, void* src);
+
+    // Number of polys whose effective flags or area differ between two instances on the
+    // same mesh, or UINT32_MAX if they are on different meshes.
+    DETOUR_API uint32_t diff_poly_flags(void* a, void* b);
+
+    // Path result cache, off by default. maxBytes caps its memory (0 turns it off),
+    // quantum is the grid size end points are rounded to for lookups (<= 0 for the
+    // default). The cache is emptied by load() and by set_poly_flags.
+    DETOUR_API uint32_t configure_path_cache(void* ptr, uint64_t maxBytes, float quantum);
+    DETOUR_API uint32_t get_path_cache_stats(void* ptr, uint64_t* hits, uint64_t* misses, uint64_t* entries, uint64_t* bytes);
+
+    // Polygon by polygon path searches since the instance was created and the search
+    // nodes they used, in total and for the ones guided by the landmarks of meshes
+    // loaded with NAVMESH_LOAD_LANDMARKS. Every pointer is optional.
+    DETOUR_API uint32_t get_search_stats(void* ptr, uint64_t* searches, uint64_t* nodes, uint64_t* landmarkSearches, uint64_t* landmarkNodes);
+
+    // Selects a PathSearchMode for the full path searches of this instance. Paths
+    // between symmetric ends, such as a return to a leash point, expand fewer nodes
+    // with PATH_SEARCH_BIDIRECTIONAL. Forward searches with PATH_SEARCH_QUATERNARY_HEAP
+    // spend less time on their open list; corridors can differ where costs tie.
+    // Empties the path cache. 0 for an unknown mode.
+    DETOUR_API uint32_t set_search_mode(void* ptr, uint32_t mode);
+
+
+    // Starts threadCount worker threads for run_batch. affinityMasks is optional and
+    // holds one CPU mask per worker (0 = unpinned).
+    DETOUR_API uint32_t set_worker_threads(void* ptr, int threadCount, uint64_t* affinityMasks);
+
+    // Spreads count NavRequest entries over the worker threads. Path points of request i
+    // are written to outPoints at point i * maxPointsPerRequest. Returns the number of
+    // requests that produced a path or a clear line of sight.
+    DETOUR_API uint32_t run_batch(void* ptr, int count, void* requests, void* results, float* outPoints, int maxPointsPerRequest);
+
+    // Time-sliced path requests. request_path queues a request and returns its handle
+    // (0 when the queue is full). update_paths advances queued requests by at most
+    // maxIterations search iterations and returns how many finished; call it once per
+    // tick. get_path_status returns a PathRequestStatus, PATH_REQUEST_PENDING until the
+    // search is done. get_path_result copies the finished path and releases the handle;
+    // results not collected within a few update_paths calls are dropped. It returns the
+    // number of path points; when that is more than maxPoints nothing is copied and the
+    // handle stays valid, so the path can be collected again with a bigger buffer.
+    DETOUR_API uint32_t request_path(void* ptr, void* start, void* end, uint16_t includeFlags, uint16_t excludeFlags);
+    DETOUR_API uint32_t update_paths(void* ptr, int maxIterations);
+    DETOUR_API uint32_t get_path_status(void* ptr, uint32_t handle);
+    DETOUR_API uint32_t get_path_result(void* ptr, uint32_t handle, float* strPath, int maxPoints);
+    DETOUR_API uint32_t cancel_path(void* ptr, uint32_t handle);
+
     DETOUR_API uint32_t check_los(void* ptr, void* start, void* target, float* range, uint16_t includeFlags, uint16_t excludeFlags);
 }
 #endif
@@ -0,0 +1,166 @@
+#define _CRT_SECURE_NO_WARNINGS   // place before any #include <cstdio>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "MeshRegistry.h"
+
+namespace eqoa
+{
+    // FNV-1a over the whole file, eight bytes at a time.
+    static bool hashFile(const std::string& filePath, uint64_t& hash)
+    {
+        FILE* file = fopen(filePath.c_str(), "rb");
+        if (!file)
+            return false;
+
+        hash = 1469598103934665603ull;
+        unsigned char buffer[1 << 16];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            size_t i = 0;
+            for (; i + sizeof(uint64_t) <= read; i += sizeof(uint64_t))
+            {
+                uint64_t word;
+                memcpy(&word, &buffer[i], sizeof(word));
+                hash = (hash ^ word) * 1099511628211ull;
+            }
+            for (; i < read; ++i)
+                hash = (hash ^ buffer[i]) * 1099511628211ull;
+        }
+
+        const bool ok = !ferror(file);
+        fclose(file);
+        return ok;
+    }
+
+    // Size and modification time of the file; nanoseconds where the
+    // platform keeps them.
+    static bool statFile(const std::string& filePath, MeshRegistry::FileStamp& stamp)
+    {
+#ifdef _WIN32
+        struct _stat64 st;
+        if (_stat64(filePath.c_str(), &st) != 0)
+            return false;
+        stamp.size = (int64_t)st.st_size;
+        stamp.mtime = (int64_t)st.st_mtime;
+#else
+        struct stat st;
+        if (stat(filePath.c_str(), &st) != 0)
+            return false;
+        stamp.size = (int64_t)st.st_size;
+        stamp.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+        return true;
+    }
+
+    MeshRegistry& MeshRegistry::instance()
+    {
+        static MeshRegistry registry;
+        return registry;
+    }
+
+    void MeshRegistry::prune()
+    {
+        for (auto it = m_meshes.begin(); it != m_meshes.end();)
+        {
+            if (it->second.expired())
+                it = m_meshes.erase(it);
+            else
+                ++it;
+        }
+
+        for (auto it = m_hashes.begin(); it != m_hashes.end();)
+        {
+            if (m_meshes.find(Key(it->first, it->second.second)) == m_meshes.end())
+                it = m_hashes.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    NavMeshHandle MeshRegistry::acquire(const std::string& filePath, uint32_t flags, ThreadPool* pool, NavMeshLoadStats* stats,
+        const dtQueryFilter* filter)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        // The contents are only hashed when the file's size or modification
+        // time differ from the last time it was hashed.
+        FileStamp stamp;
+        if (!statFile(filePath, stamp))
+            return nullptr;
+
+        Key key(filePath, 0);
+        bool hashed = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            prune();
+            auto known = m_hashes.find(filePath);
+            if (known != m_hashes.end() && known->second.first == stamp)
+            {
+                key.second = known->second.second;
+                hashed = true;
+            }
+        }
+        if (!hashed && !hashFile(filePath, key.second))
+            return nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_meshes.find(key);
+            if (it != m_meshes.end())
+            {
+                NavMeshHandle mesh = it->second.lock();
+                if (mesh)
+                {
+                    if (stats)
+                    {
+                        memset(stats, 0, sizeof(*stats));
+                        stats->readMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                        stats->totalMs = stats->readMs;
+                        const dtNavMesh* navMesh = mesh->mesh.get();
+                        for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+                        {
+                            if (navMesh->getTile(i)->header)
+                                stats->tileCount++;
+                        }
+                        stats->threadCount = 1;
+                    }
+                    return mesh;
+                }
+            }
+        }
+
+        // Load without holding the lock so other zones are not held up. If
+        // two instances race for the same file the first one to finish wins.
+        NavMeshPtr loaded = LoadMeshFile(filePath, flags, pool, stats);
+        if (!loaded)
+            return nullptr;
+
+        NavMeshHandle mesh = MakeMeshSnapshot(std::move(loaded), flags, filter, stats);
+
+        // If the file changed while it was hashed or loaded, the mesh may not
+        // match the hash. Keep it for this caller but do not share it.
+        FileStamp loadedStamp;
+        if (!mesh || !statFile(filePath, loadedStamp) || !(loadedStamp == stamp))
+            return mesh;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::weak_ptr<const NavMeshSnapshot>& entry = m_meshes[key];
+        if (NavMeshHandle existing = entry.lock())
+            return existing;
+
+        entry = mesh;
+        m_hashes[filePath] = std::make_pair(stamp, key.second);
+        return mesh;
+    }
+
+    int MeshRegistry::size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        prune();
+        return (int)m_meshes.size();
+    }
+}
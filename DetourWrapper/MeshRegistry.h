@@ -0,0 +1,68 @@
+#ifndef MESHREGISTRY_H_INCLUDED
+#define MESHREGISTRY_H_INCLUDED
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1921)
+#pragma once
+#endif
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "NavMeshLoader.h"
+#include "ThreadPool.h"
+
+namespace eqoa
+{
+    // Process-wide table of meshes loaded with NAVMESH_LOAD_SHARED, keyed by
+    // file path and a hash of the file contents. Instances that load the same
+    // file get the same read-only mesh and keep only their own queries, path
+    // queue and cache. The registry holds weak references: a mesh is freed
+    // when the last instance using it loads something else or is destroyed.
+    // Rewriting the file changes its hash, so the next load reads it again
+    // while instances on the old contents keep theirs. The hash is reused
+    // while the file's size and modification time stay the same.
+    class MeshRegistry
+    {
+    public:
+        static MeshRegistry& instance();
+
+        // Returns the shared mesh for filePath, loading it with flags if no
+        // instance holds it yet; the flags of later callers are ignored, so
+        // the mesh only has a tile graph, landmarks or poly adjacency if its
+        // first loader asked for them. flags and filter are passed to MakeMeshSnapshot.
+        // Null if the file cannot be read or loaded. On a hit stats only
+        // report the time spent checking the file.
+        NavMeshHandle acquire(const std::string& filePath, uint32_t flags, ThreadPool* pool, NavMeshLoadStats* stats,
+            const dtQueryFilter* filter = nullptr);
+
+        struct FileStamp
+        {
+            int64_t size;
+            int64_t mtime;
+
+            bool operator==(const FileStamp& other) const { return size == other.size && mtime == other.mtime; }
+        };
+
+        // Number of distinct meshes currently alive.
+        int size();
+
+    private:
+        MeshRegistry() {}
+        MeshRegistry(const MeshRegistry&) = delete;
+        MeshRegistry& operator=(const MeshRegistry&) = delete;
+
+        typedef std::pair<std::string, uint64_t> Key;
+
+        void prune();
+
+        std::mutex m_mutex;
+        std::map<Key, std::weak_ptr<const NavMeshSnapshot>> m_meshes;
+        std::map<std::string, std::pair<FileStamp, uint64_t>> m_hashes;  // Last stamp and hash per path.
+    };
+}
+
+#endif // MESHREGISTRY_H_INCLUDED
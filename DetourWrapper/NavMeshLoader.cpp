@@ -0,0 +1,836 @@
+#define _CRT_SECURE_NO_WARNINGS   // place before any #include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "NavMeshLoader.h"
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourStatus.h"
+
+namespace eqoa
+{
+    static const int NAVMESHSET_MAGIC = 'M' << 24 | 'S' << 16 | 'E' << 8 | 'T';
+    static const int NAVMESHSET_VERSION = 1;
+
+    struct NavMeshSetHeader
+    {
+        int magic;
+        int version;
+        int numTiles;
+        dtNavMeshParams params;
+    };
+
+    struct NavMeshTileHeader
+    {
+        dtTileRef tileRef;
+        int dataSize;
+    };
+
+    // Linked snapshot: tiles stored after linking, together with their tile
+    // reference and link free list, so loading skips all link building.
+    // Native byte order only; every tile starts on a SNAPSHOT_ALIGN boundary.
+    static const int NAVMESHSNAP_MAGIC = 'M' << 24 | 'S' << 16 | 'N' << 8 | 'P';
+    static const int NAVMESHSNAP_VERSION = 1;
+    static const size_t SNAPSHOT_ALIGN = 16;
+
+    struct NavMeshSnapshotHeader
+    {
+        int magic;
+        int version;
+        int numTiles;
+        int polyRefSize;            // sizeof(dtPolyRef) of the writer.
+        int tileVersion;            // DT_NAVMESH_VERSION of the writer.
+        dtNavMeshParams params;
+    };
+
+    struct NavMeshSnapshotTileHeader
+    {
+        uint64_t tileRef;
+        int dataSize;
+        unsigned int linksFreeList;
+    };
+
+    static_assert(sizeof(NavMeshSnapshotHeader) % SNAPSHOT_ALIGN == 0, "snapshot header breaks tile alignment");
+    static_assert(sizeof(NavMeshSnapshotTileHeader) % SNAPSHOT_ALIGN == 0, "snapshot tile header breaks tile alignment");
+
+    // Alignment Detour expects of tile data it reads in place.
+    static const size_t TILE_DATA_ALIGN = sizeof(dtPolyRef) > sizeof(float) ? sizeof(dtPolyRef) : sizeof(float);
+
+    // Read-only file mapped copy-on-write. Detour writes the tile links into
+    // the tile data, which only duplicates the pages holding links; vertex,
+    // detail and BV pages stay shared with the page cache.
+    class MappedFile
+    {
+    public:
+        MappedFile() : m_data(nullptr), m_size(0) {}
+        ~MappedFile() { close(); }
+
+        bool open(const std::string& filePath)
+        {
+            close();
+#ifdef _WIN32
+            HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+            {
+                CloseHandle(file);
+                return false;
+            }
+
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (!mapping)
+                return false;
+
+            void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(mapping);
+            if (!view)
+                return false;
+
+            m_data = (unsigned char*)view;
+            m_size = (size_t)size.QuadPart;
+#else
+            int fd = ::open(filePath.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0)
+            {
+                ::close(fd);
+                return false;
+            }
+
+            void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (view == MAP_FAILED)
+                return false;
+
+            m_data = (unsigned char*)view;
+            m_size = (size_t)st.st_size;
+#endif
+            return true;
+        }
+
+        void close()
+        {
+            if (!m_data)
+                return;
+#ifdef _WIN32
+            UnmapViewOfFile(m_data);
+#else
+            munmap(m_data, m_size);
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        unsigned char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        unsigned char* m_data;
+        size_t m_size;
+    };
+
+    void NavMeshDeleter::operator()(dtNavMesh* mesh) const
+    {
+        dtFreeNavMesh(mesh);
+    }
+
+    static void swapBytes(void* value, size_t size)
+    {
+        unsigned char* bytes = (unsigned char*)value;
+        for (size_t i = 0; i < size / 2; ++i)
+        {
+            unsigned char tmp = bytes[i];
+            bytes[i] = bytes[size - 1 - i];
+            bytes[size - 1 - i] = tmp;
+        }
+    }
+
+    // Validates the set header, converting it from the other byte order if
+    // needed. swapped tells whether the tile headers need the same.
+    static bool readSetHeader(NavMeshSetHeader& header, bool& swapped)
+    {
+        swapped = false;
+        if (header.magic != NAVMESHSET_MAGIC)
+        {
+            int magic = header.magic;
+            dtSwapEndian(&magic);
+            if (magic != NAVMESHSET_MAGIC)
+                return false;
+
+            swapped = true;
+            dtSwapEndian(&header.magic);
+            dtSwapEndian(&header.version);
+            dtSwapEndian(&header.numTiles);
+            for (int i = 0; i < 3; ++i)
+                dtSwapEndian(&header.params.orig[i]);
+            dtSwapEndian(&header.params.tileWidth);
+            dtSwapEndian(&header.params.tileHeight);
+            dtSwapEndian(&header.params.maxTiles);
+            dtSwapEndian(&header.params.maxPolys);
+        }
+
+        return header.version == NAVMESHSET_VERSION;
+    }
+
+    static void readTileHeader(NavMeshTileHeader& tileHeader, bool swapped)
+    {
+        if (!swapped)
+            return;
+
+        swapBytes(&tileHeader.tileRef, sizeof(tileHeader.tileRef));
+        dtSwapEndian(&tileHeader.dataSize);
+    }
+
+    static bool isNativeTile(const unsigned char* data, int dataSize)
+    {
+        if (dataSize < (int)sizeof(dtMeshHeader))
+            return false;
+
+        int magic;
+        memcpy(&magic, data, sizeof(magic));
+        return magic == DT_NAVMESH_MAGIC;
+    }
+
+    // Brings tile data stored with the other byte order into native order.
+    static bool fixTileEndian(unsigned char* data, int dataSize)
+    {
+        if (isNativeTile(data, dataSize))
+            return true;
+
+        if (dataSize < (int)sizeof(dtMeshHeader) || !dtNavMeshHeaderSwapEndian(data, dataSize))
+            return false;
+
+        return dtNavMeshDataSwapEndian(data, dataSize);
+    }
+
+    static bool checkSnapshotHeader(const NavMeshSnapshotHeader& header)
+    {
+        return header.magic == NAVMESHSNAP_MAGIC &&
+            header.version == NAVMESHSNAP_VERSION &&
+            header.polyRefSize == (int)sizeof(dtPolyRef) &&
+            header.tileVersion == DT_NAVMESH_VERSION &&
+            header.numTiles >= 0;
+    }
+
+    static size_t paddedSize(size_t size)
+    {
+        return (size + SNAPSHOT_ALIGN - 1) & ~(SNAPSHOT_ALIGN - 1);
+    }
+
+    // Range of the tile locations in a file. Passed to dtNavMesh::init, it
+    // lets the mesh find tiles through a grid instead of the location hash.
+    struct TileBounds
+    {
+        dtNavMeshTileBounds bounds;
+        bool empty = true;
+
+        void add(const unsigned char* data, int dataSize)
+        {
+            if (dataSize < (int)sizeof(dtMeshHeader))
+                return;
+
+            const dtMeshHeader* tileHeader = (const dtMeshHeader*)data;
+            if (empty)
+            {
+                bounds.minx = bounds.maxx = tileHeader->x;
+                bounds.miny = bounds.maxy = tileHeader->y;
+                empty = false;
+                return;
+            }
+            bounds.minx = dtMin(bounds.minx, tileHeader->x);
+            bounds.miny = dtMin(bounds.miny, tileHeader->y);
+            bounds.maxx = dtMax(bounds.maxx, tileHeader->x);
+            bounds.maxy = dtMax(bounds.maxy, tileHeader->y);
+        }
+
+        const dtNavMeshTileBounds* get() const { return empty ? nullptr : &bounds; }
+    };
+
+    struct SnapshotTile
+    {
+        NavMeshSnapshotTileHeader header;
+        unsigned char* data;
+    };
+
+    // Restores the snapshot tiles in file order. Copied tiles not restored
+    // yet are freed when one fails.
+    static NavMeshPtr restoreSnapshot(NavMeshPtr mesh, const NavMeshSnapshotHeader& header,
+        std::vector<SnapshotTile>& tiles, int flags, NavMeshLoadStats& stats)
+    {
+        TileBounds bounds;
+        for (const SnapshotTile& tile : tiles)
+            bounds.add(tile.data, tile.header.dataSize);
+
+        const bool initialized = mesh && dtStatusSucceed(mesh->init(&header.params, bounds.get()));
+        size_t restored = 0;
+        for (; initialized && restored < tiles.size(); ++restored)
+        {
+            const SnapshotTile& tile = tiles[restored];
+            if (dtStatusFailed(mesh->restoreTile(tile.data, tile.header.dataSize, flags, (dtTileRef)tile.header.tileRef, tile.header.linksFreeList)))
+                break;
+            stats.tileCount++;
+        }
+
+        if (initialized && restored == tiles.size())
+            return mesh;
+
+        // Links of the other tiles may point into the missing ones, so a
+        // partial snapshot is unusable.
+        if (flags & DT_TILE_FREE_DATA)
+        {
+            for (size_t i = restored; i < tiles.size(); ++i)
+                dtFree(tiles[i].data);
+        }
+        return nullptr;
+    }
+
+    static NavMeshPtr loadSnapshotCopied(FILE* file, NavMeshLoadStats& stats)
+    {
+        NavMeshSnapshotHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 || !checkSnapshotHeader(header))
+            return nullptr;
+
+        // Read all tiles first, their locations pick the mesh's tile lookup.
+        std::vector<SnapshotTile> tiles;
+        bool failed = false;
+        for (int i = 0; i < header.numTiles; ++i)
+        {
+            SnapshotTile tile = {};
+            if (fread(&tile.header, sizeof(tile.header), 1, file) != 1 || tile.header.dataSize <= 0)
+            {
+                failed = true;
+                break;
+            }
+
+            const size_t stored = paddedSize((size_t)tile.header.dataSize);
+            tile.data = (unsigned char*)dtAlloc((int)stored, DT_ALLOC_PERM);
+            if (!tile.data)
+            {
+                failed = true;
+                break;
+            }
+
+            tiles.push_back(tile);
+            if (fread(tile.data, stored, 1, file) != 1)
+            {
+                failed = true;
+                break;
+            }
+        }
+
+        if (failed)
+        {
+            for (SnapshotTile& tile : tiles)
+                dtFree(tile.data);
+            return nullptr;
+        }
+
+        return restoreSnapshot(NavMeshPtr(dtAllocNavMesh()), header, tiles, DT_TILE_FREE_DATA, stats);
+    }
+
+    static NavMeshPtr loadSnapshotMapped(const std::shared_ptr<MappedFile>& file, NavMeshLoadStats& stats)
+    {
+        const size_t fileSize = file->size();
+        size_t offset = 0;
+
+        NavMeshSnapshotHeader header;
+        if (fileSize < sizeof(header))
+            return nullptr;
+        memcpy(&header, file->data(), sizeof(header));
+        offset += sizeof(header);
+        if (!checkSnapshotHeader(header))
+            return nullptr;
+
+        std::vector<SnapshotTile> tiles;
+        for (int i = 0; i < header.numTiles; ++i)
+        {
+            SnapshotTile tile;
+            if (fileSize - offset < sizeof(tile.header))
+                return nullptr;
+            memcpy(&tile.header, file->data() + offset, sizeof(tile.header));
+            offset += sizeof(tile.header);
+
+            const size_t stored = tile.header.dataSize > 0 ? paddedSize((size_t)tile.header.dataSize) : 0;
+            if (!stored || fileSize - offset < stored)
+                return nullptr;
+
+            tile.data = file->data() + offset;
+            offset += stored;
+            tiles.push_back(tile);
+        }
+
+        return restoreSnapshot(NavMeshPtr(dtAllocNavMesh(), NavMeshDeleter{ file }), header, tiles, 0, stats);
+    }
+
+    static double elapsedMs(std::chrono::steady_clock::time_point& since)
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(now - since).count();
+        since = now;
+        return ms;
+    }
+
+    // Runs task over all tiles, on the pool if there is one.
+    static void forEachTile(ThreadPool* pool, int count, const ThreadPool::Task& task)
+    {
+        if (pool)
+            pool->parallelFor(count, task);
+        else if (count > 0)
+            task(0, 0, count);
+    }
+
+    // As above, and calls prepare with the worker count first.
+    static void forEachTile(ThreadPool* pool, int count, const ThreadPool::Prepare& prepare,
+        const ThreadPool::Task& task)
+    {
+        if (pool)
+        {
+            pool->parallelFor(count, prepare, task);
+        }
+        else if (count > 0)
+        {
+            prepare(1);
+            task(0, 0, count);
+        }
+    }
+
+    // 64-bit file positions; long is 32 bits on Windows.
+    static int64_t tellFile(FILE* file)
+    {
+#ifdef _WIN32
+        return _ftelli64(file);
+#else
+        return (int64_t)ftello(file);
+#endif
+    }
+
+    static bool seekFile(FILE* file, int64_t offset, int origin)
+    {
+#ifdef _WIN32
+        return _fseeki64(file, offset, origin) == 0;
+#else
+        return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+    }
+
+    // One entry of the MSET tile table.
+    struct TileSource
+    {
+        NavMeshTileHeader header;
+        int64_t offset;             // Position of the tile data in the file.
+        unsigned char* data;
+        int flags;                  // DT_TILE_FREE_DATA when data is a private copy.
+        dtTileRef ref;              // Tile in the mesh, 0 if it was not added.
+        bool failed;                // Reading the tile data failed.
+    };
+
+    // Reads the MSET headers and the tile table, skipping over the tile data.
+    // The table ends at the first empty entry, like the serial loader did.
+    static bool readTileTable(FILE* file, NavMeshSetHeader& header, bool& swapped, std::vector<TileSource>& tiles)
+    {
+        if (fread(&header, sizeof(NavMeshSetHeader), 1, file) != 1 || !readSetHeader(header, swapped))
+            return false;
+
+        // std::cout << "NumTiles: " << header.numTiles << std::endl;
+
+        for (int i = 0; i < header.numTiles; ++i)
+        {
+            TileSource tile = {};
+            if (fread(&tile.header, sizeof(tile.header), 1, file) != 1)
+                return false;
+            readTileHeader(tile.header, swapped);
+
+            if (!tile.header.tileRef || tile.header.dataSize <= 0)
+                break;
+
+            tile.offset = tellFile(file);
+            if (tile.offset < 0 || !seekFile(file, tile.header.dataSize, SEEK_CUR))
+                return false;
+            tiles.push_back(tile);
+        }
+        return true;
+    }
+
+    static bool readTileTable(const MappedFile& file, NavMeshSetHeader& header, bool& swapped, std::vector<TileSource>& tiles)
+    {
+        const size_t fileSize = file.size();
+        size_t offset = 0;
+
+        if (fileSize < sizeof(NavMeshSetHeader))
+            return false;
+        memcpy(&header, file.data(), sizeof(NavMeshSetHeader));
+        offset += sizeof(NavMeshSetHeader);
+        if (!readSetHeader(header, swapped))
+            return false;
+
+        for (int i = 0; i < header.numTiles; ++i)
+        {
+            TileSource tile = {};
+            if (fileSize - offset < sizeof(tile.header))
+                return false;
+            memcpy(&tile.header, file.data() + offset, sizeof(tile.header));
+            offset += sizeof(tile.header);
+            readTileHeader(tile.header, swapped);
+
+            if (!tile.header.tileRef || tile.header.dataSize <= 0)
+                break;
+
+            if (fileSize - offset < (size_t)tile.header.dataSize)
+                return false;
+            tile.offset = (int64_t)offset;
+            offset += tile.header.dataSize;
+            tiles.push_back(tile);
+        }
+        return true;
+    }
+
+    // Gives the tile its data: a pointer into the mapping when it can be used
+    // in place, otherwise a private copy in native byte order. Tiles whose
+    // data cannot be fixed are left without data and skipped.
+    static void prepareTile(TileSource& tile, const MappedFile* mapping, FILE* file)
+    {
+        const int dataSize = tile.header.dataSize;
+
+        if (mapping)
+        {
+            unsigned char* mapped = mapping->data() + tile.offset;
+            if ((uintptr_t)mapped % TILE_DATA_ALIGN == 0 && isNativeTile(mapped, dataSize))
+            {
+                // Zero-copy: the tile lives in the mapping, which outlives the mesh.
+                tile.data = mapped;
+                tile.flags = 0;
+                return;
+            }
+        }
+
+        unsigned char* data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_PERM);
+        if (!data)
+        {
+            tile.failed = true;
+            return;
+        }
+
+        if (mapping)
+        {
+            memcpy(data, mapping->data() + tile.offset, dataSize);
+        }
+        else if (!file || !seekFile(file, tile.offset, SEEK_SET) || fread(data, dataSize, 1, file) != 1)
+        {
+            dtFree(data);
+            tile.failed = true;
+            return;
+        }
+
+        if (!fixTileEndian(data, dataSize))
+        {
+            dtFree(data);
+            return;
+        }
+
+        tile.data = data;
+        tile.flags = DT_TILE_FREE_DATA;
+    }
+
+    // Builds the mesh from the tile table in four phases. Reading the tile
+    // data and the links inside each tile run on the pool; reserving tile
+    // slots and linking tiles with their neighbours stay serial and in file
+    // order, which gives the same mesh as calling addTile for every tile.
+    static NavMeshPtr buildMesh(const std::string& filePath, const std::shared_ptr<MappedFile>& mapping,
+        const NavMeshSetHeader& header, std::vector<TileSource>& tiles, ThreadPool* pool,
+        NavMeshLoadStats& stats, std::chrono::steady_clock::time_point& phaseStart)
+    {
+        const int tileCount = (int)tiles.size();
+
+        // Read: every worker reads through its own file handle.
+        std::vector<FILE*> files;
+        forEachTile(pool, tileCount, [&](int workerCount)
+        {
+            files.assign(workerCount, nullptr);
+        },
+        [&](int worker, int begin, int end)
+        {
+            FILE*& file = files[worker];
+            if (!mapping && !file)
+                file = fopen(filePath.c_str(), "rb");
+
+            for (int i = begin; i < end; ++i)
+                prepareTile(tiles[i], mapping.get(), file);
+        });
+        for (FILE* file : files)
+        {
+            if (file)
+                fclose(file);
+        }
+
+        // The tile locations are known now, so the mesh can pick its tile
+        // lookup.
+        bool failed = false;
+        TileBounds bounds;
+        for (const TileSource& tile : tiles)
+        {
+            failed = failed || tile.failed;
+            if (tile.data)
+                bounds.add(tile.data, tile.header.dataSize);
+        }
+
+        NavMeshPtr mesh;
+        if (!failed)
+        {
+            mesh = NavMeshPtr(dtAllocNavMesh(), NavMeshDeleter{ mapping });
+            failed = !mesh || dtStatusFailed(mesh->init(&header.params, bounds.get()));
+        }
+        if (failed)
+        {
+            for (TileSource& tile : tiles)
+            {
+                if (tile.flags & DT_TILE_FREE_DATA)
+                    dtFree(tile.data);
+            }
+            return nullptr;
+        }
+        stats.readMs = elapsedMs(phaseStart);
+
+        // Reserve the tile slots.
+        for (TileSource& tile : tiles)
+        {
+            if (!tile.data)
+                continue;
+
+            if (dtStatusFailed(mesh->addTileDeferred(tile.data, tile.header.dataSize, tile.flags, tile.header.tileRef, &tile.ref)))
+            {
+                if (tile.flags & DT_TILE_FREE_DATA)
+                    dtFree(tile.data);
+                tile.ref = 0;
+            }
+        }
+        stats.addMs = elapsedMs(phaseStart);
+
+        // Links inside each tile.
+        forEachTile(pool, tileCount, [&](int, int begin, int end)
+        {
+            for (int i = begin; i < end; ++i)
+            {
+                if (tiles[i].ref)
+                    mesh->connectTileInternal(tiles[i].ref);
+            }
+        });
+        stats.internalLinkMs = elapsedMs(phaseStart);
+
+        // Stitch the tiles together.
+        for (TileSource& tile : tiles)
+        {
+            if (!tile.ref)
+                continue;
+
+            if (dtStatusFailed(mesh->connectTileExternal(tile.ref)))
+            {
+                mesh->removeTile(tile.ref, 0, 0);
+                tile.ref = 0;
+                continue;
+            }
+            stats.tileCount++;
+        }
+        stats.externalLinkMs = elapsedMs(phaseStart);
+
+        return mesh;
+    }
+
+    NavMeshPtr LoadMeshFile(const std::string& filePath, uint32_t flags, ThreadPool* pool, NavMeshLoadStats* stats)
+    {
+        NavMeshLoadStats localStats;
+        NavMeshLoadStats& out = stats ? *stats : localStats;
+        memset(&out, 0, sizeof(out));
+
+        std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point phaseStart = loadStart;
+
+        if (!(flags & NAVMESH_LOAD_PARALLEL))
+            pool = nullptr;
+        out.threadCount = pool && pool->size() > 0 ? pool->size() : 1;
+
+        NavMeshPtr mesh;
+        NavMeshSetHeader header;
+        bool swapped = false;
+        std::vector<TileSource> tiles;
+
+        if (flags & NAVMESH_LOAD_MAPPED)
+        {
+            std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+            if (!file->open(filePath))
+            {
+                std::cout << "File Not Found!" << std::endl;
+                return nullptr;
+            }
+
+            if (file->size() >= sizeof(int) && *(const int*)file->data() == NAVMESHSNAP_MAGIC)
+            {
+                mesh = loadSnapshotMapped(file, out);
+                out.readMs = elapsedMs(phaseStart);
+            }
+            else if (readTileTable(*file, header, swapped, tiles))
+            {
+                mesh = buildMesh(filePath, file, header, tiles, pool, out, phaseStart);
+            }
+        }
+        else
+        {
+            FILE* file = fopen(filePath.c_str(), "rb");
+            if (!file)
+            {
+                std::cout << "File Not Found!" << std::endl;
+                return nullptr;
+            }
+
+            int magic = 0;
+            if (fread(&magic, sizeof(magic), 1, file) == 1 && fseek(file, 0, SEEK_SET) == 0)
+            {
+                if (magic == NAVMESHSNAP_MAGIC)
+                {
+                    mesh = loadSnapshotCopied(file, out);
+                    out.readMs = elapsedMs(phaseStart);
+                    fclose(file);
+                }
+                else
+                {
+                    const bool ok = readTileTable(file, header, swapped, tiles);
+                    fclose(file);
+                    if (ok)
+                        mesh = buildMesh(filePath, nullptr, header, tiles, pool, out, phaseStart);
+                }
+            }
+            else
+            {
+                fclose(file);
+            }
+        }
+
+        out.totalMs = elapsedMs(loadStart);
+        return mesh;
+    }
+
+    NavMeshHandle MakeMeshSnapshot(NavMeshPtr mesh, uint32_t flags, const dtQueryFilter* filter, NavMeshLoadStats* stats)
+    {
+        static std::atomic<uint32_t> nextGeneration(0);
+
+        std::shared_ptr<NavMeshSnapshot> snapshot = std::make_shared<NavMeshSnapshot>();
+        if ((flags & NAVMESH_LOAD_HIERARCHY) && filter && mesh)
+        {
+            std::chrono::steady_clock::time_point graphStart = std::chrono::steady_clock::now();
+            TileGraphPtr graph(dtAllocTileGraph());
+            if (graph && dtStatusSucceed(graph->init(mesh.get(), filter)))
+                snapshot->graph = std::move(graph);
+            if (stats)
+            {
+                stats->graphMs = elapsedMs(graphStart);
+                stats->totalMs += stats->graphMs;
+            }
+        }
+        if ((flags & NAVMESH_LOAD_LANDMARKS) && filter && mesh)
+        {
+            std::chrono::steady_clock::time_point landmarkStart = std::chrono::steady_clock::now();
+            LandmarksPtr landmarks(dtAllocLandmarks());
+            if (landmarks && dtStatusSucceed(landmarks->init(mesh.get(), filter, NAVMESH_LANDMARK_COUNT)))
+                snapshot->landmarks = std::move(landmarks);
+            if (stats)
+            {
+                stats->landmarkMs = elapsedMs(landmarkStart);
+                stats->totalMs += stats->landmarkMs;
+            }
+        }
+        if ((flags & NAVMESH_LOAD_ADJACENCY) && mesh)
+        {
+            std::chrono::steady_clock::time_point adjacencyStart = std::chrono::steady_clock::now();
+            PolyAdjacencyPtr adjacency(dtAllocPolyAdjacency());
+            if (adjacency && dtStatusSucceed(adjacency->init(mesh.get())))
+                snapshot->adjacency = std::move(adjacency);
+            if (stats)
+            {
+                stats->adjacencyMs = elapsedMs(adjacencyStart);
+                stats->totalMs += stats->adjacencyMs;
+            }
+        }
+        snapshot->mesh = std::move(mesh);
+        snapshot->generation = ++nextGeneration;
+        return snapshot;
+    }
+
+    bool SaveMeshSnapshot(const dtNavMesh* mesh, const std::string& filePath)
+    {
+        if (!mesh)
+            return false;
+
+        NavMeshSnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = NAVMESHSNAP_MAGIC;
+        header.version = NAVMESHSNAP_VERSION;
+        header.polyRefSize = (int)sizeof(dtPolyRef);
+        header.tileVersion = DT_NAVMESH_VERSION;
+        memcpy(&header.params, mesh->getParams(), sizeof(dtNavMeshParams));
+        for (int i = 0; i < mesh->getMaxTiles(); ++i)
+        {
+            const dtMeshTile* tile = mesh->getTile(i);
+            if (tile && tile->header && tile->dataSize > 0)
+                header.numTiles++;
+        }
+
+        FILE* file = fopen(filePath.c_str(), "wb");
+        if (!file)
+            return false;
+
+        static const unsigned char padding[SNAPSHOT_ALIGN] = {};
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+        // Each tile keeps its tileRef; restoreTile claims the slot and salt
+        // encoded in it, so the saved poly refs and links stay valid whatever
+        // order the tiles are written in.
+        for (int i = 0; ok && i < mesh->getMaxTiles(); ++i)
+        {
+            const dtMeshTile* tile = mesh->getTile(i);
+            if (!tile || !tile->header || tile->dataSize <= 0)
+                continue;
+
+            NavMeshSnapshotTileHeader tileHeader;
+            memset(&tileHeader, 0, sizeof(tileHeader));
+            tileHeader.tileRef = (uint64_t)mesh->getTileRef(tile);
+            tileHeader.dataSize = tile->dataSize;
+            tileHeader.linksFreeList = tile->linksFreeList;
+
+            const size_t pad = paddedSize((size_t)tile->dataSize) - (size_t)tile->dataSize;
+            ok = fwrite(&tileHeader, sizeof(tileHeader), 1, file) == 1 &&
+                fwrite(tile->data, (size_t)tile->dataSize, 1, file) == 1 &&
+                (pad == 0 || fwrite(padding, pad, 1, file) == 1);
+        }
+
+        if (fclose(file) != 0)
+            ok = false;
+        if (!ok)
+            remove(filePath.c_str());
+        return ok;
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef NAVMESHLOADER_H_INCLUDED
+#define NAVMESHLOADER_H_INCLUDED
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1921)
+#pragma once
+#endif
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "DetourLandmarks.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourPolyAdjacency.h"
+#include "DetourTileGraph.h"
+#include "ThreadPool.h"
+
+enum NavMeshLoadFlags
+{
+    NAVMESH_LOAD_COPY = 0x00,       // Read every tile into its own buffer.
+    NAVMESH_LOAD_MAPPED = 0x01,     // Map the file and point tiles straight into the mapping.
+    NAVMESH_LOAD_PARALLEL = 0x02,   // Read tiles and build their internal links on the worker threads.
+    NAVMESH_LOAD_SHARED = 0x04,     // Reuse the read-only mesh other instances loaded from the same file.
+    NAVMESH_LOAD_HIERARCHY = 0x08,  // Build the tile graph that paths spanning many tiles are searched over.
+    NAVMESH_LOAD_LANDMARKS = 0x10,  // Compute landmark costs that guide path searches around walls and dead ends.
+    NAVMESH_LOAD_ADJACENCY = 0x20   // Copy the neighbours of every poly into arrays full path searches read in order.
+};
+
+// Landmarks computed with NAVMESH_LOAD_LANDMARKS. Each one costs two bytes
+// per polygon and one search over the whole mesh at load time.
+#define NAVMESH_LANDMARK_COUNT 8
+
+// Where the time of a load went, in milliseconds. Snapshots only report
+// readMs since their links are already built.
+struct NavMeshLoadStats
+{
+    double totalMs;
+    double readMs;                  // Tile table, tile data reads or mapping, byte order fixes.
+    double addMs;                   // Reserving tile slots.
+    double internalLinkMs;          // Links and off-mesh connections inside each tile.
+    double externalLinkMs;          // Position lookup and links between neighbouring tiles.
+    double graphMs;                 // Tile graph, with NAVMESH_LOAD_HIERARCHY.
+    double landmarkMs;              // Landmark costs, with NAVMESH_LOAD_LANDMARKS.
+    double adjacencyMs;             // Poly adjacency, with NAVMESH_LOAD_ADJACENCY.
+    int tileCount;
+    int threadCount;
+};
+
+namespace eqoa
+{
+    class MappedFile;
+
+    // Frees a mesh with dtFreeNavMesh and, for mapped loads, keeps the file
+    // mapping alive until the mesh that points into it is gone.
+    struct NavMeshDeleter
+    {
+        std::shared_ptr<MappedFile> file;
+
+        void operator()(dtNavMesh* mesh) const;
+    };
+
+    typedef std::unique_ptr<dtNavMesh, NavMeshDeleter> NavMeshPtr;
+
+    struct TileGraphDeleter
+    {
+        void operator()(dtTileGraph* graph) const { dtFreeTileGraph(graph); }
+    };
+
+    typedef std::unique_ptr<dtTileGraph, TileGraphDeleter> TileGraphPtr;
+
+    struct LandmarksDeleter
+    {
+        void operator()(dtLandmarks* landmarks) const { dtFreeLandmarks(landmarks); }
+    };
+
+    typedef std::unique_ptr<dtLandmarks, LandmarksDeleter> LandmarksPtr;
+
+    struct PolyAdjacencyDeleter
+    {
+        void operator()(dtPolyAdjacency* adjacency) const { dtFreePolyAdjacency(adjacency); }
+    };
+
+    typedef std::unique_ptr<dtPolyAdjacency, PolyAdjacencyDeleter> PolyAdjacencyPtr;
+
+    // A loaded mesh as published to queries. Never written to after loading,
+    // poly flag changes go to each instance's overlay. Every load gets a new
+    // generation, so query objects, cached results and overlays can tell
+    // which mesh they were made for.
+    struct NavMeshSnapshot
+    {
+        NavMeshPtr mesh;
+        TileGraphPtr graph;         // Null unless loaded with NAVMESH_LOAD_HIERARCHY.
+        LandmarksPtr landmarks;     // Null unless loaded with NAVMESH_LOAD_LANDMARKS.
+        PolyAdjacencyPtr adjacency; // Null unless loaded with NAVMESH_LOAD_ADJACENCY.
+        uint32_t generation;
+    };
+
+    // Readers hold a handle for the duration of a request. A replaced mesh
+    // is freed when the last handle to it is released.
+    typedef std::shared_ptr<const NavMeshSnapshot> NavMeshHandle;
+
+    // Wraps a loaded mesh for publishing. Generations are unique within the
+    // process, so instances that switch between shared meshes never see the
+    // same generation twice. NAVMESH_LOAD_HIERARCHY and NAVMESH_LOAD_LANDMARKS
+    // in flags build the tile graph and the landmark costs with filter's
+    // costs; the snapshot is published without them if that fails or filter
+    // is null. NAVMESH_LOAD_ADJACENCY builds the poly adjacency, which does
+    // not depend on the filter. stats is optional and gets graphMs,
+    // landmarkMs and adjacencyMs added.
+    NavMeshHandle MakeMeshSnapshot(NavMeshPtr mesh, uint32_t flags = 0, const dtQueryFilter* filter = nullptr, NavMeshLoadStats* stats = nullptr);
+
+    // Loads an MSET navmesh file. With NAVMESH_LOAD_MAPPED the file is mapped
+    // copy-on-write and tiles reference the mapping directly; a tile is only
+    // copied when it is misaligned or stored with the other byte order. With
+    // NAVMESH_LOAD_PARALLEL the per-tile work is spread over pool.
+    // Linked snapshots written by SaveMeshSnapshot are recognized by their
+    // header and restored without rebuilding any links. stats is optional.
+    NavMeshPtr LoadMeshFile(const std::string& filePath, uint32_t flags, ThreadPool* pool, NavMeshLoadStats* stats);
+
+    // Writes the mesh as a linked snapshot: tile data after linking plus the
+    // tile references and link free lists, in native byte order.
+    bool SaveMeshSnapshot(const dtNavMesh* mesh, const std::string& filePath);
+}
+
+#endif // NAVMESHLOADER_H_INCLUDED
@@ -0,0 +1,185 @@
+#include <cmath>
+#include <cstring>
+
+#include "PathCache.h"
+
+namespace eqoa
+{
+    bool PathCache::Key::operator==(const Key& other) const
+    {
+        return generation == other.generation && filterKey == other.filterKey && searchMode == other.searchMode && maxPath == other.maxPath &&
+            startRef == other.startRef && endRef == other.endRef &&
+            includeFlags == other.includeFlags && excludeFlags == other.excludeFlags &&
+            start[0] == other.start[0] && start[1] == other.start[1] && start[2] == other.start[2] &&
+            end[0] == other.end[0] && end[1] == other.end[1] && end[2] == other.end[2];
+    }
+
+    size_t PathCache::KeyHash::operator()(const Key& key) const
+    {
+        // FNV-1a over the key fields.
+        uint64_t h = 1469598103934665603ull;
+        auto mix = [&h](uint64_t v)
+        {
+            h ^= v;
+            h *= 1099511628211ull;
+        };
+        mix(((uint64_t)key.generation << 32) | key.filterKey);
+        mix(((uint64_t)key.searchMode << 32) | (uint32_t)key.maxPath);
+        mix((uint64_t)key.startRef);
+        mix((uint64_t)key.endRef);
+        mix(((uint64_t)key.includeFlags << 16) | key.excludeFlags);
+        for (int i = 0; i < 3; ++i)
+        {
+            mix((uint32_t)key.start[i]);
+            mix((uint32_t)key.end[i]);
+        }
+        return (size_t)h;
+    }
+
+    PathCache::PathCache() :
+        m_maxBytes(0),
+        m_bytes(0),
+        m_invQuantum(1.0f / PATH_CACHE_DEFAULT_QUANTUM),
+        m_hits(0),
+        m_misses(0)
+    {
+    }
+
+    void PathCache::configure(size_t maxBytes, float quantum)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_index.clear();
+        m_bytes = 0;
+        m_invQuantum = 1.0f / (quantum > 0.0f ? quantum : PATH_CACHE_DEFAULT_QUANTUM);
+        m_maxBytes = maxBytes;
+    }
+
+    PathCache::Key PathCache::makeKey(uint32_t generation, uint32_t filterKey, uint32_t searchMode, int maxPath, dtPolyRef startRef, dtPolyRef endRef, uint16_t includeFlags, uint16_t excludeFlags,
+        const float* startPos, const float* endPos) const
+    {
+        const float scale = m_invQuantum.load(std::memory_order_relaxed);
+
+        Key key;
+        key.generation = generation;
+        key.filterKey = filterKey;
+        key.searchMode = searchMode;
+        key.maxPath = maxPath;
+        key.startRef = startRef;
+        key.endRef = endRef;
+        key.includeFlags = includeFlags;
+        key.excludeFlags = excludeFlags;
+        for (int i = 0; i < 3; ++i)
+        {
+            key.start[i] = (int32_t)floorf(startPos[i] * scale);
+            key.end[i] = (int32_t)floorf(endPos[i] * scale);
+        }
+        return key;
+    }
+
+    bool PathCache::find(const Key& key, const float* startPos, const float* endPos,
+        dtPolyRef* path, int* pathCount, int maxPath,
+        float* points, int* pointCount, int maxPoints, bool* partial)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_index.find(key);
+        if (it == m_index.end() || (int)it->second->path.size() > maxPath)
+        {
+            m_misses++;
+            return false;
+        }
+
+        // Move to the front of the LRU list.
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        const Entry& entry = *it->second;
+
+        *pathCount = (int)entry.path.size();
+        memcpy(path, entry.path.data(), sizeof(dtPolyRef) * entry.path.size());
+        *partial = entry.partial;
+
+        const int count = (int)entry.points.size() / 3;
+        if (memcmp(entry.startPos, startPos, sizeof(entry.startPos)) == 0 &&
+            memcmp(entry.endPos, endPos, sizeof(entry.endPos)) == 0 &&
+            count < maxPoints)
+        {
+            memcpy(points, entry.points.data(), sizeof(float) * entry.points.size());
+            *pointCount = count;
+        }
+        else
+        {
+            *pointCount = -1;
+        }
+
+        m_hits++;
+        return true;
+    }
+
+    void PathCache::insert(const Key& key, const float* startPos, const float* endPos,
+        const dtPolyRef* path, int pathCount, const float* points, int pointCount, bool partial)
+    {
+        const size_t maxBytes = m_maxBytes.load(std::memory_order_relaxed);
+        if (!maxBytes || pathCount <= 0)
+            return;
+
+        Entry entry;
+        entry.key = key;
+        memcpy(entry.startPos, startPos, sizeof(entry.startPos));
+        memcpy(entry.endPos, endPos, sizeof(entry.endPos));
+        entry.path.assign(path, path + pathCount);
+        entry.points.assign(points, points + pointCount * 3);
+        entry.partial = partial;
+        // Payload plus a rough allowance for the list and hash map nodes.
+        entry.bytes = sizeof(Entry) + 64 + sizeof(dtPolyRef) * entry.path.size() + sizeof(float) * entry.points.size();
+        if (entry.bytes > maxBytes)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_index.find(key);
+        if (it != m_index.end())
+        {
+            m_bytes -= it->second->bytes;
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+
+        evict(maxBytes - entry.bytes);
+
+        m_bytes += entry.bytes;
+        m_entries.push_front(std::move(entry));
+        m_index.emplace(key, m_entries.begin());
+    }
+
+    void PathCache::evict(size_t maxBytes)
+    {
+        while (m_bytes > maxBytes && !m_entries.empty())
+        {
+            const Entry& last = m_entries.back();
+            m_bytes -= last.bytes;
+            m_index.erase(last.key);
+            m_entries.pop_back();
+        }
+    }
+
+    void PathCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_index.clear();
+        m_bytes = 0;
+    }
+
+    void PathCache::stats(uint64_t* hits, uint64_t* misses, uint64_t* entries, uint64_t* bytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (hits)
+            *hits = m_hits.load();
+        if (misses)
+            *misses = m_misses.load();
+        if (entries)
+            *entries = (uint64_t)m_entries.size();
+        if (bytes)
+            *bytes = (uint64_t)m_bytes;
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef PATHCACHE_H_INCLUDED
+#define PATHCACHE_H_INCLUDED
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1921)
+#pragma once
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "DetourNavMesh.h"
+
+// Grid size used to quantize path end points when none is configured.
+#define PATH_CACHE_DEFAULT_QUANTUM 0.25f
+
+namespace eqoa
+{
+    // LRU cache of path results keyed by the mesh generation, the filter,
+    // the search mode and corridor cap, the snapped start and end polygons
+    // and the end points rounded to a grid. An entry holds
+    // the polygon corridor and the straight path built from it. A hit on a
+    // nearby but not identical end point reuses the corridor and only redoes
+    // the string pulling. The cache is empty (and disabled) until a memory
+    // cap is configured.
+    class PathCache
+    {
+    public:
+        struct Key
+        {
+            uint32_t generation;
+            uint32_t filterKey;         // Filter preset revision, 0 for the default area costs.
+            uint32_t searchMode;        // PathSearchMode the corridor was found with.
+            int32_t maxPath;            // Corridor cap of the search, 0 when only the node pool limits it.
+            dtPolyRef startRef;
+            dtPolyRef endRef;
+            uint16_t includeFlags;
+            uint16_t excludeFlags;
+            int32_t start[3];
+            int32_t end[3];
+
+            bool operator==(const Key& other) const;
+        };
+
+        PathCache();
+
+        // Sets the memory cap in bytes (0 disables the cache) and the grid
+        // size for the end points. Drops all entries.
+        void configure(size_t maxBytes, float quantum);
+        bool enabled() const { return m_maxBytes.load(std::memory_order_relaxed) != 0; }
+
+        Key makeKey(uint32_t generation, uint32_t filterKey, uint32_t searchMode, int maxPath, dtPolyRef startRef, dtPolyRef endRef, uint16_t includeFlags, uint16_t excludeFlags,
+            const float* startPos, const float* endPos) const;
+
+        // Copies the cached corridor into path. If the stored straight path
+        // was built from exactly startPos/endPos and fits in maxPoints it is
+        // copied to points as well, otherwise pointCount is set to -1.
+        bool find(const Key& key, const float* startPos, const float* endPos,
+            dtPolyRef* path, int* pathCount, int maxPath,
+            float* points, int* pointCount, int maxPoints, bool* partial);
+
+        void insert(const Key& key, const float* startPos, const float* endPos,
+            const dtPolyRef* path, int pathCount, const float* points, int pointCount, bool partial);
+
+        // Drops all entries. Called whenever the mesh, its poly flags or the
+        // search mode change. Queries still running on a replaced mesh or
+        // with the old mode may insert afterwards, the generation and mode in
+        // the key keep those entries from being hit.
+        void clear();
+
+        void stats(uint64_t* hits, uint64_t* misses, uint64_t* entries, uint64_t* bytes);
+
+    private:
+        PathCache(const PathCache&) = delete;
+        PathCache& operator=(const PathCache&) = delete;
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const;
+        };
+
+        struct Entry
+        {
+            Key key;
+            float startPos[3];      // Exact end points the straight path was built from.
+            float endPos[3];
+            std::vector<dtPolyRef> path;
+            std::vector<float> points;
+            bool partial;
+            size_t bytes;
+        };
+
+        typedef std::list<Entry> EntryList;
+
+        void evict(size_t maxBytes);
+
+        std::mutex m_mutex;
+        EntryList m_entries;                // Most recently used first.
+        std::unordered_map<Key, EntryList::iterator, KeyHash> m_index;
+        std::atomic<size_t> m_maxBytes;
+        size_t m_bytes;
+        std::atomic<float> m_invQuantum;
+        std::atomic<uint64_t> m_hits;
+        std::atomic<uint64_t> m_misses;
+    };
+}
+
+#endif // PATHCACHE_H_INCLUDED
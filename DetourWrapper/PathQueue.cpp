@@ -0,0 +1,273 @@
+#include <cstring>
+
+#include "PathQueue.h"
+#include "Detour.h"
+#include "DetourCommon.h"
+#include "DetourStatus.h"
+
+namespace eqoa
+{
+    PathQueue::PathQueue() :
+        m_navQuery(nullptr),
+        m_queryGeneration(0),
+        m_path(MAX_POLYS),
+        m_nextHandle(1),
+        m_queueHead(0)
+    {
+        for (Request& q : m_queue)
+        {
+            q.handle = 0;
+            q.points.resize(MAX_POLYS * 3);
+        }
+    }
+
+    PathQueue::~PathQueue()
+    {
+        dtFreeNavMeshQuery(m_navQuery);
+    }
+
+    void PathQueue::bind(const NavMeshHandle& mesh)
+    {
+        NavMeshHandle replaced;
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Searches in progress hold refs of the old mesh, restart them.
+        // Flag overrides were made for the old mesh too and are dropped.
+        for (Request& q : m_queue)
+        {
+            if (q.handle && q.result == PATH_REQUEST_PENDING)
+            {
+                q.status = 0;
+                q.startRef = 0;
+                q.endRef = 0;
+                q.filter.setPolyOverlay(nullptr);
+            }
+        }
+
+        // The old mesh may be freed here, after the lock is released.
+        replaced = std::move(m_mesh);
+        m_mesh = mesh;
+    }
+
+    bool PathQueue::prepareQuery()
+    {
+        if (m_queryGeneration == m_mesh->generation)
+            return true;
+
+        if (!m_navQuery)
+        {
+            m_navQuery = dtAllocNavMeshQuery();
+            if (!m_navQuery)
+                return false;
+        }
+
+        if (dtStatusFailed(m_navQuery->init(m_mesh->mesh.get(), QUERY_MAX_NODES)))
+            return false;
+
+        m_queryGeneration = m_mesh->generation;
+        return true;
+    }
+
+    uint32_t PathQueue::request(const float* startPos, const float* endPos, const float* halfExtents, const dtQueryFilter& filter)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_mesh)
+            return 0;
+
+        Request* slot = nullptr;
+        for (Request& q : m_queue)
+        {
+            if (!q.handle)
+            {
+                slot = &q;
+                break;
+            }
+        }
+        if (!slot)
+            return 0;
+
+        slot->handle = m_nextHandle++;
+        if (!m_nextHandle)
+            m_nextHandle = 1;
+        slot->result = PATH_REQUEST_PENDING;
+        slot->status = 0;
+        dtVcopy(slot->startPos, startPos);
+        dtVcopy(slot->endPos, endPos);
+        dtVcopy(slot->halfExtents, halfExtents);
+        slot->startRef = 0;
+        slot->endRef = 0;
+        slot->filter = filter;
+        slot->pointCount = 0;
+        slot->keepAlive = 0;
+        return slot->handle;
+    }
+
+    bool PathQueue::start(Request& q)
+    {
+        float snapped[3];
+        if (dtStatusFailed(m_navQuery->findNearestPoly(q.startPos, q.halfExtents, &q.filter, &q.startRef, snapped)) || !q.startRef)
+        {
+            q.status = DT_FAILURE;
+            q.result = PATH_REQUEST_NO_START_POLY;
+            return false;
+        }
+        dtVcopy(q.startPos, snapped);
+
+        if (dtStatusFailed(m_navQuery->findNearestPoly(q.endPos, q.halfExtents, &q.filter, &q.endRef, snapped)) || !q.endRef)
+        {
+            q.status = DT_FAILURE;
+            q.result = PATH_REQUEST_NO_END_POLY;
+            return false;
+        }
+        dtVcopy(q.endPos, snapped);
+
+        q.status = m_navQuery->initSlicedFindPath(q.startRef, q.endRef, q.startPos, q.endPos, &q.filter);
+        if (dtStatusFailed(q.status))
+        {
+            q.result = PATH_REQUEST_FAILED;
+            return false;
+        }
+        return true;
+    }
+
+    void PathQueue::finish(Request& q)
+    {
+        q.keepAlive = 0;
+        q.pointCount = 0;
+
+        int pathCount = 0;
+        if (!dtStatusFailed(q.status))
+            q.status = m_navQuery->finalizeSlicedFindPath(m_path.data(), &pathCount, MAX_POLYS);
+        if (dtStatusFailed(q.status) || pathCount == 0)
+        {
+            q.result = PATH_REQUEST_FAILED;
+            return;
+        }
+
+        const bool partial = dtStatusDetail(q.status, DT_PARTIAL_RESULT);
+
+        dtStatus status = m_navQuery->findStraightPath(q.startPos, q.endPos, m_path.data(), pathCount,
+            q.points.data(), 0, 0, &q.pointCount, MAX_POLYS);
+        if (dtStatusFailed(status))
+        {
+            q.pointCount = 0;
+            q.result = PATH_REQUEST_FAILED;
+            return;
+        }
+
+        q.result = partial ? PATH_REQUEST_PARTIAL : PATH_REQUEST_OK;
+    }
+
+    int PathQueue::update(int maxIterations)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_mesh || maxIterations <= 0 || !prepareQuery())
+            return 0;
+
+        int finished = 0;
+        int iterCount = maxIterations;
+        for (int i = 0; i < PATH_QUEUE_SIZE; ++i)
+        {
+            Request& q = m_queue[m_queueHead];
+
+            if (!q.handle)
+            {
+                m_queueHead = (m_queueHead + 1) % PATH_QUEUE_SIZE;
+                continue;
+            }
+
+            // Finished, waiting to be collected.
+            if (q.result != PATH_REQUEST_PENDING)
+            {
+                if (++q.keepAlive > PATH_QUEUE_KEEP_ALIVE)
+                    q.handle = 0;
+                m_queueHead = (m_queueHead + 1) % PATH_QUEUE_SIZE;
+                continue;
+            }
+
+            if (q.status == 0 && !start(q))
+            {
+                q.keepAlive = 0;
+                finished++;
+                m_queueHead = (m_queueHead + 1) % PATH_QUEUE_SIZE;
+                continue;
+            }
+
+            if (dtStatusInProgress(q.status))
+            {
+                int iters = 0;
+                q.status = m_navQuery->updateSlicedFindPath(iterCount, &iters);
+                iterCount -= iters;
+            }
+
+            if (!dtStatusInProgress(q.status))
+            {
+                finish(q);
+                finished++;
+            }
+
+            // Out of budget, an unfinished search resumes here next tick.
+            if (iterCount <= 0)
+                break;
+
+            m_queueHead = (m_queueHead + 1) % PATH_QUEUE_SIZE;
+        }
+
+        return finished;
+    }
+
+    PathQueue::Request* PathQueue::find(uint32_t handle)
+    {
+        if (!handle)
+            return nullptr;
+
+        for (Request& q : m_queue)
+        {
+            if (q.handle == handle)
+                return &q;
+        }
+        return nullptr;
+    }
+
+    uint32_t PathQueue::status(uint32_t handle)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Request* q = find(handle);
+        if (!q)
+            return PATH_REQUEST_INVALID_HANDLE;
+        return q->result;
+    }
+
+    int PathQueue::result(uint32_t handle, float* outPoints, int maxPoints)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Request* q = find(handle);
+        if (!q || q->result == PATH_REQUEST_PENDING)
+            return 0;
+
+        // Too small a buffer keeps the result, and gives the caller another
+        // few updates to collect it with a bigger one.
+        if (q->pointCount > 0 && (!outPoints || maxPoints < q->pointCount))
+        {
+            q->keepAlive = 0;
+            return q->pointCount;
+        }
+
+        if (q->pointCount > 0)
+            memcpy(outPoints, q->points.data(), sizeof(float) * 3 * q->pointCount);
+
+        q->handle = 0;
+        return q->pointCount;
+    }
+
+    bool PathQueue::cancel(uint32_t handle)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Request* q = find(handle);
+        if (!q)
+            return false;
+
+        q->handle = 0;
+        return true;
+    }
+}
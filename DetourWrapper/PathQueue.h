@@ -0,0 +1,100 @@
+#ifndef PATHQUEUE_H_INCLUDED
+#define PATHQUEUE_H_INCLUDED
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1921)
+#pragma once
+#endif
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "NavMeshLoader.h"
+
+// Requests that can wait in the queue at the same time.
+#define PATH_QUEUE_SIZE 64
+
+// Update calls a finished request is kept before its result is dropped.
+#define PATH_QUEUE_KEEP_ALIVE 8
+
+namespace eqoa
+{
+    // Time-sliced path requests in the spirit of dtPathQueue. Requests are
+    // only recorded when they are submitted; update() advances them with
+    // initSlicedFindPath/updateSlicedFindPath and stops once the iteration
+    // budget for the tick is used up, so a long path is spread over several
+    // ticks instead of stalling one. Requests are processed in order, one at
+    // a time, on a query owned by the queue.
+    class PathQueue
+    {
+    public:
+        PathQueue();
+        ~PathQueue();
+
+        // Switches the queue to a new mesh. Requests still being searched
+        // start over on it with the next update, the queue's query is
+        // rebound at the same time. Finished results are kept.
+        void bind(const NavMeshHandle& mesh);
+
+        // Queues a path request. The end points are snapped to the mesh with
+        // halfExtents when the search starts. Returns its handle, or 0 if
+        // the queue is full.
+        uint32_t request(const float* startPos, const float* endPos, const float* halfExtents, const dtQueryFilter& filter);
+
+        // Spends at most maxIterations search iterations on queued requests.
+        // Returns the number of requests that finished during this call.
+        int update(int maxIterations);
+
+        // Returns PATH_REQUEST_PENDING while the request is in the queue,
+        // PATH_REQUEST_INVALID_HANDLE for unknown or expired handles,
+        // otherwise its final PathRequestStatus.
+        uint32_t status(uint32_t handle);
+
+        // Copies the straight path of a finished request and releases the
+        // handle. Returns the number of points of the path; if that is more
+        // than maxPoints nothing is copied and the handle is kept, so the
+        // caller can ask again with a bigger buffer.
+        int result(uint32_t handle, float* outPoints, int maxPoints);
+
+        // Drops a request whether or not it has finished.
+        bool cancel(uint32_t handle);
+
+    private:
+        PathQueue(const PathQueue&) = delete;
+        PathQueue& operator=(const PathQueue&) = delete;
+
+        struct Request
+        {
+            uint32_t handle;        // 0 if the slot is free.
+            uint32_t result;        // PathRequestStatus once finished.
+            dtStatus status;        // Sliced search state, 0 until started.
+            float startPos[3];
+            float endPos[3];
+            float halfExtents[3];
+            dtPolyRef startRef;
+            dtPolyRef endRef;
+            dtQueryFilter filter;
+            std::vector<float> points;
+            int pointCount;
+            int keepAlive;
+        };
+
+        Request* find(uint32_t handle);
+        bool prepareQuery();
+        bool start(Request& request);
+        void finish(Request& request);
+
+        std::mutex m_mutex;
+        dtNavMeshQuery* m_navQuery;
+        NavMeshHandle m_mesh;
+        uint32_t m_queryGeneration;         // Mesh generation m_navQuery was initialized for.
+        Request m_queue[PATH_QUEUE_SIZE];
+        std::vector<dtPolyRef> m_path;      // Corridor of the request being finalized.
+        uint32_t m_nextHandle;
+        int m_queueHead;                    // Slot update() resumes at, in [0, PATH_QUEUE_SIZE).
+    };
+}
+
+#endif // PATHQUEUE_H_INCLUDED
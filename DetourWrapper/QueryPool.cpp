@@ -0,0 +1,100 @@
+#include "QueryPool.h"
+#include "DetourStatus.h"
+
+namespace eqoa
+{
+    QueryPool::Lease::~Lease()
+    {
+        if (m_pool && m_query)
+            m_pool->release(m_query, m_mesh->generation);
+    }
+
+    QueryPool::QueryPool()
+    {
+    }
+
+    QueryPool::~QueryPool()
+    {
+        for (Entry& entry : m_idle)
+            dtFreeNavMeshQuery(entry.query);
+    }
+
+    bool QueryPool::prepare(Entry& entry, const dtNavMesh* mesh, uint32_t generation)
+    {
+        if (entry.generation == generation)
+            return true;
+
+        if (dtStatusFailed(entry.query->init(mesh, QUERY_MAX_NODES)))
+            return false;
+
+        entry.generation = generation;
+        return true;
+    }
+
+    bool QueryPool::reserve(int count, const NavMeshHandle& mesh)
+    {
+        if (!mesh)
+            return false;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::vector<Entry> ready;
+        while ((int)(m_idle.size() + ready.size()) < count)
+        {
+            Entry entry{ dtAllocNavMeshQuery(), 0 };
+            if (!entry.query)
+                break;
+            ready.push_back(entry);
+        }
+        for (Entry& entry : m_idle)
+            ready.push_back(entry);
+        m_idle.clear();
+        lock.unlock();
+
+        // Node pool allocation is the expensive part, do it outside the lock.
+        bool ok = true;
+        for (Entry& entry : ready)
+            ok = prepare(entry, mesh->mesh.get(), mesh->generation) && ok;
+
+        lock.lock();
+        for (Entry& entry : ready)
+            m_idle.push_back(entry);
+        return ok && (int)m_idle.size() >= count;
+    }
+
+    QueryPool::Lease QueryPool::acquire(const NavMeshHandle& mesh)
+    {
+        if (!mesh)
+            return Lease();
+
+        Entry entry{ nullptr, 0 };
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_idle.empty())
+            {
+                entry = m_idle.back();
+                m_idle.pop_back();
+            }
+        }
+
+        if (!entry.query)
+        {
+            entry.query = dtAllocNavMeshQuery();
+            if (!entry.query)
+                return Lease();
+        }
+
+        if (!prepare(entry, mesh->mesh.get(), mesh->generation))
+        {
+            dtFreeNavMeshQuery(entry.query);
+            return Lease();
+        }
+
+        return Lease(this, entry.query, mesh);
+    }
+
+    void QueryPool::release(dtNavMeshQuery* query, uint32_t generation)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(Entry{ query, generation });
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef QUERYPOOL_H_INCLUDED
+#define QUERYPOOL_H_INCLUDED
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1921)
+#pragma once
+#endif
+
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "NavMeshLoader.h"
+
+// Search nodes reserved by every pooled query.
+#define QUERY_MAX_NODES 65535
+
+// Search nodes of the per-thread query that takes over searches a pooled
+// query ran out of nodes for. Its node pool pages its nodes in as searches
+// reach further.
+#define QUERY_LARGE_MAX_NODES (1 << 20)
+
+namespace eqoa
+{
+    // Owns a set of dtNavMeshQuery objects that are checked out for the
+    // duration of a single request. Each concurrent caller gets its own node
+    // pool and open list, so queries against the same mesh no longer have to
+    // be serialized. Queries are initialized once and re-initialized only when
+    // they are checked out for a different mesh than last time, so after a
+    // mesh swap the pool is rebound lazily, one query at a time.
+    class QueryPool
+    {
+    public:
+        // Scoped checkout of one query. Keeps the mesh the query was
+        // initialized for alive and returns the query to the pool when it
+        // goes out of scope.
+        class Lease
+        {
+        public:
+            Lease() : m_pool(nullptr), m_query(nullptr) {}
+            Lease(QueryPool* pool, dtNavMeshQuery* query, const NavMeshHandle& mesh)
+                : m_pool(pool), m_query(query), m_mesh(mesh) {}
+            Lease(Lease&& other) noexcept
+                : m_pool(other.m_pool), m_query(other.m_query), m_mesh(std::move(other.m_mesh))
+            {
+                other.m_pool = nullptr;
+                other.m_query = nullptr;
+            }
+            Lease& operator=(Lease&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    Lease released(std::move(*this));
+                    m_pool = other.m_pool;
+                    m_query = other.m_query;
+                    m_mesh = std::move(other.m_mesh);
+                    other.m_pool = nullptr;
+                    other.m_query = nullptr;
+                }
+                return *this;
+            }
+            ~Lease();
+
+            dtNavMeshQuery* get() const { return m_query; }
+            dtNavMeshQuery* operator->() const { return m_query; }
+            explicit operator bool() const { return m_query != nullptr; }
+
+            const dtNavMesh* mesh() const { return m_mesh->mesh.get(); }
+            uint32_t generation() const { return m_mesh->generation; }
+            const dtTileGraph* graph() const { return m_mesh->graph.get(); }
+            const dtLandmarks* landmarks() const { return m_mesh->landmarks.get(); }
+            const dtPolyAdjacency* adjacency() const { return m_mesh->adjacency.get(); }
+
+        private:
+            Lease(const Lease&) = delete;
+            Lease& operator=(const Lease&) = delete;
+
+            QueryPool* m_pool;
+            dtNavMeshQuery* m_query;
+            NavMeshHandle m_mesh;
+        };
+
+        QueryPool();
+        ~QueryPool();
+
+        // Makes sure at least count queries exist and are initialized against
+        // mesh, so the first requests of each worker thread do not pay for
+        // node pool allocation.
+        bool reserve(int count, const NavMeshHandle& mesh);
+
+        // Checks out a query initialized against mesh. The lease is empty if
+        // mesh is null or allocation failed.
+        Lease acquire(const NavMeshHandle& mesh);
+
+    private:
+        QueryPool(const QueryPool&) = delete;
+        QueryPool& operator=(const QueryPool&) = delete;
+
+        struct Entry
+        {
+            dtNavMeshQuery* query;
+            uint32_t generation;    // Mesh generation the query was initialized for.
+        };
+
+        bool prepare(Entry& entry, const dtNavMesh* mesh, uint32_t generation);
+        void release(dtNavMeshQuery* query, uint32_t generation);
+
+        std::mutex m_mutex;
+        std::vector<Entry> m_idle;          // Queries ready for checkout.
+    };
+}
+
+#endif // QUERYPOOL_H_INCLUDED
@@ -0,0 +1,193 @@
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace eqoa
+{
+    static void pinThread(std::thread& thread, uint64_t mask)
+    {
+        if (!mask)
+            return;
+
+#ifdef _WIN32
+        SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)mask);
+#elif defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64; ++cpu)
+        {
+            if (mask & (1ull << cpu))
+                CPU_SET(cpu, &cpus);
+        }
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#else
+        (void)thread;
+#endif
+    }
+
+    ThreadPool::ThreadPool() :
+        m_task(nullptr),
+        m_jobId(0),
+        m_pending(0),
+        m_stopping(false)
+    {
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        stop();
+    }
+
+    bool ThreadPool::start(int threadCount, const uint64_t* affinityMasks)
+    {
+        std::lock_guard<std::mutex> run(m_runMutex);
+
+        if (threadCount <= 0)
+            return false;
+
+        stop();
+
+        m_stopping = false;
+        for (int i = 0; i < threadCount; ++i)
+            m_workers.push_back(std::make_unique<Worker>());
+
+        for (int i = 0; i < threadCount; ++i)
+        {
+            m_workers[i]->thread = std::thread(&ThreadPool::workerMain, this, i);
+            if (affinityMasks)
+                pinThread(m_workers[i]->thread, affinityMasks[i]);
+        }
+
+        return true;
+    }
+
+    void ThreadPool::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            if (worker->thread.joinable())
+                worker->thread.join();
+        }
+        m_workers.clear();
+    }
+
+    int ThreadPool::size() const
+    {
+        std::lock_guard<std::mutex> run(m_runMutex);
+        return (int)m_workers.size();
+    }
+
+    void ThreadPool::parallelFor(int count, const Task& task)
+    {
+        parallelFor(count, Prepare(), task);
+    }
+
+    void ThreadPool::parallelFor(int count, const Prepare& prepare, const Task& task)
+    {
+        if (count <= 0)
+            return;
+
+        std::lock_guard<std::mutex> run(m_runMutex);
+
+        const int workerCount = (int)m_workers.size();
+        if (prepare)
+            prepare(workerCount > 0 ? workerCount : 1);
+        if (workerCount == 0)
+        {
+            task(0, 0, count);
+            return;
+        }
+
+        // Several chunks per worker leaves something to steal when the
+        // requests are uneven.
+        const int chunk = count / (workerCount * 8) > 1 ? count / (workerCount * 8) : 1;
+
+        m_task = &task;
+        m_pending.store(count);
+
+        int worker = 0;
+        for (int begin = 0; begin < count; begin += chunk)
+        {
+            const int end = begin + chunk < count ? begin + chunk : count;
+            std::lock_guard<std::mutex> lock(m_workers[worker]->mutex);
+            m_workers[worker]->queue.push_back(Range{ begin, end });
+            worker = (worker + 1) % workerCount;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobId++;
+        m_wake.notify_all();
+        m_done.wait(lock, [this]() { return m_pending.load() == 0; });
+        m_task = nullptr;
+    }
+
+    bool ThreadPool::popLocal(int index, Range& range)
+    {
+        Worker& worker = *m_workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.queue.empty())
+            return false;
+
+        range = worker.queue.back();
+        worker.queue.pop_back();
+        return true;
+    }
+
+    bool ThreadPool::steal(int thief, Range& range)
+    {
+        const int workerCount = (int)m_workers.size();
+        for (int i = 1; i < workerCount; ++i)
+        {
+            Worker& victim = *m_workers[(thief + i) % workerCount];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.queue.empty())
+                continue;
+
+            range = victim.queue.front();
+            victim.queue.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::workerMain(int index)
+    {
+        uint64_t seenJob = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&]() { return m_stopping || m_jobId != seenJob; });
+                if (m_stopping)
+                    return;
+                seenJob = m_jobId;
+            }
+
+            Range range;
+            while (popLocal(index, range) || steal(index, range))
+            {
+                (*m_task)(index, range.begin, range.end);
+
+                const int done = range.end - range.begin;
+                if (m_pending.fetch_sub(done) == done)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_done.notify_all();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef THREADPOOL_H_INCLUDED
+#define THREADPOOL_H_INCLUDED
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1921)
+#pragma once
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace eqoa
+{
+    // Fixed set of worker threads that execute index ranges with work
+    // stealing. Every worker pops chunks from the back of its own queue and,
+    // once that runs dry, steals from the front of the other workers' queues,
+    // so long path requests in one chunk do not leave the other cores idle.
+    class ThreadPool
+    {
+    public:
+        // Called with the index of the executing worker and a half-open
+        // range [begin, end) of items.
+        typedef std::function<void(int worker, int begin, int end)> Task;
+
+        // Called with the number of workers a parallelFor will run on, before
+        // any task. Workers are numbered below it.
+        typedef std::function<void(int workerCount)> Prepare;
+
+        ThreadPool();
+        ~ThreadPool();
+
+        // Starts threadCount workers, replacing any running ones. If
+        // affinityMasks is not null it holds one CPU mask per worker; a zero
+        // mask leaves that worker unpinned.
+        bool start(int threadCount, const uint64_t* affinityMasks);
+        void stop();
+
+        int size() const;
+
+        // Runs task over [0, count) on the workers and blocks until every
+        // item has been processed. Calls from several threads are serialized,
+        // also with start.
+        void parallelFor(int count, const Task& task);
+
+        // Like parallelFor(count, task), and calls prepare first with the
+        // worker count under the same lock, so per-worker state can be sized
+        // without racing a concurrent start.
+        void parallelFor(int count, const Prepare& prepare, const Task& task);
+
+    private:
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        struct Range
+        {
+            int begin;
+            int end;
+        };
+
+        struct Worker
+        {
+            std::thread thread;
+            std::mutex mutex;
+            std::deque<Range> queue;
+        };
+
+        void workerMain(int index);
+        bool popLocal(int index, Range& range);
+        bool steal(int thief, Range& range);
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        mutable std::mutex m_runMutex;      // One parallelFor or start at a time.
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        const Task* m_task;
+        uint64_t m_jobId;
+        std::atomic<int> m_pending;
+        bool m_stopping;
+    };
+}
+
+#endif // THREADPOOL_H_INCLUDED